@@ -1,5 +1,6 @@
 set(COMMONS_PUBLIC_HEADERS
     misc/types.h
+    misc/AsyncLog.h
     misc/Base64.h
     misc/Blob.h
     misc/Buffers.h
@@ -33,15 +34,18 @@ set(COMMONS_PUBLIC_HEADERS
     misc/RBSettings.h
     misc/ReverseAdapter.h
     misc/SampleInterpolator.h
+    misc/SettingHandle.h
     misc/SpriteMap.h
     misc/SpriteProperty.h
     misc/TaskQueue.h
     misc/ThreadManager.h
     misc/ThreadPool.h
+    misc/WorkStealingPool.h
     misc/ThreadedAnalysis.h
     misc/ThreadedAnalysis_impl.h
     misc/Timer.h
     misc/TooltipData.h
+    misc/Trace.h
     misc/UnorderedVectorSet.h
     misc/checked_casts.h
     misc/cnpy_wrapper.h
@@ -70,6 +74,7 @@ set(COMMONS_PUBLIC_HEADERS
     misc/utilsexception.h
     misc/vec2.h
     misc/zipper.h
+    file/AsyncWriter.h
     file/CSVExport.h
     file/CSVReader.h
     file/DataFormat.h
@@ -77,22 +82,31 @@ set(COMMONS_PUBLIC_HEADERS
     file/Export.h
     file/ImageIO.h
     file/PathArray.h
+    file/StreamingExport.h
     file/ask_for_permission.h
+    processing/Arena.h
     processing/Background.h
     processing/Brototype.h
     processing/CPULabeling.h
     processing/DLList.h
+    processing/DifferenceKernels.h
     processing/HLine.h
+    processing/LineEncoding.h
     processing/ListCache.h
     processing/LuminanceGrid.h
     processing/Node.h
     processing/PadImage.h
     processing/RawProcessing.h
+    processing/RunContours.h
+    processing/RunMoments.h
     processing/Source.h
     processing/encoding.h
     video/AveragingAccumulator.h
     video/FFmpegVideoCapture.h
+    video/FrameCache.h
     video/GenericVideo.h
+    video/KeyframeIndex.h
+    video/ParallelVideoReader.h
     video/Video.h
     video/VideoSource.h
     gui/ControlsAttributes.h
@@ -166,6 +180,7 @@ set(COMMONS_PUBLIC_HEADERS
 )
 
 set(COMMONS_MISC_HEADERS
+    misc/AsyncLog.h
     misc/Base64.h
     misc/Blob.h
     misc/Buffers.h
@@ -195,15 +210,18 @@ set(COMMONS_MISC_HEADERS
     misc/RBSettings.h
     misc/ReverseAdapter.h
     misc/SampleInterpolator.h
+    misc/SettingHandle.h
     misc/SpriteMap.h
     misc/SpriteProperty.h
     misc/TaskQueue.h
     misc/ThreadManager.h
     misc/ThreadPool.h
+    misc/WorkStealingPool.h
     misc/ThreadedAnalysis.h
     misc/ThreadedAnalysis_impl.h
     misc/Timer.h
     misc/TooltipData.h
+    misc/Trace.h
     misc/UnorderedVectorSet.h
     misc/bid.h
     misc/checked_casts.h
@@ -236,6 +254,7 @@ set(COMMONS_MISC_HEADERS
 )
 
 set(COMMONS_FILE_HEADERS
+    file/AsyncWriter.h
     file/CSVExport.h
     file/CSVReader.h
     file/DataFormat.h
@@ -243,15 +262,19 @@ set(COMMONS_FILE_HEADERS
     file/Export.h
     file/ImageIO.h
     file/PathArray.h
+    file/StreamingExport.h
     file/ask_for_permission.h
 )
 
 set(COMMONS_PROCESSING_HEADERS
+    processing/Arena.h
     processing/Background.h
     processing/Brototype.h
     processing/CPULabeling.h
     processing/DLList.h
+    processing/DifferenceKernels.h
     processing/HLine.h
+    processing/LineEncoding.h
     processing/ListCache.h
     processing/LuminanceGrid.h
     processing/Node.h
@@ -262,6 +285,8 @@ set(COMMONS_PROCESSING_HEADERS
     processing/PixelTree.h
     processing/ProximityGrid.h
     processing/RawProcessing.h
+    processing/RunContours.h
+    processing/RunMoments.h
     processing/Source.h
     processing/encoding.h
 )
@@ -269,7 +294,10 @@ set(COMMONS_PROCESSING_HEADERS
 set(COMMONS_VIDEO_HEADERS
     video/AveragingAccumulator.h
     video/FFmpegVideoCapture.h
+    video/FrameCache.h
     video/GenericVideo.h
+    video/KeyframeIndex.h
+    video/ParallelVideoReader.h
     video/Video.h
     video/VideoSource.h
 )
@@ -352,6 +380,7 @@ set(COMMONS_HTTP_HEADERS
 
 set(COMMONS_CPP_SOURCES
     misc/types.cpp
+    misc/AsyncLog.cpp
     misc/Base64.cpp
     misc/Blob.cpp
     misc/Buffers.cpp
@@ -370,8 +399,10 @@ set(COMMONS_CPP_SOURCES
     misc/SpriteProperty.cpp
     misc/ThreadManager.cpp
     misc/ThreadPool.cpp
+    misc/WorkStealingPool.cpp
     misc/Timer.cpp
     misc/TooltipData.cpp
+    misc/Trace.cpp
     misc/cnpy_wrapper.cpp
     misc/colors.cpp
     misc/curve_discussion.cpp
@@ -385,6 +416,7 @@ set(COMMONS_CPP_SOURCES
     misc/stringutils.cpp
     misc/utilsexception.cpp
     misc/vec2.cpp
+    file/AsyncWriter.cpp
     file/CSVExport.cpp
     file/CSVReader.cpp
     file/DataFormat.cpp
@@ -392,10 +424,14 @@ set(COMMONS_CPP_SOURCES
     file/Export.cpp
     file/ImageIO.cpp
     file/PathArray.cpp
+    file/StreamingExport.cpp
+    processing/Arena.cpp
     processing/Background.cpp
     processing/Brototype.cpp
     processing/CPULabeling.cpp
     processing/DLList.cpp
+    processing/DifferenceKernels.cpp
+    processing/LineEncoding.cpp
     processing/ListCache.cpp
     processing/LuminanceGrid.cpp
     processing/BlobIdentity.cpp
@@ -405,10 +441,15 @@ set(COMMONS_CPP_SOURCES
     processing/PixelTree.cpp
     processing/ProximityGrid.cpp
     processing/RawProcessing.cpp
+    processing/RunContours.cpp
+    processing/RunMoments.cpp
     processing/Source.cpp
     video/AveragingAccumulator.cpp
     video/FFmpegVideoCapture.cpp
+    video/FrameCache.cpp
     video/GenericVideo.cpp
+    video/KeyframeIndex.cpp
+    video/ParallelVideoReader.cpp
     video/Video.cpp
     video/VideoSource.cpp
     gui/ControlsAttributes.cpp
@@ -0,0 +1,177 @@
+#include "AsyncWriter.h"
+#include <misc/Timer.h>
+
+namespace cmn {
+
+namespace {
+//! staging buffers are page-aligned, so the OS can take them as they are
+constexpr std::align_val_t buffer_alignment{4096};
+}
+
+void AsyncWriter::Buffer::Free::operator()(char* ptr) const {
+    ::operator delete[](ptr, buffer_alignment);
+}
+
+std::string AsyncWriter::Stats::toStr() const {
+    return "AsyncWriter<submitted:" + Meta::toStr(FileSize{bytes_submitted})
+        + " written:" + Meta::toStr(FileSize{bytes_written})
+        + " buffers:" + Meta::toStr(buffers_written)
+        + " write:" + Meta::toStr(write_seconds) + "s"
+        + " stall:" + Meta::toStr(stall_seconds) + "s"
+        + " " + Meta::toStr(FileSize{uint64_t(throughput())}) + "/s>";
+}
+
+AsyncWriter::AsyncWriter(FILE* file, std::string name)
+    : AsyncWriter(file, std::move(name), Options{})
+{ }
+
+AsyncWriter::AsyncWriter(FILE* file, std::string name, Options options)
+    : _file(file), _options(options), _name(std::move(name))
+{
+    if(not _file)
+        throw InvalidArgumentException("Cannot write asynchronously to a file that is not open.");
+    if(_options.buffer_size == 0 || _options.num_buffers == 0)
+        throw InvalidArgumentException("AsyncWriter needs at least one buffer (", _options.num_buffers, "x", _options.buffer_size, " bytes).");
+
+    _buffers.resize(_options.num_buffers);
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        _buffers[i].data.reset(static_cast<char*>(::operator new[](_options.buffer_size, buffer_alignment)));
+        _free.push_back(i);
+    }
+
+    _thread = std::thread([this]() { run(); });
+}
+
+AsyncWriter::~AsyncWriter() {
+    try {
+        flush();
+    } catch(const std::exception& ex) {
+        FormatExcept("Failed to write all data of ", _name, ": ", ex.what());
+    }
+
+    {
+        std::unique_lock guard(_mutex);
+        _terminate = true;
+    }
+    _buffer_ready.notify_all();
+    _thread.join();
+}
+
+void AsyncWriter::rethrow(std::unique_lock<std::mutex>& guard) {
+    assert(guard.owns_lock());
+    if(_exception)
+        std::rethrow_exception(_exception);
+}
+
+void AsyncWriter::write(const char* buffer, size_t num_bytes) {
+    std::unique_lock guard(_mutex);
+    rethrow(guard);
+    _stats.bytes_submitted += num_bytes;
+
+    while(num_bytes > 0) {
+        if(_free.empty()) {
+            Timer timer;
+            _buffer_written.wait(guard, [this]() {
+                return not _free.empty() || _exception;
+            });
+            _stats.stall_seconds += timer.elapsed();
+            rethrow(guard);
+        }
+
+        /// the front free buffer only belongs to the writing thread,
+        /// so it can be filled without holding the lock
+        auto& target = _buffers[_free.front()];
+        const size_t N = min(num_bytes, _options.buffer_size - target.size);
+
+        guard.unlock();
+        std::memcpy(target.data.get() + target.size, buffer, N);
+        guard.lock();
+
+        target.size += N;
+        buffer += N;
+        num_bytes -= N;
+
+        if(target.size == _options.buffer_size)
+            submit(guard);
+    }
+}
+
+void AsyncWriter::submit(std::unique_lock<std::mutex>& guard) {
+    assert(guard.owns_lock());
+    if(_free.empty() || _buffers[_free.front()].size == 0)
+        return;
+
+    _pending.push_back(_free.front());
+    _free.pop_front();
+    _buffer_ready.notify_one();
+}
+
+void AsyncWriter::flush() {
+    std::unique_lock guard(_mutex);
+    submit(guard);
+
+    Timer timer;
+    _buffer_written.wait(guard, [this]() {
+        return _pending.empty() && not _writing;
+    });
+    _stats.stall_seconds += timer.elapsed();
+    rethrow(guard);
+}
+
+AsyncWriter::Stats AsyncWriter::stats() const {
+    std::unique_lock guard(_mutex);
+    return _stats;
+}
+
+void AsyncWriter::run() {
+    set_thread_name(_name + "::writer");
+
+    std::unique_lock guard(_mutex);
+    while(true) {
+        _buffer_ready.wait(guard, [this]() {
+            return not _pending.empty() || _terminate;
+        });
+        if(_pending.empty())
+            break;
+
+        const size_t index = _pending.front();
+        _pending.pop_front();
+        _writing = true;
+
+        auto& buffer = _buffers[index];
+        const bool failed_before = _exception != nullptr;
+        guard.unlock();
+
+        Timer timer;
+        std::exception_ptr exception;
+        /// after an error, everything else is discarded
+        if(not failed_before) {
+            try {
+                const size_t written = std::fwrite(buffer.data.get(), sizeof(char), buffer.size, _file);
+                if(written != buffer.size)
+                    throw U_EXCEPTION("Wrote only ", written, " of ", buffer.size, " bytes: ", (const char*)strerror(errno));
+                if(std::fflush(_file) != 0)
+                    throw U_EXCEPTION("Cannot flush file: ", (const char*)strerror(errno));
+            } catch(...) {
+                exception = std::current_exception();
+            }
+        }
+        const double seconds = timer.elapsed();
+
+        guard.lock();
+        if(exception) {
+            _exception = exception;
+        } else if(not failed_before) {
+            _stats.bytes_written += buffer.size;
+            ++_stats.buffers_written;
+            _stats.write_seconds += seconds;
+        }
+
+        buffer.size = 0;
+        _free.push_back(index);
+        _writing = false;
+        _buffer_written.notify_all();
+    }
+}
+
+}
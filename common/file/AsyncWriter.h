@@ -0,0 +1,104 @@
+#pragma once
+
+#include <commons.pc.h>
+
+namespace cmn {
+
+/**
+ * Appends data to an open FILE on a background thread. Writers copy into
+ * large, page-aligned staging buffers; full buffers are handed to the
+ * background thread, which writes them while the next buffer is being
+ * filled. If all buffers are waiting to be written, write() blocks until
+ * one is free again (back-pressure, so memory use is bounded).
+ *
+ * The file must not be touched by anyone else while the writer is alive,
+ * except after flush() returned and before the next write(). write() and
+ * flush() must not be called from more than one thread at a time.
+ */
+class AsyncWriter {
+public:
+    struct Options {
+        //! size of every staging buffer
+        size_t buffer_size = 4u * 1024u * 1024u;
+        //! number of staging buffers (2 = double-buffering)
+        size_t num_buffers = 2;
+    };
+
+    struct Stats {
+        //! bytes passed to write()
+        uint64_t bytes_submitted{0};
+        //! bytes the background thread has written to the file
+        uint64_t bytes_written{0};
+        uint64_t buffers_written{0};
+        //! time the background thread spent in fwrite / fflush
+        double write_seconds{0};
+        //! time writers spent waiting for a free buffer
+        double stall_seconds{0};
+
+        //! bytes per second written by the background thread
+        double throughput() const {
+            return write_seconds > 0 ? double(bytes_written) / write_seconds : 0.0;
+        }
+
+        std::string toStr() const;
+        static std::string class_name() { return "AsyncWriter::Stats"; }
+    };
+
+private:
+    struct Buffer {
+        struct Free {
+            void operator()(char* ptr) const;
+        };
+        std::unique_ptr<char[], Free> data;
+        size_t size{0};
+    };
+
+    FILE* _file;
+    const Options _options;
+    std::string _name;
+
+    std::vector<Buffer> _buffers;
+    //! buffers that can be filled (the front one is being filled)
+    std::deque<size_t> _free;
+    //! full buffers waiting for the background thread, in order
+    std::deque<size_t> _pending;
+    //! true while the background thread writes a buffer
+    bool _writing{false};
+    bool _terminate{false};
+    std::exception_ptr _exception;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _buffer_written, _buffer_ready;
+    Stats _stats;
+
+    std::thread _thread;
+
+public:
+    AsyncWriter(FILE* file, std::string name);
+    AsyncWriter(FILE* file, std::string name, Options options);
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    //! Flushes everything (errors are printed, not thrown) and stops the thread.
+    ~AsyncWriter();
+
+    //! Appends num_bytes of buffer. Rethrows errors of the background thread.
+    void write(const char* buffer, size_t num_bytes);
+
+    /**
+     * Waits until everything written so far has been passed to the
+     * operating system (fwrite + fflush). Rethrows errors of the
+     * background thread.
+     */
+    void flush();
+
+    Stats stats() const;
+
+private:
+    //! hands the partially filled buffer to the background thread
+    void submit(std::unique_lock<std::mutex>& guard);
+    void rethrow(std::unique_lock<std::mutex>& guard);
+    void run();
+};
+
+}
@@ -1,4 +1,15 @@
 #include "CSVReader.h"
+#include <misc/WorkStealingPool.h>
+#include <charconv>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define CMN_CSV_SSE2
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define CMN_CSV_NEON
+  #include <arm_neon.h>
+#endif
 
 namespace {
 
@@ -6,6 +17,77 @@ struct posix_closer {
     void operator()(int* fd) const { if (*fd != -1) ::close(*fd); }
 };
 
+/* First delimiter, quote or line break in [p, end), or end. */
+const char* findSpecial(const char* p, const char* end, char delim) {
+#if defined(CMN_CSV_SSE2)
+    const __m128i d  = _mm_set1_epi8(delim);
+    const __m128i q  = _mm_set1_epi8('"');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = _mm_movemask_epi8(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, d),  _mm_cmpeq_epi8(v, q)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))));
+        if (mask)
+            return p + std::countr_zero(static_cast<unsigned>(mask));
+    }
+#elif defined(CMN_CSV_NEON)
+    const uint8x16_t d  = vdupq_n_u8(static_cast<uint8_t>(delim));
+    const uint8x16_t q  = vdupq_n_u8('"');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    for (; end - p >= 16; p += 16) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        const uint8x16_t eq = vorrq_u8(vorrq_u8(vceqq_u8(v, d),  vceqq_u8(v, q)),
+                                       vorrq_u8(vceqq_u8(v, lf), vceqq_u8(v, cr)));
+        // 4 bits per byte
+        const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask)
+            return p + (std::countr_zero(mask) >> 2);
+    }
+#endif
+    for (; p < end; ++p) {
+        const char ch = *p;
+        if (ch == delim || ch == '"' || ch == '\n' || ch == '\r')
+            return p;
+    }
+    return end;
+}
+
+/* Position after the quote closing a quoted section that starts at p
+   (after the opening quote), or end. */
+const char* skipQuoted(const char* p, const char* end) {
+    while (p < end) {
+        auto q = static_cast<const char*>(std::memchr(p, '"', end - p));
+        if (!q)
+            return end;
+        if (q + 1 < end && q[1] == '"') {   // "" => literal "
+            p = q + 2;
+            continue;
+        }
+        return q + 1;
+    }
+    return end;
+}
+
+/* Fully quoted cells without escaped quotes are returned without quotes. */
+std::string_view makeCell(const char* begin, const char* end) {
+    const auto n = static_cast<std::size_t>(end - begin);
+    if (n >= 2 && *begin == '"' && end[-1] == '"'
+        && !std::memchr(begin + 1, '"', n - 2))
+    {
+        return {begin + 1, n - 2};
+    }
+    return {begin, n};
+}
+
+cmn::WorkStealingPool& csvPool() {
+    static cmn::WorkStealingPool pool(cmn::max(1u, cmn::hardware_concurrency()), "csv_pool");
+    return pool;
+}
+
 } // anonymous
 
 namespace cmn {
@@ -207,6 +289,277 @@ CSVReader::splitLine(std::string_view line, char delimiter)
     return tmp.nextRow();
 }
 
+/* ==== CSVScanner ======================================================== */
+
+CSVScanner::CSVScanner(std::string_view data, char delimiter)
+    : data_(data), delim_(delimiter)
+{}
+
+bool CSVScanner::nextRow(std::vector<std::string_view>& cells) {
+    cells.clear();
+    if (!hasNext())
+        return false;
+
+    const char* const begin = data_.data();
+    const char* const end   = begin + data_.size();
+    const char*       p     = begin + pos_;
+    const char*       cell  = p;
+
+    while (true) {
+        p = findSpecial(p, end, delim_);
+
+        if (p == end) {
+            // same as CSVReader: an empty field at EOF is dropped
+            auto last = makeCell(cell, p);
+            if (last.find('"') != std::string_view::npos) {
+                std::string value;
+                unescape(last, value);
+                if (!value.empty())
+                    cells.push_back(last);
+            } else if (!last.empty()) {
+                cells.push_back(last);
+            }
+            pos_ = data_.size();
+            return true;
+        }
+
+        const char ch = *p;
+        if (ch == '"') {
+            p = skipQuoted(p + 1, end);
+
+        } else if (ch == delim_) {
+            cells.push_back(makeCell(cell, p));
+            cell = ++p;
+
+        } else {
+            cells.push_back(makeCell(cell, p));
+            // swallow LF in CRLF
+            if (ch == '\r' && p + 1 < end && p[1] == '\n')
+                ++p;
+            pos_ = static_cast<std::size_t>(p + 1 - begin);
+            return true;
+        }
+    }
+}
+
+void CSVScanner::unescape(std::string_view cell, std::string& out) {
+    out.clear();
+    bool inQuotes = false;
+    for (std::size_t i = 0; i < cell.size(); ++i) {
+        const char ch = cell[i];
+        if (ch == '"') {
+            if (inQuotes && i + 1 < cell.size() && cell[i + 1] == '"') {
+                out.push_back('"');
+                ++i;
+            } else {
+                inQuotes = !inQuotes;
+            }
+            continue;
+        }
+        out.push_back(ch);
+    }
+}
+
+std::vector<std::string_view>
+CSVScanner::splitRows(std::string_view data, std::size_t parts)
+{
+    parts = std::clamp<std::size_t>(parts, 1, cmn::max(std::size_t(1), data.size()));
+    if (parts == 1)
+        return {data};
+
+    std::vector<std::size_t> bounds(parts + 1);
+    for (std::size_t k = 0; k <= parts; ++k)
+        bounds[k] = data.size() / parts * k;
+    bounds.back() = data.size();
+
+    // a piece starts inside quotes if there is an odd number of quotes
+    // before it ("" toggles twice, so escaped quotes don't matter)
+    std::vector<std::size_t> quotes(parts);
+    distribute_indexes([&](auto, std::size_t i, std::size_t e, auto) {
+        for (; i < e; ++i)
+            quotes[i] = static_cast<std::size_t>(std::count(
+                data.data() + bounds[i], data.data() + bounds[i + 1], '"'));
+    }, csvPool(), std::size_t(0), parts, narrow_cast<uint32_t>(parts));
+
+    std::vector<std::string_view> result;
+    std::size_t start = 0, count = 0;
+    for (std::size_t k = 1; k < parts; ++k) {
+        count += quotes[k - 1];
+        if (bounds[k] < start)
+            continue;
+
+        // first line break outside of quotes
+        bool inQuotes = count % 2 == 1;
+        std::size_t i = bounds[k];
+        for (; i < data.size(); ++i) {
+            const char ch = data[i];
+            if (ch == '"')
+                inQuotes = !inQuotes;
+            else if (!inQuotes && (ch == '\n' || ch == '\r'))
+                break;
+        }
+        if (i < data.size() && data[i] == '\r' && i + 1 < data.size() && data[i + 1] == '\n')
+            ++i;
+        if (i + 1 >= data.size())
+            break;
+
+        result.push_back(data.substr(start, i + 1 - start));
+        start = i + 1;
+    }
+    result.push_back(data.substr(start));
+    return result;
+}
+
+/* ==== readColumns ======================================================= */
+
+namespace {
+
+template<typename T> struct cell_value { using type = T; };
+template<typename T> struct cell_value<std::optional<T>> { using type = T; };
+
+template<typename T>
+std::optional<T> parseCell(std::string_view cell, std::string& scratch) {
+    if (cell.find('"') != std::string_view::npos) {
+        CSVScanner::unescape(cell, scratch);
+        cell = scratch;
+    }
+    while (!cell.empty() && (cell.front() == ' ' || cell.front() == '\t'))
+        cell.remove_prefix(1);
+    while (!cell.empty() && (cell.back() == ' ' || cell.back() == '\t'))
+        cell.remove_suffix(1);
+    if (!cell.empty() && cell.front() == '+')
+        cell.remove_prefix(1);
+    if (cell.empty())
+        return std::nullopt;
+
+    T value;
+#if defined(__clang__)
+    if constexpr (std::floating_point<T>) {
+        // libc++ has no floating point from_chars
+        char buffer[64];
+        if (cell.size() >= sizeof(buffer))
+            return std::nullopt;
+        std::memcpy(buffer, cell.data(), cell.size());
+        buffer[cell.size()] = 0;
+
+        char* last;
+        value = static_cast<T>(std::strtod(buffer, &last));
+        if (last != buffer + cell.size())
+            return std::nullopt;
+        return value;
+    } else
+#endif
+    {
+        auto [ptr, ec] = std::from_chars(cell.data(), cell.data() + cell.size(), value);
+        if (ec != std::errc{} || ptr != cell.data() + cell.size())
+            return std::nullopt;
+        return value;
+    }
+}
+
+template<typename CellT>
+void parsePiece(std::string_view data,
+                char delimiter,
+                std::vector<std::vector<CellT>>& columns)
+{
+    using T = typename cell_value<CellT>::type;
+
+    std::vector<std::string_view> cells;
+    std::string scratch;
+    CSVScanner scanner(data, delimiter);
+
+    while (scanner.nextRow(cells)) {
+        for (std::size_t c = 0; c < columns.size(); ++c) {
+            auto value = c < cells.size() ? parseCell<T>(cells[c], scratch) : std::nullopt;
+            if constexpr (std::same_as<CellT, T>)
+                columns[c].push_back(value ? *value : std::numeric_limits<T>::quiet_NaN());
+            else
+                columns[c].push_back(value);
+        }
+    }
+}
+
+} // anonymous
+
+template<typename CellT>
+ColumnTable<CellT> readColumns(std::string_view data,
+                               char delimiter,
+                               bool hasHeader,
+                               unsigned threads)
+{
+    static_assert(!std::same_as<CellT, typename cell_value<CellT>::type>
+                  || std::floating_point<CellT>,
+                  "Plain columns need a floating point type (missing values are NaN), use std::optional otherwise.");
+
+    ColumnTable<CellT> table;
+    CSVScanner scanner(data, delimiter);
+    std::vector<std::string_view> cells;
+    std::string scratch;
+
+    if (hasHeader) {
+        scanner.nextRow(cells);
+        for (auto cell : cells) {
+            CSVScanner::unescape(cell, scratch);
+            table.header.push_back(scratch);
+        }
+    } else {
+        // peek at the first row for the number of columns
+        CSVScanner(data, delimiter).nextRow(cells);
+    }
+    table.columns.resize(cells.size());
+
+    const auto body = data.substr(scanner.position());
+    if (table.columns.empty() || body.empty())
+        return table;
+
+    if (threads == 0)
+        threads = cmn::max(1u, cmn::hardware_concurrency());
+
+    // pieces of at least 1MiB, with a few more pieces than threads
+    // so that rows of different length even out
+    constexpr std::size_t min_piece = 1u << 20;
+    const auto pieces = CSVScanner::splitRows(body,
+        cmn::min(std::size_t(threads) * 4u, body.size() / min_piece + 1u));
+
+    if (pieces.size() == 1) {
+        parsePiece(body, delimiter, table.columns);
+        return table;
+    }
+
+    std::vector<std::vector<std::vector<CellT>>> results(pieces.size());
+    distribute_indexes_dynamic([&](auto, std::size_t i, std::size_t e, auto) {
+        for (; i < e; ++i) {
+            results[i].resize(table.columns.size());
+            parsePiece(pieces[i], delimiter, results[i]);
+        }
+    }, csvPool(), std::size_t(0), pieces.size(), DistributeOptions{
+        .threads = threads,
+        .chunk = 1
+    });
+
+    // pieces are concatenated in order
+    for (std::size_t c = 0; c < table.columns.size(); ++c) {
+        std::size_t rows = 0;
+        for (auto& r : results)
+            rows += r[c].size();
+
+        auto& column = table.columns[c];
+        column.reserve(rows);
+        for (auto& r : results) {
+            column.insert(column.end(), r[c].begin(), r[c].end());
+            r[c] = {};
+        }
+    }
+    return table;
+}
+
+template ColumnTable<double>                 readColumns(std::string_view, char, bool, unsigned);
+template ColumnTable<float>                  readColumns(std::string_view, char, bool, unsigned);
+template ColumnTable<std::optional<double>>  readColumns(std::string_view, char, bool, unsigned);
+template ColumnTable<std::optional<float>>   readColumns(std::string_view, char, bool, unsigned);
+template ColumnTable<std::optional<int>>     readColumns(std::string_view, char, bool, unsigned);
+template ColumnTable<std::optional<int64_t>> readColumns(std::string_view, char, bool, unsigned);
+
 /* ==== CSVStreamReader (mmap adapter) ==================================== */
 
 CSVStreamReader::CSVStreamReader(const file::Path& path,
@@ -213,6 +213,9 @@ public:
     }
     
     std::size_t fastLineCount() const;
+    
+    char delimiter() const { return delim_; }
+    bool hasHeader() const { return hasHeader_; }
 
 private:
     std::string_view data_;
@@ -222,6 +225,94 @@ private:
     std::vector<std::string> header_;
 };
 
+/**
+ * @brief Zero‑allocation CSV scanner that returns cells as views into the
+ *        scanned buffer (e.g. @ref FileBuffer::view()).
+ *
+ * The grammar is the same as for @ref CSVReader, but nothing is copied:
+ *
+ * * Cells are the raw bytes between delimiters. Quoted cells without
+ *   escaped quotes are returned without the surrounding quotes.
+ * * Any cell that still contains a <code>"</code> has to be passed through
+ *   @ref unescape to get the value @ref CSVReader would have returned.
+ *
+ * Delimiters, quotes and line endings are searched 16 bytes at a time
+ * (SSE2 / NEON) instead of character by character.
+ *
+ * ```
+ * std::vector<std::string_view> cells;   // reused for all rows
+ * cmn::CSVScanner scanner(buffer.view(), ';');
+ * while (scanner.nextRow(cells)) { ... }
+ * ```
+ */
+class CSVScanner {
+public:
+    explicit CSVScanner(std::string_view data, char delimiter = ',');
+
+    [[nodiscard]] bool hasNext() const { return pos_ < data_.size(); }
+
+    /** Replace @p cells with the cells of the next row. Returns false when
+        there are no rows left. */
+    bool nextRow(std::vector<std::string_view>& cells);
+
+    /** Byte offset of the next row within the data. */
+    std::size_t position() const { return pos_; }
+
+    /** Write the value of a (raw) cell to @p out, resolving quotes. */
+    static void unescape(std::string_view cell, std::string& out);
+
+    /**
+     * Split @p data into (at most) @p parts consecutive pieces of roughly
+     * the same size that each start at the beginning of a row. Line breaks
+     * inside quoted cells are taken into account (quotes are counted in
+     * parallel first, so this needs two passes over the data).
+     */
+    static std::vector<std::string_view> splitRows(std::string_view data,
+                                                   std::size_t parts);
+
+private:
+    std::string_view data_;
+    std::size_t pos_{0};
+    char delim_;
+};
+
+/**
+ * @brief Column‑major table of typed cells, see @ref readColumns.
+ */
+template<typename CellT>
+struct ColumnTable {
+    std::vector<std::string>         header;
+    std::vector<std::vector<CellT>>  columns;
+
+    std::size_t size() const { return columns.empty() ? 0 : columns.front().size(); }
+
+    /* Column by header name, throws if there is no such column. */
+    const std::vector<CellT>& column(std::string_view name) const {
+        auto it = std::find(header.begin(), header.end(), name);
+        if (it == header.end())
+            throw InvalidArgumentException("Cannot find column ", name, " in ", header, ".");
+        return columns[std::distance(header.begin(), it)];
+    }
+};
+
+/**
+ * @brief Parse all cells of @p data straight into contiguous columns.
+ *
+ * `CellT` is either a number type (`float`, `double`, `int`, `int64_t`) or
+ * `std::optional` of one. Missing or unparsable cells become `std::nullopt`,
+ * or NaN for plain floating point columns (plain integral columns are not
+ * supported, since they could not represent them). The number of columns is
+ * taken from the header, or from the first row if there is none.
+ *
+ * Rows are parsed with up to @p threads threads (0 = all cores), each one
+ * working on a piece of the data that starts at a row boundary.
+ */
+template<typename CellT>
+ColumnTable<CellT> readColumns(std::string_view data,
+                               char delimiter = ',',
+                               bool hasHeader = true,
+                               unsigned threads = 0);
+
 /**
  * @brief RAII memory‑mapped read‑only view of a whole file.
  *
@@ -274,6 +365,13 @@ public:
 
     template<typename NumberT>
     Table<std::optional<NumberT>> readNumericTableOptional();
+    
+    /** Parse the whole file into typed columns, see @ref readColumns. */
+    template<typename CellT>
+    ColumnTable<CellT> readColumns(unsigned threads = 0) const {
+        return cmn::readColumns<CellT>(buf_.view(), rdr_.delimiter(), rdr_.hasHeader(), threads);
+    }
+    
     auto& header() const { return rdr_.header(); }
     std::size_t fastLineCount() const { return rdr_.fastLineCount(); }
 
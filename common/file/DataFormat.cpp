@@ -1,5 +1,6 @@
 #include "DataFormat.h"
 #include <utility>
+#include <misc/Trace.h>
 #ifndef WIN32
 #include <sys/mman.h>
 #endif
@@ -137,11 +138,28 @@ void memunmap( mappedRegion *hReg)
 #endif
 
 DataFormat::~DataFormat() {
-    if(f || _mmapped)
-        close();
+    if(f || _mmapped) {
+        try {
+            close();
+        } catch(const std::exception& ex) {
+            FormatExcept("Failed to close ", _filename, ": ", ex.what());
+        }
+    }
 }
 
 void DataFormat::close() {
+    /// errors of the background thread might only show up in the last flush.
+    /// the file is closed either way, then the error is passed on.
+    std::exception_ptr exception;
+    if(_async_writer) {
+        try {
+            _async_writer->flush();
+        } catch(...) {
+            exception = std::current_exception();
+        }
+        _async_writer = nullptr;
+    }
+    
     if(f)
         f = nullptr;
     
@@ -157,6 +175,9 @@ void DataFormat::close() {
     
     _supports_fast = false;
     _file_offset = 0;
+    
+    if(exception)
+        std::rethrow_exception(exception);
 }
 
 void DataFormat::start_modifying() {
@@ -189,6 +210,10 @@ void DataFormat::seek(uint64_t pos) {
 
         if (!f)
             throw U_EXCEPTION("File not open.");
+        
+        /// buffered data belongs to the old position
+        if (_async_writer)
+            _async_writer->flush();
 
         // Validate position is within valid range for _fseeki64
         if (pos > INT64_MAX) {
@@ -221,6 +246,10 @@ uint64_t DataFormat::current_offset() const {
     return _file_offset;
 }
 uint64_t DataFormat::tell() const {
+    /// the file itself lags behind while data is being buffered
+    if (_async_writer)
+        return _file_offset;
+    
     if (f) {
 #ifdef _WIN32
         if (auto t = _ftelli64(f.get());
@@ -356,19 +385,20 @@ void DataFormat::start_writing(bool overwrite) {
 
 void DataFormat::stop_writing() {
     assert(_open_for_writing);
-    close();
-    
+    /// close() can throw, but the file is closed afterwards either way
     _open_for_writing = false;
     _header_written = false;
+    
+    close();
 }
 
 void DataFormat::stop_modifying() {
     assert(_open_for_modifying);
-    close();
-    
     _open_for_modifying = false;
     _open_for_writing = false;
     _header_written = false;
+    
+    close();
 }
 
 uint64_t DataFormat::read_data(uint64_t num_bytes, char *buffer) {
@@ -379,6 +409,8 @@ uint64_t DataFormat::read_data(uint64_t num_bytes, char *buffer) {
         std::lock_guard<std::mutex> guard(_internal_modification);
         if(!f)
             throw U_EXCEPTION("File is not opened yet.");
+        if(_async_writer)
+            _async_writer->flush();
         if(feof(f.get()))
             throw U_EXCEPTION("File is over.");
         
@@ -439,9 +471,18 @@ const char* ReadonlyMemoryWrapper::read_data_fast(uint64_t num_bytes) {
 }
 
 uint64_t DataFormat::write_data(uint64_t num_bytes, const char *buffer) {
+    CMN_TRACE_SCOPE_ARG("DataFormat::write_data", num_bytes);
     if(!f)
         throw U_EXCEPTION("File is not opened yet.");
     
+    if(_async_writer) {
+        _async_writer->write(buffer, num_bytes);
+        
+        uint64_t before = _file_offset;
+        _file_offset += num_bytes;
+        return before;
+    }
+    
     uint64_t written;
     if((written = std::fwrite(buffer, sizeof(char), num_bytes, f.get())) != num_bytes) {
 #ifdef __cpp_lib_filesystem
@@ -471,6 +512,8 @@ void DataFormat::truncate() {
     if(f
        && _open_for_modifying)
     {
+        flush();
+        
         auto fd = fileno(f.get());
         assert(fd != 0);
         
@@ -486,10 +529,42 @@ void DataFormat::truncate() {
     }
 }
 
+void DataFormat::enable_async_writes(AsyncWriter::Options options) {
+    if(not f || not (_open_for_writing || _open_for_modifying))
+        throw U_EXCEPTION("Cannot write asynchronously to ", _filename, " since it is not open for writing.");
+    if(_async_writer)
+        return;
+    
+    /// the writer appends at the current position of the file
+    fflush(f.get());
+    _async_writer = std::make_unique<AsyncWriter>(f.get(), _filename.filename(), options);
+}
+
+void DataFormat::disable_async_writes() {
+    if(not _async_writer)
+        return;
+    
+    _async_writer->flush();
+    _async_writer = nullptr;
+}
+
+void DataFormat::flush() {
+    if(_async_writer)
+        _async_writer->flush();
+}
+
+AsyncWriter::Stats DataFormat::async_write_stats() const {
+    if(_async_writer)
+        return _async_writer->stats();
+    return {};
+}
+
 void DataFormat::sync() {
     if(f
        && (_open_for_modifying || _open_for_writing))
     {
+        flush();
+        
         auto fd = fileno(f.get());
         assert(fd != 0);
         //Print("* syncing to ", tell());
@@ -771,6 +846,7 @@ DataFormat::DataFormat(DataFormat&& other) noexcept
       _data_container(std::move(other._data_container)),
 #endif
       _internal_modification(), // Mutexes cannot be moved, so we'll initialize a new one
+      _async_writer(std::move(other._async_writer)),
       _reading_file_size(other._reading_file_size),
 #if defined(WIN32)
       reg(std::move(other.reg)),
@@ -5,6 +5,7 @@
 #include <sys/stat.h>
 #include <misc/Path.h>
 #include <misc/CropOffsets.h>
+#include <file/AsyncWriter.h>
 
 namespace cmn {
 #if defined(WIN32)
@@ -227,6 +228,8 @@ namespace cmn {
         std::vector<char> _data_container;
 #endif
         std::mutex _internal_modification;
+        //! set while writes are buffered and written in the background
+        std::unique_ptr<AsyncWriter> _async_writer;
         
         GETTER(uint64_t, reading_file_size);
 #if defined(WIN32)
@@ -251,8 +254,24 @@ namespace cmn {
         void promote_to_modify();
         
         void truncate();
+        //! flush()es and then waits until all data is on disk
         void sync();
         
+        /**
+         * From now on, write_data only copies into staging buffers, which
+         * are written to the file by a background thread (see AsyncWriter).
+         * Seeking to a different position, truncate(), sync() and closing
+         * the file flush() first. Only available in write / modify mode.
+         */
+        void enable_async_writes(AsyncWriter::Options options = {});
+        //! Flushes and goes back to writing on the calling thread.
+        void disable_async_writes();
+        bool async_writes() const { return _async_writer != nullptr; }
+        //! Waits until all asynchronously written data has been passed to the OS.
+        void flush();
+        //! Counters of the async writer (all zero if async writes are disabled).
+        AsyncWriter::Stats async_write_stats() const;
+        
         [[nodiscard("This method tells you whether the file is open.")]] bool is_open() const { return f || _mmapped; }
         
         const file::Path& filename() const { return _filename; }
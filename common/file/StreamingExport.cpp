@@ -0,0 +1,322 @@
+#include "StreamingExport.h"
+#include <misc/GlobalSettings.h>
+#include <misc/cnpy_wrapper.h>
+#include <charconv>
+
+namespace cmn::file {
+
+namespace {
+
+//! enough for any double in fixed notation with up to 255 decimals
+constexpr size_t max_number_length = 640;
+
+template<typename T>
+void append_number(std::string& output, T value, uint8_t decimals) {
+    char buffer[max_number_length];
+    char* end;
+    if constexpr(std::floating_point<T>) {
+#if defined(__clang__)
+        /// floating point to_chars is not available everywhere with libc++
+        const int n = std::snprintf(buffer, sizeof(buffer), "%.*f", int(decimals), double(value));
+        end = buffer + min(max(n, 0), int(sizeof(buffer)) - 1);
+#else
+        end = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, decimals).ptr;
+#endif
+    } else {
+        end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    }
+    output.append(buffer, end);
+}
+
+void append_quoted(std::string& output, std::string_view text) {
+    if(text.find_first_of(",\"\n\r") == std::string_view::npos) {
+        output += text;
+        return;
+    }
+
+    output += '"';
+    for(auto c : text) {
+        if(c == '"')
+            output += '"';
+        output += c;
+    }
+    output += '"';
+}
+
+//! default constructed column data of the given variant index
+template<size_t I = 0>
+StreamingExport::ColumnData make_column(size_t type) {
+    if constexpr(I < std::variant_size_v<StreamingExport::ColumnData>) {
+        if(type == I)
+            return StreamingExport::ColumnData(std::in_place_index<I>);
+        return make_column<I + 1>(type);
+    } else {
+        throw U_EXCEPTION("Unknown column type ", type, ".");
+    }
+}
+
+size_t column_size(const StreamingExport::ColumnData& data) {
+    return std::visit([](auto& values) -> size_t {
+        if constexpr(std::same_as<std::remove_cvref_t<decltype(values)>, std::monostate>)
+            return 0;
+        else
+            return values.size();
+    }, data);
+}
+
+}
+
+size_t StreamingExport::Batch::rows() const {
+    size_t rows = 0;
+    for(size_t i = 0; i < _columns.size(); ++i) {
+        const size_t N = column_size(_columns[i]);
+        if(i == 0)
+            rows = N;
+        else if(N != rows)
+            throw InvalidArgumentException("Column ", i, " of batch ", _index, " has ", N, " rows instead of ", rows, ".");
+    }
+    return rows;
+}
+
+StreamingExport::StreamingExport(const Path& path, Format format, std::vector<std::string> header)
+    : StreamingExport(path, format, std::move(header), Options{})
+{ }
+
+StreamingExport::StreamingExport(const Path& path, Format format, std::vector<std::string> header, Options options)
+    : _format(format),
+      _header(std::move(header)),
+      _options(options),
+      _decimals(options.decimals
+                ? *options.decimals
+                : READ_SETTING(output_csv_decimals, uint8_t)),
+      _types(_header.size(), 0)
+{
+    if(_header.empty())
+        throw InvalidArgumentException("Cannot export a table without columns to ", path, ".");
+    if(_options.max_pending == 0)
+        throw InvalidArgumentException("max_pending has to be at least 1.");
+
+    const std::string_view extension = _format == Format::csv ? "csv" : "npz";
+    _path = path.has_extension(extension) ? path : path.add_extension(extension);
+
+    if(_format == Format::csv) {
+        _file = _path.fopen("wb");
+        if(not _file)
+            throw U_EXCEPTION("Cannot open file ", _path, ": ", (const char*)strerror(errno));
+        _writer = std::make_unique<AsyncWriter>(_file.get(), _path.filename(), _options.writer);
+
+        std::string line;
+        for(size_t i = 0; i < _header.size(); ++i) {
+            if(i > 0)
+                line += ',';
+            append_quoted(line, _header[i]);
+        }
+        line += '\n';
+        _writer->write(line.data(), line.size());
+
+    } else {
+        for(size_t i = 0; i < _header.size(); ++i) {
+            auto file = column_path(i).fopen("w+b");
+            if(not file) {
+                auto error = (const char*)strerror(errno);
+                _column_files.clear();
+                for(size_t j = 0; j < i; ++j)
+                    column_path(j).delete_file();
+                throw U_EXCEPTION("Cannot open temporary file ", column_path(i), ": ", error);
+            }
+            _column_files.emplace_back(std::move(file));
+        }
+    }
+}
+
+StreamingExport::~StreamingExport() {
+    try {
+        close();
+    } catch(const std::exception& ex) {
+        FormatExcept("Failed to export ", _path, ": ", ex.what());
+    }
+}
+
+Path StreamingExport::column_path(size_t column) const {
+    return Path(_path.str() + "." + Meta::toStr(column) + ".tmp");
+}
+
+size_t StreamingExport::rows() const {
+    std::unique_lock guard(_mutex);
+    return _rows;
+}
+
+void StreamingExport::format_csv(Batch& batch) const {
+    const size_t rows = batch.rows();
+    batch._formatted.clear();
+    batch._formatted.reserve(rows * _header.size() * (_decimals + 8u));
+
+    for(size_t row = 0; row < rows; ++row) {
+        for(size_t i = 0; i < batch._columns.size(); ++i) {
+            if(i > 0)
+                batch._formatted += ',';
+            std::visit([&](auto& values) {
+                if constexpr(not std::same_as<std::remove_cvref_t<decltype(values)>, std::monostate>)
+                    append_number(batch._formatted, values[row], _decimals);
+            }, batch._columns[i]);
+        }
+        batch._formatted += '\n';
+    }
+}
+
+void StreamingExport::write(Batch&& batch) {
+    if(batch._columns.size() != _header.size())
+        throw InvalidArgumentException("Batch ", batch._index, " has ", batch._columns.size(), " columns instead of ", _header.size(), ".");
+
+    /// formatting happens outside of the lock, in parallel
+    if(_format == Format::csv)
+        format_csv(batch);
+    else
+        (void)batch.rows();
+
+    std::unique_lock guard(_mutex);
+    auto check = [&]() {
+        if(_exception)
+            std::rethrow_exception(_exception);
+        if(_closed)
+            throw U_EXCEPTION("Cannot write batch ", batch._index, " to ", _path, " after it was closed.");
+        if(batch._index < _next || _pending.contains(batch._index))
+            throw InvalidArgumentException("Batch ", batch._index, " was written to ", _path, " twice.");
+    };
+
+    check();
+    if(batch._index != _next) {
+        _turn.wait(guard, [&]() {
+            return batch._index < _next + _options.max_pending || _closed || _exception;
+        });
+        check();
+
+        if(batch._index != _next) {
+            _pending.emplace(batch._index, std::move(batch));
+            return;
+        }
+    }
+
+    try {
+        emit(batch);
+        ++_next;
+
+        for(auto it = _pending.begin();
+            it != _pending.end() && it->first == _next;
+            it = _pending.erase(it))
+        {
+            emit(it->second);
+            ++_next;
+        }
+
+    } catch(...) {
+        _exception = std::current_exception();
+        _turn.notify_all();
+        throw;
+    }
+
+    _turn.notify_all();
+}
+
+void StreamingExport::emit(Batch& batch) {
+    for(size_t i = 0; i < batch._columns.size(); ++i) {
+        const size_t type = batch._columns[i].index();
+        if(type == 0)
+            continue;
+        if(_types[i] == 0)
+            _types[i] = type;
+        else if(_types[i] != type)
+            throw InvalidArgumentException("Column ", _header[i], " of batch ", batch._index, " has a different type than in previous batches.");
+    }
+
+    const size_t rows = batch.rows();
+    if(_format == Format::csv) {
+        _writer->write(batch._formatted.data(), batch._formatted.size());
+
+    } else if(rows > 0) {
+        for(size_t i = 0; i < batch._columns.size(); ++i) {
+            std::visit([&](auto& values) {
+                if constexpr(not std::same_as<std::remove_cvref_t<decltype(values)>, std::monostate>) {
+                    const size_t bytes = values.size() * sizeof(values.front());
+                    if(_column_files[i].write(values.data(), bytes) != bytes)
+                        throw U_EXCEPTION("Cannot write to ", column_path(i), ": ", (const char*)strerror(errno));
+                }
+            }, batch._columns[i]);
+        }
+    }
+
+    _rows += rows;
+}
+
+void StreamingExport::close() {
+    std::unique_lock guard(_mutex);
+    if(_closed)
+        return;
+    _closed = true;
+    _turn.notify_all();
+
+    auto discard = [this]() {
+        _writer = nullptr;
+        _file.reset();
+        _column_files.clear();
+        if(_format == Format::npz) {
+            for(size_t i = 0; i < _header.size(); ++i)
+                column_path(i).delete_file();
+        }
+    };
+
+    if(_exception) {
+        discard();
+        std::rethrow_exception(_exception);
+    }
+    if(not _pending.empty()) {
+        const auto waiting = _pending.size();
+        _pending.clear();
+        discard();
+        throw U_EXCEPTION("Cannot finish ", _path, ": batch ", _next, " is missing (", waiting, " batches waiting for it).");
+    }
+
+    if(_format == Format::csv) {
+        try {
+            _writer->flush();
+        } catch(...) {
+            discard();
+            throw;
+        }
+        _writer = nullptr;
+        _file.reset();
+        return;
+    }
+
+    /// move columns into the npz one by one
+    try {
+        for(size_t i = 0; i < _header.size(); ++i) {
+            auto& file = _column_files[i];
+            std::rewind(file.get());
+
+            /// columns without any values are stored as empty double arrays
+            ColumnData data = _types[i] == 0
+                ? ColumnData(std::vector<double>{})
+                : make_column(_types[i]);
+
+            std::visit([&](auto& values) {
+                if constexpr(not std::same_as<std::remove_cvref_t<decltype(values)>, std::monostate>) {
+                    values.resize(_rows);
+                    const size_t bytes = values.size() * sizeof(typename std::remove_cvref_t<decltype(values)>::value_type);
+                    if(bytes > 0 && file.read(values.data(), bytes) != bytes)
+                        throw U_EXCEPTION("Cannot read back ", column_path(i), ".");
+                    npz_save(_path.str(), _header[i], values.data(), { values.size() }, i == 0 ? "w" : "a");
+                }
+            }, data);
+
+            file.reset();
+            column_path(i).delete_file();
+        }
+    } catch(...) {
+        discard();
+        throw;
+    }
+    _column_files.clear();
+}
+
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/Path.h>
+#include <file/AsyncWriter.h>
+
+namespace cmn::file {
+
+/**
+ * Writes tables with typed columns to CSV or NPZ files batch by batch,
+ * instead of collecting all cells as strings first (see Table / CSVExport).
+ *
+ * Batches are numbered from 0 and can be filled and submitted by several
+ * threads at once; they are written in the order of their numbers, no
+ * matter in which order they arrive. Numbers are formatted (CSV) by the
+ * submitting thread, so that part runs in parallel, too.
+ *
+ *  - CSV: formatted rows go straight to the file (through an AsyncWriter).
+ *  - NPZ: every column is appended to a temporary file next to the output.
+ *    close() then moves them into the .npz one column at a time, so at most
+ *    one column is ever held in memory.
+ *
+ * ```
+ * StreamingExport exporter(path, StreamingExport::Format::csv, {"frame", "x", "y"});
+ * distribute_indexes([&](auto, auto start, auto end, auto) {
+ *     for(auto i = start; i < end; ++i) {
+ *         auto batch = exporter.batch(i);
+ *         fill(batch.column<uint32_t>(0), batch.column<float>(1), ...);
+ *         exporter.write(std::move(batch));
+ *     }
+ * }, pool, size_t(0), num_batches);
+ * exporter.close();
+ * ```
+ */
+class StreamingExport {
+public:
+    enum class Format {
+        csv,
+        npz
+    };
+
+    struct Options {
+        //! decimals of floating point numbers in CSV files (default: output_csv_decimals)
+        std::optional<uint8_t> decimals;
+        /**
+         * Batches that arrive early are kept in memory until it is their
+         * turn. write() blocks if a batch would be more than this number
+         * ahead of the next one to be written.
+         */
+        size_t max_pending = 64;
+        AsyncWriter::Options writer;
+    };
+
+    using ColumnData = std::variant<
+        std::monostate,
+        std::vector<double>,
+        std::vector<float>,
+        std::vector<int64_t>,
+        std::vector<uint64_t>,
+        std::vector<int32_t>,
+        std::vector<uint32_t>>;
+
+    //! Rows for one StreamingExport::write call, stored column by column.
+    class Batch {
+        size_t _index;
+        std::vector<ColumnData> _columns;
+        //! filled in by write() for CSV files
+        std::string _formatted;
+
+        friend class StreamingExport;
+
+    public:
+        Batch(size_t index, size_t num_columns)
+            : _index(index), _columns(num_columns)
+        { }
+
+        size_t index() const { return _index; }
+
+        /**
+         * Values of the given column. The type of a column is set by its
+         * first use, and has to be the same for all batches of an export.
+         */
+        template<typename T>
+        std::vector<T>& column(size_t i) {
+            auto& data = _columns.at(i);
+            if(std::holds_alternative<std::monostate>(data))
+                data = std::vector<T>{};
+            if(auto ptr = std::get_if<std::vector<T>>(&data))
+                return *ptr;
+            throw InvalidArgumentException("Column ", i, " of batch ", _index, " has a different type.");
+        }
+
+        //! number of rows, throws if the columns have different lengths
+        size_t rows() const;
+    };
+
+private:
+    Path _path;
+    Format _format;
+    std::vector<std::string> _header;
+    Options _options;
+    uint8_t _decimals;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _turn;
+    //! index of the next batch to be written
+    size_t _next{0};
+    std::map<size_t, Batch> _pending;
+    size_t _rows{0};
+    bool _closed{false};
+    //! first error while writing, rethrown by write() and close()
+    std::exception_ptr _exception;
+
+    //! column types, fixed by the first batch that was written
+    std::vector<size_t> _types;
+
+    FilePtr _file;
+    std::unique_ptr<AsyncWriter> _writer;
+    //! npz: one temporary file per column
+    std::vector<FilePtr> _column_files;
+
+public:
+    StreamingExport(const Path& path, Format format, std::vector<std::string> header);
+    StreamingExport(const Path& path, Format format, std::vector<std::string> header, Options options);
+    StreamingExport(const StreamingExport&) = delete;
+    StreamingExport& operator=(const StreamingExport&) = delete;
+
+    //! Calls close() if that did not happen yet (errors are printed).
+    ~StreamingExport();
+
+    //! The output file (with the csv / npz extension).
+    const Path& path() const { return _path; }
+
+    Batch batch(size_t index) const { return Batch(index, _header.size()); }
+
+    /**
+     * Hands a batch over for writing. Thread-safe; every index has to be
+     * written exactly once. Throws if the batch does not fit the header or
+     * the types of previous batches (also if it is written by another
+     * thread, after this batch arrived).
+     */
+    void write(Batch&& batch);
+
+    //! Number of rows written to the file so far.
+    size_t rows() const;
+
+    /**
+     * Writes everything and closes the file. Throws if batches are
+     * missing, i.e. if not every index up to the largest one was written.
+     */
+    void close();
+
+private:
+    void format_csv(Batch& batch) const;
+    //! writes the next batch, needs the lock
+    void emit(Batch& batch);
+    Path column_path(size_t column) const;
+};
+
+}
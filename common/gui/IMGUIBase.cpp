@@ -37,6 +37,7 @@
 
 #include <misc/colors.h>
 #include <gui/Passthrough.h>
+#include <misc/Trace.h>
 
 namespace cmn::gui {
 
@@ -1148,6 +1149,7 @@ void IMGUIBase::process_main_queue() {
     }
 
     void IMGUIBase::paint(DrawStructure& s) {
+        CMN_TRACE_SCOPE("IMGUIBase::paint");
         int fw, fh;
         auto window = _platform->window_handle();
         
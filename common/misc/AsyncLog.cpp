@@ -0,0 +1,446 @@
+#include "AsyncLog.h"
+#include <csignal>
+#include <bit>
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+namespace cmn {
+
+namespace {
+
+/**
+ * Bounded multi-producer queue (after Dmitry Vyukov): every slot has a
+ * sequence number that tells producers whether it is free and the consumer
+ * whether it has been written, so neither of them needs a lock.
+ */
+struct Slot {
+    std::atomic<size_t> sequence{0};
+    LogRecord record;
+};
+
+struct State {
+    std::unique_ptr<Slot[]> slots;
+    size_t mask{0};
+    AsyncLog::Options options;
+
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    //! records before this position have been written (dequeue_pos runs ahead while writing)
+    alignas(64) std::atomic<size_t> written_pos{0};
+
+    std::atomic<bool> running{false}, terminate{false}, sleeping{false};
+    //! threads that are currently in log_async
+    std::atomic<uint32_t> producers{0};
+    std::atomic<uint64_t> written{0}, dropped{0}, unreported_drops{0};
+
+    std::mutex mutex;
+    std::condition_variable wake, written_variable;
+    std::thread thread;
+    std::atomic<std::thread::id> thread_id;
+
+    bool try_push(LogRecord& record) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for(;;) {
+            auto& slot = slots[pos & mask];
+            const size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = intptr_t(seq) - intptr_t(pos);
+            if(diff == 0) {
+                if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.record = std::move(record);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if(diff < 0) {
+                return false;
+            } else
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    //! only ever called by one thread at a time
+    bool try_pop(LogRecord& record) {
+        const size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        auto& slot = slots[pos & mask];
+        if(slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        record = std::move(slot.record);
+        slot.sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        const size_t pos = dequeue_pos.load(std::memory_order_acquire);
+        return slots[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+};
+
+//! never destroyed, so logging during static destruction does not crash
+State& state() {
+    static State* _state = new State();
+    return *_state;
+}
+
+std::mutex& control_mutex() {
+    static std::mutex* _mutex = new std::mutex();
+    return *_mutex;
+}
+
+//! the time string only changes once per second
+const std::string& record_time(const LogRecord& record) {
+    static thread_local int64_t last_second = -1;
+    static thread_local std::string last_string;
+
+    const auto second = std::chrono::duration_cast<std::chrono::seconds>(record.time.time_since_epoch()).count();
+    if(second != last_second) {
+        last_second = second;
+        last_string = time_string(record.time);
+    }
+    return last_string;
+}
+
+std::string file_name(const char* path) {
+    auto universal = utils::find_replace(path, "\\", "/");
+    auto split = utils::split(universal, '/');
+    return split.empty() ? universal : (std::string)split.back();
+}
+
+/// renders a record the same way the synchronous Print & co. do
+void write_record(const LogRecord& record) {
+    static constexpr auto bracket_color = ParseValue<FormatterType::UNIX>::bracket_color;
+    static constexpr auto UNIX = FormatterType::UNIX;
+    using Kind = LogRecord::Kind;
+
+    const auto& time = record_time(record);
+
+    std::string str;
+    switch(record.kind) {
+        case Kind::PRINT:
+        case Kind::NO_NEWLINE:
+            str = console_color<bracket_color, UNIX>("[")
+                + console_color<FormatColor::CYAN, UNIX>(time)
+                + console_color<bracket_color, UNIX>("]") + " ";
+            break;
+        case Kind::PREFIXED:
+            str = console_color<bracket_color, UNIX>("[")
+                + console_color<FormatColor::CYAN, UNIX>(time)
+                + " "
+                + tinted<UNIX>(record.color, record.label)
+                + console_color<bracket_color, UNIX>("]") + " ";
+            break;
+        case Kind::THREAD:
+            str = console_color<bracket_color, UNIX>("[")
+                + console_color<FormatColor::CYAN, UNIX>(time)
+                + " "
+                + console_color<FormatColor::YELLOW, UNIX>(record.label)
+                + console_color<bracket_color, UNIX>("]") + " ";
+            break;
+        case Kind::LOCATION:
+            str = console_color<bracket_color, UNIX>("[")
+                + tinted<UNIX>(record.color,
+                    std::string(PrefixLiterals::names[(size_t)record.prefix]) + " " + time
+                    + " " + file_name(record.file) + ":" + std::to_string(record.line))
+                + console_color<bracket_color, UNIX>("]") + " ";
+            break;
+    }
+
+    log_to_terminal(str + untag<UNIX>(record.text), false, record.kind != Kind::NO_NEWLINE);
+
+#if COMMONS_FORMAT_LOG_TO_FILE
+    if(has_log_file()) {
+        static constexpr auto HTML = FormatterType::HTML;
+        str = console_color<bracket_color, HTML>("[")
+            + console_color<FormatColor::CYAN, HTML>(time);
+        if(record.kind == Kind::PREFIXED)
+            str += " " + tinted<HTML>(record.color, record.label);
+        str += console_color<bracket_color, HTML>("] ") + untag<HTML>(record.text);
+
+        if(record.kind == Kind::LOCATION)
+            write_log_message("<row>" + str + "</row>\n");
+        else if(record.kind == Kind::NO_NEWLINE)
+            write_log_message(str);
+        else
+            write_log_message("<row>" + str + "</row>");
+    }
+#endif
+
+    if(has_log_callback())
+        log_to_callback(untag<FormatterType::NONE>(record.text), record.prefix);
+}
+
+void run() {
+    auto& s = state();
+    set_thread_name("AsyncLog");
+
+    LogRecord record;
+    for(;;) {
+        size_t n = 0;
+        while(s.try_pop(record)) {
+            write_record(record);
+            s.written_pos.store(s.written_pos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+            /// flush() should not have to wait until the queue is empty
+            if(++n % 256 == 0) {
+                std::unique_lock guard(s.mutex);
+                s.written_variable.notify_all();
+            }
+        }
+
+        if(auto dropped = s.unreported_drops.exchange(0)) {
+            write_record(LogRecord{
+                .kind = LogRecord::Kind::LOCATION,
+                .prefix = PrefixLiterals::WARNING,
+                .color = FormatColor::YELLOW,
+                .time = std::chrono::system_clock::now(),
+                .file = __FILE__,
+                .line = __LINE__,
+                .text = format<FormatterType::TAGS>("The log queue was full, dropped ", dropped, " messages.")
+            });
+        }
+
+        if(n > 0) {
+            s.written.fetch_add(n, std::memory_order_relaxed);
+            std::unique_lock guard(s.mutex);
+            s.written_variable.notify_all();
+            continue;
+        }
+
+        if(s.terminate.load())
+            break;
+
+        std::unique_lock guard(s.mutex);
+        s.sleeping = true;
+        /// pairs with the fence in log_async: either we see the record, or they see us sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        /// the timeout is only a safety net, producers wake us up
+        s.wake.wait_for(guard, std::chrono::milliseconds(100), [&]() {
+            return s.terminate.load() || not s.empty();
+        });
+        s.sleeping = false;
+    }
+}
+
+void crash_flush() {
+    auto& s = state();
+    if(not s.running.load() || s.thread_id.load() == std::this_thread::get_id())
+        return;
+    AsyncLog::flush(std::chrono::milliseconds(500));
+}
+
+//! writes to stderr without locks or allocations
+void signal_safe_print(const char* str, size_t length) {
+#ifdef _WIN32
+    [[maybe_unused]] auto r = _write(2, str, unsigned(length));
+#else
+    [[maybe_unused]] auto r = ::write(STDERR_FILENO, str, length);
+#endif
+}
+
+/**
+ * Flushing for signal handlers: nothing here may lock or wait on a
+ * condition variable, since the signal may arrive while the interrupted
+ * thread holds the mutex. The logging thread keeps writing on its own
+ * (it wakes up at least every 100ms), so we only spin on the queue
+ * positions for a bounded amount of time and report what is left.
+ */
+void signal_flush() {
+    auto& s = state();
+    if(not s.running.load(std::memory_order_relaxed)
+       || s.thread_id.load() == std::this_thread::get_id())
+    {
+        return;
+    }
+
+    const size_t target = s.enqueue_pos.load(std::memory_order_acquire);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while(s.written_pos.load(std::memory_order_acquire) < target
+          && std::chrono::steady_clock::now() < deadline)
+    {
+        /// spin
+    }
+
+    const size_t done = s.written_pos.load(std::memory_order_acquire);
+    if(done >= target)
+        return;
+
+    char buffer[96];
+    size_t i = sizeof(buffer);
+    static constexpr std::string_view suffix = " log messages were not written before the crash.\n";
+    i -= suffix.size();
+    std::memcpy(buffer + i, suffix.data(), suffix.size());
+    for(size_t missing = target - done; missing > 0; missing /= 10)
+        buffer[--i] = char('0' + missing % 10);
+    signal_safe_print(buffer + i, sizeof(buffer) - i);
+}
+
+/// only actual crashes - SIGTERM / SIGINT are normal ways to end a program
+#ifdef SIGBUS
+constexpr std::array<int, 5> crash_signals { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS };
+#else
+constexpr std::array<int, 4> crash_signals { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+#endif
+std::array<void(*)(int), crash_signals.size()> previous_handlers{};
+
+extern "C" void on_crash_signal(int sig) {
+    signal_flush();
+
+    for(size_t i = 0; i < crash_signals.size(); ++i) {
+        if(crash_signals[i] != sig)
+            continue;
+        auto previous = previous_handlers[i];
+        std::signal(sig, previous == SIG_ERR ? SIG_DFL : previous);
+        break;
+    }
+    std::raise(sig);
+}
+
+std::terminate_handler previous_terminate{nullptr};
+
+void install_crash_handlers() {
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        for(size_t i = 0; i < crash_signals.size(); ++i)
+            previous_handlers[i] = std::signal(crash_signals[i], on_crash_signal);
+
+        previous_terminate = std::set_terminate([]() {
+            crash_flush();
+            if(previous_terminate)
+                previous_terminate();
+            std::abort();
+        });
+    });
+}
+
+}
+
+bool is_logging_async() noexcept {
+    return state().running.load(std::memory_order_relaxed);
+}
+
+void log_async(LogRecord&& record) {
+    auto& s = state();
+    s.producers.fetch_add(1);
+
+    /// stopped in the meantime, or logging from the logging thread itself
+    if(not s.running.load() || s.thread_id.load() == std::this_thread::get_id()) {
+        s.producers.fetch_sub(1);
+        write_record(record);
+        return;
+    }
+
+    const bool may_drop = s.options.overflow == AsyncLog::Overflow::DROP
+        && record.prefix == PrefixLiterals::INFO;
+
+    bool pushed = true;
+    while(not s.try_push(record)) {
+        if(may_drop) {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            s.unreported_drops.fetch_add(1, std::memory_order_relaxed);
+            pushed = false;
+            break;
+        }
+
+        s.wake.notify_one();
+        std::this_thread::yield();
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(pushed && s.sleeping.load()) {
+        std::unique_lock guard(s.mutex);
+        s.wake.notify_one();
+    }
+
+    s.producers.fetch_sub(1);
+}
+
+std::string AsyncLog::Stats::toStr() const {
+    return "AsyncLog<written:" + Meta::toStr(written) + " dropped:" + Meta::toStr(dropped) + ">";
+}
+
+void AsyncLog::start() {
+    start(Options{});
+}
+
+void AsyncLog::start(Options options) {
+    std::unique_lock control(control_mutex());
+    auto& s = state();
+    if(s.running.load())
+        return;
+
+    const size_t capacity = std::bit_ceil(max(size_t(2), options.capacity));
+    if(capacity != s.mask + 1 || not s.slots) {
+        s.slots = std::make_unique<Slot[]>(capacity);
+        s.mask = capacity - 1;
+    }
+    for(size_t i = 0; i < capacity; ++i)
+        s.slots[i].sequence.store(i, std::memory_order_relaxed);
+    s.enqueue_pos = 0;
+    s.dequeue_pos = 0;
+    s.written_pos = 0;
+    s.options = options;
+    s.terminate = false;
+
+    s.thread = std::thread(run);
+    s.thread_id = s.thread.get_id();
+    s.running = true;
+
+    if(options.flush_on_crash)
+        install_crash_handlers();
+
+    static std::once_flag at_exit;
+    std::call_once(at_exit, []() {
+        std::atexit([]() {
+            AsyncLog::stop();
+        });
+    });
+}
+
+void AsyncLog::stop() {
+    std::unique_lock control(control_mutex());
+    auto& s = state();
+    if(not s.running.load())
+        return;
+
+    /// nothing can be pushed after this, so the thread empties the queue
+    s.running = false;
+    while(s.producers.load() > 0)
+        std::this_thread::yield();
+
+    {
+        std::unique_lock guard(s.mutex);
+        s.terminate = true;
+        s.wake.notify_all();
+    }
+    s.thread.join();
+    s.thread_id = std::thread::id{};
+}
+
+bool AsyncLog::running() noexcept {
+    return is_logging_async();
+}
+
+bool AsyncLog::flush(std::chrono::milliseconds timeout) {
+    auto& s = state();
+    if(not s.running.load())
+        return true;
+
+    /// everything that has a slot by now (some of it may still be being filled)
+    const size_t target = s.enqueue_pos.load();
+    std::unique_lock guard(s.mutex);
+    s.wake.notify_one();
+    return s.written_variable.wait_for(guard, timeout, [&]() {
+        return s.written_pos.load(std::memory_order_acquire) >= target || not s.running.load();
+    });
+}
+
+AsyncLog::Stats AsyncLog::stats() {
+    auto& s = state();
+    return Stats{
+        .written = s.written.load(),
+        .dropped = s.dropped.load()
+    };
+}
+
+}
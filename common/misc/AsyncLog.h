@@ -0,0 +1,66 @@
+#pragma once
+
+#include <commons.pc.h>
+
+namespace cmn {
+
+/**
+ * Moves writing of log messages (Print, FormatWarning, FormatExcept, ...)
+ * off the threads that log them.
+ *
+ * While it is running, logging only formats the arguments once (with
+ * FormatterType::TAGS) and pushes a LogRecord into a bounded lock-free
+ * queue. One background thread takes them out in order, renders the time
+ * and the output for the terminal, the log file and the callback, and
+ * writes them.
+ *
+ * If the queue is full, informational messages are dropped (and counted,
+ * the logger reports how many it lost) unless Overflow::BLOCK is set.
+ * Warnings and errors always wait for space. Messages logged by the logging
+ * thread itself (e.g. from the log callback) are written immediately.
+ *
+ * With Options::flush_on_crash, std::terminate waits (a little while) for
+ * the queue to be written before the process dies. Fatal signals (SIGSEGV,
+ * SIGABRT, ...) cannot lock, so they only give the logging thread a moment
+ * to catch up and report how many messages were lost on stderr. The queue
+ * is also flushed at exit.
+ */
+class AsyncLog {
+public:
+    enum class Overflow {
+        //! drop informational messages if the queue is full
+        DROP,
+        //! wait for space
+        BLOCK
+    };
+
+    struct Options {
+        //! maximum number of queued messages (rounded up to a power of two)
+        size_t capacity = 8192;
+        Overflow overflow = Overflow::DROP;
+        bool flush_on_crash = true;
+    };
+
+    struct Stats {
+        uint64_t written{0}, dropped{0};
+        std::string toStr() const;
+        static std::string class_name() { return "AsyncLog::Stats"; }
+    };
+
+    //! Starts the logging thread (does nothing if it is already running).
+    static void start();
+    static void start(Options options);
+    //! Writes everything that is queued and stops the logging thread.
+    static void stop();
+    static bool running() noexcept;
+
+    /**
+     * Waits until everything logged before the call has been written.
+     * Returns false if that did not happen within the timeout.
+     */
+    static bool flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+
+    static Stats stats();
+};
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/GlobalSettings.h>
+
+namespace cmn {
+
+namespace detail {
+
+template<typename T, bool = std::is_trivially_copyable_v<T>>
+struct is_lock_free_setting : std::false_type {};
+
+template<typename T>
+struct is_lock_free_setting<T, true> : std::bool_constant<std::atomic<T>::is_always_lock_free> {};
+
+}
+
+/**
+ * A typed handle to one setting, for code that reads it all the time.
+ *
+ * SETTING(name) and friends lock the settings, look up the name and maybe
+ * parse the value on every call. A handle only does that once: on first
+ * use it registers a callback for the setting, which publishes an
+ * immutable copy of the value every time it changes. Reading never locks -
+ * for values that fit into a lock-free atomic (numbers, bools, enums) it is
+ * one atomic load, everything else is published as a shared_ptr<const T>
+ * snapshot that stays valid for as long as a reader holds on to it.
+ *
+ * Until the setting exists, the default value passed to the constructor is
+ * returned. Handles are meant to live as long as the settings (e.g. as
+ * statics): the callback stays registered, but only holds on to the
+ * published value, not to the handle itself.
+ *
+ * ```
+ * static SettingHandle<int> detect_threshold{"detect_threshold", 25};
+ * if(value > detect_threshold())
+ *     ...
+ * ```
+ */
+template<typename T>
+class SettingHandle {
+public:
+    static constexpr bool lock_free = detail::is_lock_free_setting<T>::value;
+    using snapshot_t = std::shared_ptr<const T>;
+
+private:
+    struct State {
+        const std::string name;
+        std::once_flag registered;
+        std::atomic<bool> resolved{false};
+
+        std::conditional_t<lock_free, std::atomic<T>,
+#if defined(__cpp_lib_atomic_shared_ptr)
+            std::atomic<snapshot_t>
+#else
+            snapshot_t
+#endif
+        > value;
+#if !defined(__cpp_lib_atomic_shared_ptr)
+        //! only used for snapshots, if there is no std::atomic<std::shared_ptr>
+        mutable std::mutex mutex;
+#endif
+
+        State(std::string_view name, T&& default_value)
+            : name(name), value(make(std::move(default_value)))
+        { }
+
+        static auto make(T&& v) {
+            if constexpr(lock_free)
+                return v;
+            else
+                return std::make_shared<const T>(std::move(v));
+        }
+
+        void publish(T&& v) {
+            if constexpr(lock_free) {
+                value.store(v, std::memory_order_release);
+            } else {
+#if defined(__cpp_lib_atomic_shared_ptr)
+                value.store(make(std::move(v)), std::memory_order_release);
+#else
+                auto ptr = make(std::move(v));
+                std::unique_lock guard(mutex);
+                value.swap(ptr);
+#endif
+            }
+        }
+
+        /// called by the settings whenever the value changes
+        void update() {
+            if(auto v = optional_setting_config<T>(name))
+                publish(std::move(*v));
+        }
+    };
+
+    std::shared_ptr<State> _state;
+
+public:
+    explicit SettingHandle(std::string_view name, T default_value = T{})
+        : _state(std::make_shared<State>(name, std::move(default_value)))
+    { }
+
+    SettingHandle(const SettingHandle&) = delete;
+    SettingHandle& operator=(const SettingHandle&) = delete;
+
+    const std::string& name() const { return _state->name; }
+
+    /**
+     * Registers the callback (and reads the current value), if that has not
+     * happened yet. Needs the GlobalSettings instance to exist. Reading a
+     * handle does this automatically.
+     */
+    void resolve() const {
+        std::call_once(_state->registered, [state = _state]() {
+            GlobalSettings::register_callbacks({ state->name }, [state](std::string_view) {
+                state->update();
+            });
+            state->resolved.store(true, std::memory_order_release);
+        });
+    }
+
+    //! A copy of the current value.
+    T value() const {
+        if(not _state->resolved.load(std::memory_order_acquire)) [[unlikely]]
+            resolve();
+
+        if constexpr(lock_free)
+            return _state->value.load(std::memory_order_acquire);
+        else
+            return *snapshot();
+    }
+
+    T operator()() const {
+        return value();
+    }
+
+    //! The current value without copying it (only for values that are not atomic).
+    snapshot_t snapshot() const requires (not lock_free) {
+        if(not _state->resolved.load(std::memory_order_acquire)) [[unlikely]]
+            resolve();
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+        return _state->value.load(std::memory_order_acquire);
+#else
+        std::unique_lock guard(_state->mutex);
+        return _state->value;
+#endif
+    }
+};
+
+}
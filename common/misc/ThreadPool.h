@@ -193,6 +193,139 @@ void distribute_indexes(F&& fn, Pool& pool, Iterator start, Iterator end, uint32
         f.get();
 }
 
+//! Timing of a single chunk processed by distribute_indexes_dynamic.
+struct ChunkTiming {
+    int64_t start, end;
+    size_t participant;
+    double seconds;
+};
+
+struct DistributeOptions {
+    //! number of participating threads, including the caller (0 = pool size)
+    uint32_t threads = 0;
+    //! fixed chunk size (0 = guided: remaining / (2 * threads), but at least min_chunk)
+    int64_t chunk = 0;
+    int64_t min_chunk = 1;
+    //! if set, one entry per processed chunk is appended (in no specific order)
+    std::vector<ChunkTiming>* timings = nullptr;
+};
+
+/**
+ * Variant of distribute_indexes that hands out chunks dynamically: all
+ * participants (the calling thread plus up to threads-1 pool tasks) take
+ * chunks from an atomic cursor until the range is drained. A slow chunk
+ * therefore does not hold back the rest, and since the caller works on
+ * the range itself it only ever waits for chunks that are already being
+ * processed - so this is safe to call from inside tasks of the same pool.
+ *
+ * fn is called as fn(offset, begin, end, participant) where participant
+ * is in [0, threads) and 0 is the calling thread.
+ */
+template<typename F, typename Iterator, typename Pool>
+void distribute_indexes_dynamic(F&& fn, Pool& pool, Iterator start, Iterator end, DistributeOptions options = {}) {
+    static_assert(std::integral<Iterator> || std::random_access_iterator<Iterator>, "distribute_indexes_dynamic needs random access.");
+    
+    int64_t N;
+    if constexpr(std::integral<Iterator>)
+        N = end - start;
+    else
+        N = std::distance(start, end);
+    
+    if(N <= 0)
+        return;
+    
+    const uint32_t threads = max(1u, options.threads == 0
+                                        ? (uint32_t)pool.num_threads()
+                                        : options.threads);
+    const int64_t min_chunk = max(int64_t(1), options.min_chunk);
+    
+    /// shared with the pool tasks, which may only start after we returned
+    struct State {
+        std::atomic<int64_t> cursor{0};
+        std::atomic<int64_t> done{0};
+        std::atomic<bool> failed{false};
+        std::mutex mutex;
+        std::exception_ptr exception;
+    };
+    auto state = std::make_shared<State>();
+    
+    auto next_chunk = [N, threads, min_chunk, chunk = options.chunk](State& state, int64_t& begin, int64_t& size) -> bool {
+        begin = state.cursor.load(std::memory_order_relaxed);
+        do {
+            if(begin >= N)
+                return false;
+            size = chunk > 0
+                ? chunk
+                : max(min_chunk, (N - begin) / (2 * int64_t(threads)));
+            size = min(size, N - begin);
+        } while(not state.cursor.compare_exchange_weak(begin, begin + size, std::memory_order_acq_rel, std::memory_order_relaxed));
+        return true;
+    };
+    
+    auto participate = [&fn, next_chunk, start, N, timings = options.timings](State& state, size_t participant) {
+        int64_t begin, size;
+        while(next_chunk(state, begin, size)) {
+            if(not state.failed.load(std::memory_order_relaxed)) {
+                Timer timer;
+                try {
+                    Iterator it, nex;
+                    if constexpr(std::integral<Iterator>) {
+                        it = start + Iterator(begin);
+                        nex = it + Iterator(size);
+                    } else {
+                        it = std::next(start, begin);
+                        nex = std::next(it, size);
+                    }
+                    fn(begin, it, nex, conditional_conversion<4, size_t, int64_t, Iterator, Iterator, size_t>::template convert<std::remove_cvref_t<F>>(participant));
+                    
+                } catch(...) {
+                    std::unique_lock guard(state.mutex);
+                    if(not state.exception)
+                        state.exception = std::current_exception();
+                    state.failed = true;
+                }
+                
+                if(timings) {
+                    const double seconds = timer.elapsed();
+                    std::unique_lock guard(state.mutex);
+                    timings->push_back(ChunkTiming{begin, begin + size, participant, seconds});
+                }
+            }
+            
+            /// chunks are still counted after a failure, so the caller
+            /// knows when nobody is touching fn anymore
+            if(state.done.fetch_add(size, std::memory_order_acq_rel) + size == N)
+                state.done.notify_all();
+        }
+    };
+    
+    const uint32_t helpers = uint32_t(min(int64_t(threads) - 1, (N + min_chunk - 1) / min_chunk - 1));
+    for(uint32_t j = 1; j <= helpers; ++j) {
+        /// helpers that start late find an empty range and only touch
+        /// the shared state, which they keep alive themselves
+        auto task = [state, participate, j]() {
+            participate(*state, j);
+        };
+        if constexpr(requires { typename Pool::Task; }) {
+            pool.push(typename Pool::Task(std::move(task)));
+        } else {
+            pool.enqueue(std::move(task));
+        }
+    }
+    
+    participate(*state, 0);
+    
+    for(int64_t done = state->done.load(std::memory_order_acquire);
+        done < N;
+        done = state->done.load(std::memory_order_acquire))
+    {
+        state->done.wait(done, std::memory_order_acquire);
+    }
+    
+    if(state->exception)
+        std::rethrow_exception(state->exception);
+}
+
     template<typename T>
     class QueueThreadPool {
         std::queue<T> q;
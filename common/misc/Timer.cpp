@@ -13,6 +13,8 @@ TakeTiming::TakeTiming(Timing& t) : timing(t) {
     //timing.start_measure();
     timing.start_();
     timer.reset();
+    if(cmn::Tracer::enabled()) [[unlikely]]
+        trace_begin = cmn::Tracer::now();
 }
 
 void Timing::start_() {
@@ -2,6 +2,7 @@
 #define M_TIMER_H
 
 #include <commons.pc.h>
+#include <misc/Trace.h>
 //#define TREX_ENABLE_TIMERS
 
 namespace cmn {
@@ -30,8 +31,14 @@ private:
     std::chrono::time_point<clock_> beg_;
 };
 
+/**
+ * Averages of how long something took, printed to the console (only with
+ * TREX_ENABLE_TIMERS). Measurements with TakeTiming are also recorded by the
+ * Tracer, whenever that is enabled.
+ */
 class Timing {
     //Timer _timer;
+    uint32_t _trace_name;
 #ifdef TREX_ENABLE_TIMERS
     std::string _name;
     const double _print_threshold;
@@ -52,14 +59,17 @@ class Timing {
 #endif
     
 public:
-    Timing([[maybe_unused]] const std::string& name, [[maybe_unused]] double print_threshold = 1.0)
+    Timing(const std::string& name, [[maybe_unused]] double print_threshold = 1.0)
+        : _trace_name(cmn::Tracer::name_id(name))
 #ifdef TREX_ENABLE_TIMERS
-        : _name(name), _print_threshold(print_threshold), sample_count(0)
+        , _name(name), _print_threshold(print_threshold), sample_count(0)
 #endif
     {
         
     }
     
+    uint32_t trace_name() const { return _trace_name; }
+    
     void start_measure();
     void start_();
     double conclude_measure();
@@ -69,13 +79,15 @@ public:
 class TakeTiming {
     Timing &timing;
     Timer timer;
+    int64_t trace_begin{-1};
     
 public:
     TakeTiming(Timing& t);
     
     ~TakeTiming() {
         timing.conclude_measure(timer.elapsed());
-        
+        if(trace_begin >= 0) [[unlikely]]
+            cmn::Tracer::record(timing.trace_name(), trace_begin, cmn::Tracer::now());
     }
 };
 
@@ -0,0 +1,342 @@
+#include "Trace.h"
+#include <misc/Path.h>
+#include <bit>
+
+namespace cmn {
+
+namespace {
+
+struct Names {
+    std::mutex mutex;
+    //! index 0 is reserved for names that have not been looked up yet
+    std::vector<std::string> names{ "" };
+    std::map<std::string, uint32_t, std::less<>> ids;
+};
+
+Names& names() {
+    static Names* _names = new Names();
+    return *_names;
+}
+
+/**
+ * One event in a ring buffer. The fields are atomic so that threads can
+ * export while others are still recording (see Tracer::chrome_json).
+ */
+struct Slot {
+    std::atomic<uint32_t> name;
+    std::atomic<int64_t> begin, end, arg;
+
+    void store(uint32_t n, int64_t b, int64_t e, int64_t a) noexcept {
+        name.store(n, std::memory_order_release);
+        begin.store(b, std::memory_order_release);
+        end.store(e, std::memory_order_release);
+        arg.store(a, std::memory_order_release);
+    }
+
+    Tracer::Event load() const noexcept {
+        return Tracer::Event{
+            name.load(std::memory_order_acquire),
+            begin.load(std::memory_order_acquire),
+            end.load(std::memory_order_acquire),
+            arg.load(std::memory_order_acquire)
+        };
+    }
+};
+
+/**
+ * Events of one thread. Only that thread writes to it - everybody else only
+ * reads the events behind head.
+ */
+struct ThreadBuffer {
+    uint32_t tid;
+    std::string thread_name;
+    uint64_t generation;
+    std::unique_ptr<Slot[]> events;
+    uint64_t mask;
+    std::atomic<uint64_t> head{0};
+    //! set when the thread exits, nothing is written after that
+    std::atomic<bool> finished{false};
+};
+
+struct Buffers {
+    std::mutex mutex;
+    //! in the order they were created
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    size_t capacity{65536};
+    uint32_t next_tid{1};
+    //! increased by clear(), threads start a new buffer when they notice
+    std::atomic<uint64_t> generation{0};
+    //! events of finished threads that were dropped before being exported
+    uint64_t dropped{0};
+};
+
+Buffers& buffers() {
+    static Buffers* _buffers = new Buffers();
+    return *_buffers;
+}
+
+//! drops the oldest buffers of finished threads, so that at most max_finished_threads are kept
+void drop_finished(Buffers& b) {
+    size_t finished = 0;
+    for(auto& buffer : b.buffers)
+        finished += buffer->finished.load(std::memory_order_acquire) ? 1u : 0u;
+
+    for(auto it = b.buffers.begin(); it != b.buffers.end() && finished > Tracer::max_finished_threads; ) {
+        if((*it)->finished.load(std::memory_order_acquire)) {
+            b.dropped += min((*it)->head.load(std::memory_order_acquire), (*it)->mask + 1);
+            it = b.buffers.erase(it);
+            --finished;
+        } else
+            ++it;
+    }
+}
+
+//! the buffer of the calling thread, marked as finished when the thread exits
+struct LocalBuffer {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~LocalBuffer() {
+        if(buffer)
+            buffer->finished.store(true, std::memory_order_release);
+    }
+};
+
+ThreadBuffer* local_buffer() noexcept {
+    static thread_local LocalBuffer local_holder;
+    auto& local = local_holder.buffer;
+    auto& b = buffers();
+
+    if(local && local->generation == b.generation.load(std::memory_order_acquire)) [[likely]]
+        return local.get();
+
+    try {
+        std::unique_lock guard(b.mutex);
+        /// a buffer of an older generation is not in the list anymore
+        if(local)
+            local->finished.store(true, std::memory_order_release);
+        drop_finished(b);
+
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->tid = b.next_tid++;
+        buffer->thread_name = get_thread_name();
+        buffer->generation = b.generation.load();
+        buffer->events = std::make_unique<Slot[]>(b.capacity);
+        buffer->mask = b.capacity - 1;
+        b.buffers.push_back(buffer);
+        local = std::move(buffer);
+        return local.get();
+
+    } catch(...) {
+        return nullptr;
+    }
+}
+
+void append_escaped(std::string& str, std::string_view text) {
+    for(char c : text) {
+        switch(c) {
+            case '"': str += "\\\""; break;
+            case '\\': str += "\\\\"; break;
+            case '\n': str += "\\n"; break;
+            case '\t': str += "\\t"; break;
+            default:
+                if(uint8_t(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", unsigned(uint8_t(c)));
+                    str += buffer;
+                } else
+                    str += c;
+                break;
+        }
+    }
+}
+
+//! the trace format wants microseconds, keep the nanoseconds as decimals
+void append_us(std::string& str, int64_t ns) {
+    str += std::to_string(ns / 1000);
+    const auto rest = ns % 1000;
+    if(rest != 0) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), ".%03d", int(rest));
+        str += buffer;
+    }
+}
+
+}
+
+std::string Tracer::Stats::toStr() const {
+    return "Tracer<recorded:" + Meta::toStr(recorded) + " overwritten:" + Meta::toStr(overwritten) + " dropped:" + Meta::toStr(dropped) + " threads:" + Meta::toStr(threads) + ">";
+}
+
+void Tracer::enable(size_t events_per_thread) {
+    auto& b = buffers();
+    {
+        std::unique_lock guard(b.mutex);
+        const size_t capacity = std::bit_ceil(max(size_t(16), events_per_thread));
+        if(capacity != b.capacity) {
+            b.capacity = capacity;
+            b.buffers.clear();
+            b.dropped = 0;
+            ++b.generation;
+        }
+    }
+    _enabled = true;
+}
+
+void Tracer::disable() {
+    _enabled = false;
+}
+
+void Tracer::clear() {
+    auto& b = buffers();
+    std::unique_lock guard(b.mutex);
+    b.buffers.clear();
+    b.dropped = 0;
+    ++b.generation;
+}
+
+uint32_t Tracer::name_id(std::string_view name) {
+    auto& n = names();
+    std::unique_lock guard(n.mutex);
+    if(auto it = n.ids.find(name); it != n.ids.end())
+        return it->second;
+
+    const auto id = narrow_cast<uint32_t>(n.names.size());
+    n.names.emplace_back(name);
+    n.ids.emplace(std::string(name), id);
+    return id;
+}
+
+void Tracer::record(uint32_t name, int64_t begin, int64_t end, int64_t arg) noexcept {
+    if(not enabled())
+        return;
+
+    auto buffer = local_buffer();
+    if(not buffer)
+        return;
+
+    const auto head = buffer->head.load(std::memory_order_relaxed);
+    buffer->events[head & buffer->mask].store(name, begin, end, arg);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+std::string Tracer::chrome_json() {
+    auto& b = buffers();
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+    {
+        std::unique_lock guard(b.mutex);
+        threads = b.buffers;
+    }
+    //! buffers of threads that had exited before they were copied
+    std::vector<const ThreadBuffer*> exported;
+
+    std::vector<std::string> event_names;
+    {
+        auto& n = names();
+        std::unique_lock guard(n.mutex);
+        event_names = n.names;
+    }
+
+    /// copy the events first, timestamps are relative to the first one
+    std::vector<std::pair<const ThreadBuffer*, std::vector<Event>>> copies;
+    int64_t epoch = std::numeric_limits<int64_t>::max();
+    for(auto& thread : threads) {
+        if(thread->finished.load(std::memory_order_acquire))
+            exported.push_back(thread.get());
+
+        const uint64_t capacity = thread->mask + 1;
+        const uint64_t head = thread->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > capacity ? head - capacity : 0;
+
+        std::vector<Event> events;
+        events.reserve(head - oldest);
+        for(uint64_t i = oldest; i < head; ++i)
+            events.push_back(thread->events[i & thread->mask].load());
+
+        /// the thread may have overwritten the oldest ones in the meantime
+        /// (and may be writing the one after head right now)
+        const uint64_t now_head = thread->head.load(std::memory_order_acquire) + 1;
+        if(now_head > capacity && now_head - capacity > oldest) {
+            const auto skip = min(now_head - capacity - oldest, uint64_t(events.size()));
+            events.erase(events.begin(), events.begin() + ptrdiff_t(skip));
+        }
+
+        for(auto& e : events)
+            epoch = min(epoch, e.begin);
+        copies.emplace_back(thread.get(), std::move(events));
+    }
+
+    if(epoch == std::numeric_limits<int64_t>::max())
+        epoch = 0;
+
+    /// everything finished threads will ever record is exported now
+    if(not exported.empty()) {
+        std::unique_lock guard(b.mutex);
+        std::erase_if(b.buffers, [&](const std::shared_ptr<ThreadBuffer>& buffer) {
+            return contains(exported, buffer.get());
+        });
+    }
+
+    std::string str = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&]() {
+        if(not first)
+            str += ",\n";
+        first = false;
+    };
+
+    for(auto& [thread, events] : copies) {
+        separate();
+        str += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread->tid) + ",\"args\":{\"name\":\"";
+        append_escaped(str, thread->thread_name);
+        str += "\"}}";
+
+        for(auto& e : events) {
+            separate();
+            str += "{\"name\":\"";
+            append_escaped(str, e.name < event_names.size() ? event_names[e.name] : std::string("?"));
+            str += "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(thread->tid) + ",\"ts\":";
+            append_us(str, e.begin - epoch);
+            str += ",\"dur\":";
+            append_us(str, max(int64_t(0), e.end - e.begin));
+            if(e.arg != 0)
+                str += ",\"args\":{\"arg\":" + std::to_string(e.arg) + "}";
+            str += "}";
+        }
+    }
+
+    str += "]}\n";
+    return str;
+}
+
+bool Tracer::save_chrome_json(const file::Path& path) {
+    const auto str = chrome_json();
+    auto f = path.fopen("wb");
+    if(not f) {
+        FormatError("Cannot open ", path, " for writing the trace.");
+        return false;
+    }
+
+    if(f.write(str.data(), str.size()) != str.size()) {
+        FormatError("Cannot write the trace to ", path, ".");
+        return false;
+    }
+    return true;
+}
+
+Tracer::Stats Tracer::stats() {
+    auto& b = buffers();
+    std::unique_lock guard(b.mutex);
+
+    Stats stats;
+    stats.threads = narrow_cast<uint32_t>(b.buffers.size());
+    stats.dropped = b.dropped;
+    for(auto& thread : b.buffers) {
+        const uint64_t head = thread->head.load(std::memory_order_acquire);
+        stats.recorded += head;
+        if(head > thread->mask + 1)
+            stats.overwritten += head - (thread->mask + 1);
+    }
+    return stats;
+}
+
+}
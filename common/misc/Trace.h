@@ -0,0 +1,157 @@
+#pragma once
+
+#include <commons.pc.h>
+
+namespace cmn {
+
+namespace file {
+class Path;
+}
+
+/**
+ * Records (name, begin, end, argument) events of scopes, from any thread,
+ * and exports them as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ * Tracing is off by default and can be switched on and off at runtime. While
+ * it is off, a CMN_TRACE_SCOPE costs one branch. While it is on, every thread
+ * writes into its own ring buffer (no locks, no allocations after the first
+ * event of a thread), so only the last events_per_thread events per thread
+ * are kept.
+ *
+ * Buffers of threads that exited are freed once they have been exported,
+ * and only the newest max_finished_threads of them are kept until then, so
+ * short-lived threads do not add up.
+ *
+ * ```
+ * void Something::update() {
+ *     CMN_TRACE_SCOPE("Something::update");
+ *     ...
+ * }
+ *
+ * Tracer::enable();
+ * ...
+ * Tracer::save_chrome_json(file::Path("trace.json"));
+ * ```
+ */
+class Tracer {
+public:
+    struct Event {
+        //! see name_id()
+        uint32_t name;
+        //! steady clock, in nanoseconds
+        int64_t begin, end;
+        int64_t arg;
+    };
+
+    struct Stats {
+        uint64_t recorded{0}, overwritten{0};
+        //! events of exited threads that were freed without being exported
+        uint64_t dropped{0};
+        uint32_t threads{0};
+        std::string toStr() const;
+        static std::string class_name() { return "Tracer::Stats"; }
+    };
+
+    //! Buffers of exited threads that are kept until they are exported.
+    static constexpr size_t max_finished_threads = 16;
+
+private:
+    static inline std::atomic<bool> _enabled{false};
+
+public:
+    static bool enabled() noexcept {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Starts recording. Changing events_per_thread (rounded up to a power of
+     * two) drops everything that was recorded so far.
+     */
+    static void enable(size_t events_per_thread = 65536);
+    //! Stops recording, but keeps the events for exporting.
+    static void disable();
+    //! Drops all recorded events.
+    static void clear();
+
+    //! A number for the given name (the same name always gets the same number, never 0).
+    static uint32_t name_id(std::string_view name);
+
+    static int64_t now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //! Adds an event to the buffer of the calling thread (if tracing is enabled).
+    static void record(uint32_t name, int64_t begin, int64_t end, int64_t arg = 0) noexcept;
+
+    /**
+     * All recorded events in Chrome's trace event format. Events that are
+     * overwritten while exporting are left out. Buffers of threads that
+     * exited are freed afterwards (see max_finished_threads).
+     */
+    static std::string chrome_json();
+    static bool save_chrome_json(const file::Path&);
+
+    static Stats stats();
+};
+
+/**
+ * The name of a trace scope. Can be constant-initialized from a string
+ * literal (the literal has to outlive the tracer); the name is only looked
+ * up when the first event is recorded.
+ */
+class TraceName {
+    const char* _name;
+    mutable std::atomic<uint32_t> _id{0};
+
+public:
+    constexpr TraceName(const char* name) noexcept : _name(name) {}
+
+    uint32_t id() const {
+        auto id = _id.load(std::memory_order_relaxed);
+        if(id == 0) [[unlikely]] {
+            id = Tracer::name_id(_name);
+            _id.store(id, std::memory_order_relaxed);
+        }
+        return id;
+    }
+};
+
+//! Records one event from construction until destruction (see CMN_TRACE_SCOPE).
+class TraceScope {
+    const TraceName* _name{nullptr};
+    int64_t _begin{0};
+    int64_t _arg;
+
+public:
+    explicit TraceScope(const TraceName& name, int64_t arg = 0) noexcept
+        : _arg(arg)
+    {
+        if(Tracer::enabled()) [[unlikely]] {
+            _name = &name;
+            _begin = Tracer::now();
+        }
+    }
+
+    ~TraceScope() {
+        if(_name) [[unlikely]]
+            Tracer::record(_name->id(), _begin, Tracer::now(), _arg);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    //! e.g. for results that are only known at the end of the scope
+    void set_arg(int64_t arg) noexcept { _arg = arg; }
+};
+
+}
+
+#define CMN_TRACE_CAT_I(a, b) a##b
+#define CMN_TRACE_CAT(a, b) CMN_TRACE_CAT_I(a, b)
+
+//! Traces the rest of the enclosing scope under NAME (a string literal).
+#define CMN_TRACE_SCOPE(NAME) CMN_TRACE_SCOPE_ARG(NAME, 0)
+//! Same as CMN_TRACE_SCOPE, with an integer argument (evaluated even if tracing is off).
+#define CMN_TRACE_SCOPE_ARG(NAME, ARG) \
+    static constinit ::cmn::TraceName CMN_TRACE_CAT(_cmn_trace_name_, __LINE__){ NAME }; \
+    ::cmn::TraceScope CMN_TRACE_CAT(_cmn_trace_scope_, __LINE__){ CMN_TRACE_CAT(_cmn_trace_name_, __LINE__), int64_t(ARG) }
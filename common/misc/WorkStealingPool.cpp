@@ -0,0 +1,171 @@
+#include "WorkStealingPool.h"
+
+namespace cmn {
+
+namespace {
+
+//! the pool (and worker index) the current thread belongs to, if any
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}
+
+void WorkStealingPool::Latch::wait(WorkStealingPool& pool) {
+    while(not done()) {
+        /// rather help out than block
+        if(pool.try_run_one())
+            continue;
+
+        /// sleep until either new work arrives or the last task finished
+        std::unique_lock guard(pool._sleep_mutex);
+        pool._sleep_condition.wait(guard, [&](){
+            return done() || pool._pending.load(std::memory_order_acquire) > 0;
+        });
+    }
+
+    std::unique_lock guard(_exception_mutex);
+    if(_exception)
+        std::rethrow_exception(_exception);
+}
+
+WorkStealingPool::WorkStealingPool(size_t nthreads, const std::string& thread_prefix, std::function<void(std::exception_ptr)> handle_exceptions)
+    : _exception_handler(handle_exceptions),
+      _thread_prefix(thread_prefix+"("+Meta::toStr(nthreads)+")")
+{
+    nthreads = max(size_t(1), nthreads);
+
+    for(size_t i = 0; i < nthreads; ++i)
+        _workers.push_back(std::make_unique<Worker>());
+    for(size_t i = 0; i < nthreads; ++i)
+        _threads.emplace_back([this, i](){ work(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::unique_lock guard(_sleep_mutex);
+        _stop = true;
+    }
+    _sleep_condition.notify_all();
+
+    for(auto &t : _threads)
+        t.join();
+}
+
+size_t WorkStealingPool::current_index() const {
+    if(current_pool == this)
+        return current_worker;
+    /// external threads distribute their tasks round-robin
+    return _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+}
+
+void WorkStealingPool::push(Task&& task) {
+    auto& worker = *_workers[current_index()];
+    _pending.fetch_add(1, std::memory_order_release);
+    {
+        std::unique_lock guard(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    /// taking the lock makes sure a worker that just decided to
+    /// go to sleep has actually started waiting before we notify it
+    { std::unique_lock guard(_sleep_mutex); }
+    _sleep_condition.notify_one();
+}
+
+void WorkStealingPool::notify_all() {
+    { std::unique_lock guard(_sleep_mutex); }
+    _sleep_condition.notify_all();
+}
+
+bool WorkStealingPool::pop(size_t index, Task& task) {
+    auto& worker = *_workers[index];
+    std::unique_lock guard(worker.mutex);
+    if(worker.tasks.empty())
+        return false;
+
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    _pending.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t first, Task& task) {
+    const size_t N = _workers.size();
+    for(size_t i = 0; i < N; ++i) {
+        auto& worker = *_workers[(first + i) % N];
+        std::unique_lock guard(worker.mutex, std::try_to_lock);
+        if(not guard.owns_lock() || worker.tasks.empty())
+            continue;
+
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+void WorkStealingPool::run(Task& task) {
+    try {
+        task();
+    } catch(...) {
+        FormatExcept("Exception in WorkStealingPool(", thread_prefix(), ").");
+        if(_exception_handler)
+            _exception_handler(std::current_exception());
+    }
+
+    /// release the captured state right away
+    task = Task();
+}
+
+bool WorkStealingPool::try_run_one() {
+    if(_pending.load(std::memory_order_acquire) == 0)
+        return false;
+
+    Task task;
+    if(current_pool == this) {
+        if(not pop(current_worker, task) && not steal(current_worker + 1, task))
+            return false;
+    } else if(not steal(_next.load(std::memory_order_relaxed), task)) {
+        return false;
+    }
+
+    run(task);
+    return true;
+}
+
+void WorkStealingPool::wait() {
+    while(_pending.load(std::memory_order_acquire) > 0) {
+        if(not try_run_one())
+            std::this_thread::yield();
+    }
+}
+
+void WorkStealingPool::work(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    set_thread_name(thread_prefix()+"::thread_"+Meta::toStr(index));
+
+    Task task;
+    for(;;) {
+        if(pop(index, task) || steal(index + 1, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock guard(_sleep_mutex);
+        if(_pending.load(std::memory_order_acquire) > 0)
+            continue;
+        if(_stop)
+            break;
+
+        _sleep_condition.wait(guard, [this](){
+            return _stop || _pending.load(std::memory_order_acquire) > 0;
+        });
+    }
+
+    current_pool = nullptr;
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/ThreadPool.h>
+#include <misc/PackLambda.h>
+
+namespace cmn {
+
+/**
+ * Thread pool where every worker owns a deque of tasks. Workers take
+ * tasks from the back of their own deque and steal from the front of
+ * other workers' deques when they run dry, so there is no single queue
+ * (and lock) that all threads contend on.
+ *
+ * It offers the same enqueue() / distribute_indexes() surface as
+ * GenericThreadPool. In addition, tasks can be pushed without a future
+ * and be waited for using a WorkStealingPool::Latch, which also lets the
+ * waiting thread execute queued tasks instead of blocking.
+ */
+class WorkStealingPool {
+public:
+    using Task = package::F<void()>;
+
+    /**
+     * Counts down once per finished task. wait() helps executing
+     * queued tasks until all tasks have finished, then rethrows the
+     * first exception thrown by any of them (if any).
+     */
+    class Latch {
+        std::atomic<int64_t> _count;
+        std::mutex _exception_mutex;
+        std::exception_ptr _exception;
+
+    public:
+        explicit Latch(int64_t count = 0) : _count(count) {}
+
+        void add(int64_t count = 1) {
+            _count.fetch_add(count, std::memory_order_relaxed);
+        }
+        //! returns true if this was the last task
+        bool count_down() {
+            return _count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+        void set_exception(std::exception_ptr ptr) {
+            std::unique_lock guard(_exception_mutex);
+            if(not _exception)
+                _exception = ptr;
+        }
+        bool done() const {
+            return _count.load(std::memory_order_acquire) == 0;
+        }
+
+        void wait(WorkStealingPool& pool);
+    };
+
+private:
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _pending{0};
+    mutable std::atomic<size_t> _next{0};
+    std::atomic<bool> _stop{false};
+    std::mutex _sleep_mutex;
+    std::condition_variable _sleep_condition;
+    std::function<void(std::exception_ptr)> _exception_handler;
+
+    GETTER(std::string, thread_prefix);
+
+public:
+    WorkStealingPool(size_t nthreads, const std::string& thread_prefix, std::function<void(std::exception_ptr)> handle_exceptions = nullptr);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t num_threads() const {
+        return _threads.size();
+    }
+
+    //! Number of tasks that are queued, but not yet running.
+    size_t queue_length() const {
+        return _pending.load(std::memory_order_relaxed);
+    }
+
+    //! Queues a task without a future. Tasks pushed from a worker of this pool go into its own deque.
+    void push(Task&& task);
+
+    //! Queues a task that counts down the latch once it is done.
+    template<typename F>
+    void push(Latch& latch, F&& fn) {
+        push(Task([this, &latch, fn = std::forward<F>(fn)]() mutable {
+            try {
+                fn();
+            } catch(...) {
+                latch.set_exception(std::current_exception());
+            }
+            if(latch.count_down())
+                notify_all();
+        }));
+    }
+
+    template<class F, class... Args>
+    auto enqueue(F f, Args... args) -> std::future<typename std::invoke_result_t<F, Args...>>
+    {
+        using return_type = typename std::invoke_result_t<F, Args...>;
+        std::promise<return_type> promise;
+        std::future<return_type> res = promise.get_future();
+        auto bound = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+
+        push(Task([bound = std::move(bound), promise = std::move(promise)]() mutable {
+            try {
+                if constexpr(std::same_as<return_type, void>) {
+                    bound();
+                    promise.set_value();
+                } else {
+                    promise.set_value(bound());
+                }
+            } catch(...) {
+                promise.set_exception(std::current_exception());
+            }
+        }));
+
+        return res;
+    }
+
+    //! Executes one queued task on the calling thread, if there is one.
+    bool try_run_one();
+
+    //! Waits until no tasks are queued anymore (running ones may still be busy).
+    void wait();
+
+private:
+    bool pop(size_t index, Task& task);
+    bool steal(size_t first, Task& task);
+    void run(Task& task);
+    void work(size_t index);
+    size_t current_index() const;
+    void notify_all();
+};
+
+/**
+ * Same as distribute_indexes for other pools, but without allocating
+ * a future per chunk: chunks are pushed with a latch and the calling
+ * thread runs the last chunk itself, then helps with the remaining ones.
+ */
+template<typename F, typename Iterator>
+void distribute_indexes(F&& fn, WorkStealingPool& pool, Iterator start, Iterator end, uint32_t threads = 0) {
+    if(threads == 0)
+        threads = (uint32_t)pool.num_threads();
+
+    int64_t N;
+    if constexpr(std::integral<Iterator>)
+        N = end - start;
+    else
+        N = std::distance(start, end);
+
+    if(N <= 0)
+        return;
+
+    if(threads <= 1) {
+        fn(0, start, end, 0);
+        return;
+    }
+
+    const int64_t per_thread = max(1, int64_t(N) / int64_t(threads));
+
+    WorkStealingPool::Latch latch;
+    int64_t i=0;
+    size_t j=0;
+    Iterator nex = start;
+
+    for(auto it = start; it != end; ++j) {
+        int64_t step;
+        if(j + 1 == threads) {
+            step = N - i;
+        } else {
+            step = per_thread;
+        }
+
+        if constexpr(std::integral<Iterator>)
+            nex += step;
+        else
+            std::advance(nex, step);
+
+        if(nex == end) {
+            // run in local thread
+            try {
+                fn(i, it, nex, conditional_conversion<4, size_t, int64_t, Iterator, Iterator, size_t>::template convert<std::remove_cvref_t<F>>(j));
+            } catch(...) {
+                latch.set_exception(std::current_exception());
+            }
+
+        } else {
+            latch.add();
+            pool.push(latch, [&fn, i, it, nex, j]() {
+                fn(i, it, nex, conditional_conversion<4, size_t, int64_t, Iterator, Iterator, size_t>::template convert<std::remove_cvref_t<F>>(j));
+            });
+        }
+
+        it = nex;
+        i += step;
+    }
+
+    assert(i == N);
+    latch.wait(pool);
+}
+
+}
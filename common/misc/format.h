@@ -90,6 +90,9 @@ struct TCOLOR {
 template<size_t prefix, size_t postfix>
 inline constexpr auto COLOR = TCOLOR<prefix, postfix>::value;
 
+//! starts a color tag in strings formatted with FormatterType::TAGS
+inline constexpr char tag_marker = '\x1F';
+
 template<FormatterType type, FormatColor_t _value>
 struct Formatter {
     template<FormatColor_t value = _value>
@@ -197,17 +200,19 @@ struct Formatter {
     template<FormatColor value, bool end_tag = false>
     inline static constexpr auto from_tag_to_code() noexcept {
         if constexpr (end_tag)
-            return char(value) + (char)FormatColor::INVALID + 1;
+            return char('a' + char(value));
         else
-            return char(value) + 1;
+            return char('A' + char(value));
     }
 
+    /// every tag is tag_marker followed by a letter, so tagged strings
+    /// can contain any printable character (see untag())
     template<FormatColor_t value = _value>
         requires (type == FormatterType::TAGS)
     static constexpr std::string tint(StringLike auto&& s) noexcept {
-        constexpr char buffer[] = { from_tag_to_code<tag()>(), from_tag_to_code<tag(), true>() };
+        constexpr char buffer[] = { tag_marker, from_tag_to_code<tag()>(), tag_marker, from_tag_to_code<tag(), true>() };
         auto sv = utils::string_like_view(s);
-        return std::string(buffer, 1) + std::string(sv) + std::string(buffer + 1, 1);
+        return std::string(buffer, 2) + std::string(sv) + std::string(buffer + 2, 2);
     }
 
     template<FormatColor_t value = _value>
@@ -259,6 +264,72 @@ auto console_color(StringLike auto&& str) noexcept {
     return Formatter_t::tint(std::forward<decltype(str)>(str));
 }
 
+//! console_color, for colors that are only known at runtime
+template<FormatterType type>
+std::string tinted(FormatColor_t color, std::string_view str) {
+    static constexpr auto tints = []<size_t... I>(std::index_sequence<I...>) {
+        return std::array<std::string(*)(std::string_view), sizeof...(I)>{
+            [](std::string_view s) -> std::string {
+                return console_color<FormatColor_t(I), type>(s);
+            }...
+        };
+    }(std::make_index_sequence<size_t(FormatColor::INVALID)>{});
+
+    if(size_t(color) >= tints.size())
+        return std::string(str);
+    return tints[size_t(color)](str);
+}
+
+/**
+ * Converts a string formatted with FormatterType::TAGS to another format,
+ * so arguments only need to be formatted once for all outputs.
+ */
+template<FormatterType type>
+std::string untag(std::string_view str) {
+    constexpr char first = 'A', last = char('A' + char(FormatColor::INVALID));
+
+    std::string result;
+    result.reserve(str.size());
+
+    size_t i = 0;
+    while(i < str.size()) {
+        const size_t start = str.find(tag_marker, i);
+        if(start == std::string_view::npos || start + 1 >= str.size()) {
+            result.append(str.substr(i));
+            break;
+        }
+
+        result.append(str.substr(i, start - i));
+        const char code = str[start + 1];
+        if(code < first || code >= last) {
+            /// not a start tag, so there is nothing to color
+            i = start + 2;
+            continue;
+        }
+
+        /// find the matching end tag (tags of the same color may be nested)
+        const char end_code = char(code - first + 'a');
+        size_t end = start + 2, depth = 1;
+        for(;;) {
+            end = str.find(tag_marker, end);
+            if(end == std::string_view::npos || end + 1 >= str.size()) {
+                end = str.size();
+                break;
+            }
+            if(str[end + 1] == code)
+                ++depth;
+            else if(str[end + 1] == end_code && --depth == 0)
+                break;
+            end += 2;
+        }
+
+        result += tinted<type>(FormatColor_t(code - first), untag<type>(str.substr(start + 2, end - start - 2)));
+        i = std::min(end + 2, str.size());
+    }
+
+    return result;
+}
+
 template<typename T, typename U>
 concept is_explicitly_convertible =
            std::is_constructible<U, T>::value
@@ -893,7 +964,7 @@ bool has_log_callback();
 #    define timegm _mkgmtime
 #endif
 
-inline std::string current_time_string() {
+inline std::string time_string(std::chrono::system_clock::time_point when) {
     using namespace std::chrono;
     static const auto tod = ([](){
         time_t t = time(NULL);
@@ -907,12 +978,50 @@ inline std::string current_time_string() {
         memcpy(&locl, &buf, sizeof(struct tm));
         return std::chrono::seconds(timegm(&buf) - mktime(&locl));
     })();
-    auto t = date::floor<seconds>(system_clock::now() + tod);
+    auto t = date::floor<seconds>(when + tod);
     return date::format("%H:%M:%S", t);
 }
 
+inline std::string current_time_string() {
+    return time_string(std::chrono::system_clock::now());
+}
+
+/**
+ * A message for the asynchronous logger (see AsyncLog.h). Only the
+ * arguments are formatted by the thread that logs (once, with
+ * FormatterType::TAGS) - everything else is rendered by the logger.
+ */
+struct LogRecord {
+    enum class Kind : uint8_t {
+        PRINT, NO_NEWLINE, PREFIXED, THREAD, LOCATION
+    };
+
+    Kind kind{Kind::PRINT};
+    PrefixLiterals::Prefix prefix{PrefixLiterals::INFO};
+    FormatColor_t color{FormatColor::WHITE};
+    std::chrono::system_clock::time_point time;
+    //! the prefix of prefixed_print or the name of the thread
+    std::string label;
+    //! source location of FormatWarning & co.
+    const char* file{nullptr};
+    uint32_t line{0};
+    std::string text;
+};
+
+bool is_logging_async() noexcept;
+void log_async(LogRecord&&);
+
 template<typename... Args>
 void Print(const Args & ... args) {
+    if(is_logging_async()) {
+        log_async(LogRecord{
+            .kind = LogRecord::Kind::PRINT,
+            .time = std::chrono::system_clock::now(),
+            .text = format<FormatterType::TAGS>(args...)
+        });
+        return;
+    }
+    
     static constexpr auto bracket_color = ParseValue<FormatterType::UNIX>::bracket_color;
     
     auto str =
@@ -937,6 +1046,15 @@ void Print(const Args & ... args) {
 
 template<typename... Args>
 void NoNLPrint(const Args & ... args) {
+    if(is_logging_async()) {
+        log_async(LogRecord{
+            .kind = LogRecord::Kind::NO_NEWLINE,
+            .time = std::chrono::system_clock::now(),
+            .text = format<FormatterType::TAGS>(args...)
+        });
+        return;
+    }
+    
     static constexpr auto bracket_color = ParseValue<FormatterType::UNIX>::bracket_color;
     
     auto str =
@@ -961,6 +1079,17 @@ void NoNLPrint(const Args & ... args) {
 
 template<FormatColor prefix_color = FormatColor::YELLOW, cmn::StringLike Prefix, typename... Args>
 void prefixed_print(Prefix&& prefix, const Args & ... args) {
+    if(is_logging_async()) {
+        log_async(LogRecord{
+            .kind = LogRecord::Kind::PREFIXED,
+            .color = prefix_color,
+            .time = std::chrono::system_clock::now(),
+            .label = std::string(utils::string_like_view(prefix)),
+            .text = format<FormatterType::TAGS>(args...)
+        });
+        return;
+    }
+    
     static constexpr auto bracket_color = ParseValue<FormatterType::UNIX>::bracket_color;
     
     auto str =
@@ -989,6 +1118,16 @@ void prefixed_print(Prefix&& prefix, const Args & ... args) {
 
 template<typename... Args>
 void thread_print(const Args & ... args) {
+    if(is_logging_async()) {
+        log_async(LogRecord{
+            .kind = LogRecord::Kind::THREAD,
+            .time = std::chrono::system_clock::now(),
+            .label = get_thread_name(),
+            .text = format<FormatterType::TAGS>(args...)
+        });
+        return;
+    }
+    
     static constexpr auto bracket_color = ParseValue<FormatterType::UNIX>::bracket_color;
     
     auto str =
@@ -1021,6 +1160,21 @@ namespace cmn {
 template<FormatterType formatter, PrefixLiterals::Prefix prefix, FormatColor_t color, typename... Args>
 struct FormatColoredPrefix {
     FormatColoredPrefix(const Args& ...args, cmn::source_location info = cmn::source_location::current()) {
+        if constexpr(formatter == FormatterType::UNIX) {
+            if(is_logging_async()) {
+                log_async(LogRecord{
+                    .kind = LogRecord::Kind::LOCATION,
+                    .prefix = prefix,
+                    .color = color,
+                    .time = std::chrono::system_clock::now(),
+                    .file = info.file_name(),
+                    .line = uint32_t(info.line()),
+                    .text = format<FormatterType::TAGS>(args...)
+                });
+                return;
+            }
+        }
+        
         static constexpr auto bracket_color = ParseValue<formatter>::bracket_color;
         
         auto universal = utils::find_replace(info.file_name(), "\\", "/");
@@ -0,0 +1,65 @@
+#include "Arena.h"
+
+namespace cmn::CPULabeling {
+
+void* Arena::allocate_slow(size_t bytes, size_t alignment) {
+    /// move on to the next block that is big enough (if any)
+    while(_block + 1u < _blocks.size()) {
+        _used_before += _blocks[_block].size;
+        ++_block;
+        _offset = 0;
+
+        auto& block = _blocks[_block];
+        const size_t offset = aligned_offset(block, alignment);
+        if(offset + bytes <= block.size) {
+            _offset = offset + bytes;
+            return block.data.get() + offset;
+        }
+    }
+
+    if(not _blocks.empty()) {
+        _used_before += _blocks[_block].size;
+        ++_block;
+    }
+
+    const size_t size = max(max(min_block_size, bytes + alignment),
+                            _blocks.empty() ? size_t(0) : _blocks.back().size * 2u);
+    _blocks.push_back(Block{
+        .data = std::make_unique_for_overwrite<std::byte[]>(size),
+        .size = size
+    });
+    _block = _blocks.size() - 1u;
+    _offset = 0;
+
+    auto& block = _blocks.back();
+    const size_t offset = aligned_offset(block, alignment);
+    assert(offset + bytes <= block.size);
+    _offset = offset + bytes;
+    return block.data.get() + offset;
+}
+
+void Arena::reset() {
+    if(_blocks.size() > 1u) {
+        /// we had to grow, so next time we would most likely need to
+        /// grow again: replace everything with one big block
+        const size_t size = max(min_block_size, used());
+        _blocks.clear();
+        _blocks.push_back(Block{
+            .data = std::make_unique_for_overwrite<std::byte[]>(size),
+            .size = size
+        });
+    }
+
+    _block = 0;
+    _offset = 0;
+    _used_before = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t N = 0;
+    for(auto &block : _blocks)
+        N += block.size;
+    return N;
+}
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <commons.pc.h>
+
+namespace cmn::CPULabeling {
+
+/**
+ * Monotonic allocator for everything the labeling creates per image
+ * (Nodes, Brototypes and their line / pixel arrays). Memory is only
+ * given back all at once, by reset(), which keeps the memory around
+ * for the next image - so after the first few images, labeling does
+ * not touch the heap anymore. Destructors are never called, so only
+ * trivially destructible objects may live in here.
+ *
+ * Not thread-safe: every DLList owns its own arena.
+ */
+class Arena {
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> _blocks;
+    //! index of the block we are currently allocating from
+    size_t _block{0};
+    //! bytes used in the current block
+    size_t _offset{0};
+    //! bytes used in all previous blocks (including skipped space)
+    size_t _used_before{0};
+
+public:
+    static constexpr size_t min_block_size = 256u * 1024u;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        if(not _blocks.empty()) {
+            auto& block = _blocks[_block];
+            const size_t offset = aligned_offset(block, alignment);
+            if(offset + bytes <= block.size) {
+                _offset = offset + bytes;
+                return block.data.get() + offset;
+            }
+        }
+        return allocate_slow(bytes, alignment);
+    }
+
+    /**
+     * Grows the allocation at ptr (of old_bytes) to new_bytes without
+     * moving it. This only works for the most recent allocation, and only
+     * if the current block has enough space left.
+     */
+    bool extend(void* ptr, size_t old_bytes, size_t new_bytes) {
+        if(_blocks.empty())
+            return false;
+        auto& block = _blocks[_block];
+        if(static_cast<std::byte*>(ptr) + old_bytes != block.data.get() + _offset)
+            return false;
+        const size_t offset = _offset - old_bytes + new_bytes;
+        if(offset > block.size)
+            return false;
+        _offset = offset;
+        return true;
+    }
+
+    template<typename T>
+    T* allocate_array(size_t N) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T*>(allocate(N * sizeof(T), alignof(T)));
+    }
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Invalidates all allocations. This is O(1), unless the arena had to
+     * grow since the last reset - then its blocks are replaced by a single
+     * one that is big enough for everything allocated last time.
+     */
+    void reset();
+
+    //! Number of bytes allocated since the last reset.
+    size_t used() const {
+        return _used_before + _offset;
+    }
+
+    //! Number of bytes held by the arena.
+    size_t capacity() const;
+
+private:
+    //! offset of the next free, aligned address in the current block
+    size_t aligned_offset(const Block& block, size_t alignment) const {
+        auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        return ((base + _offset + alignment - 1u) & ~(uintptr_t(alignment) - 1u)) - base;
+    }
+
+    void* allocate_slow(size_t bytes, size_t alignment);
+};
+
+/**
+ * Growable array of trivially copyable values that lives in an Arena.
+ * Memory is never freed, growing allocates a new (bigger) piece of the
+ * arena unless the array happens to be the last allocation - then it is
+ * extended in place.
+ */
+template<typename T>
+class ArenaArray {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    T* _ptr{nullptr};
+    size_t _size{0u};
+    size_t _capacity{0u};
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    void reserve(Arena& arena, size_t N) {
+        if(N <= _capacity)
+            return;
+
+        if(_ptr && arena.extend(_ptr, _capacity * sizeof(T), N * sizeof(T))) {
+            _capacity = N;
+            return;
+        }
+
+        auto ptr = arena.allocate_array<T>(N);
+        if(_size > 0)
+            std::memcpy(ptr, _ptr, _size * sizeof(T));
+        _ptr = ptr;
+        _capacity = N;
+    }
+
+    void push_back(Arena& arena, const T& obj) {
+        if(_size == _capacity)
+            reserve(arena, max(size_t(64u), _capacity * 2u));
+        _ptr[_size++] = obj;
+    }
+
+    void resize(Arena& arena, size_t N) {
+        reserve(arena, N);
+        _size = N;
+    }
+
+    void clear() { _size = 0; }
+
+    size_t size() const { return _size; }
+    size_t capacity() const { return _capacity; }
+    bool empty() const { return _size == 0; }
+
+    T* data() { return _ptr; }
+    const T* data() const { return _ptr; }
+
+    T& operator[](size_t index) { assert(index < _size); return _ptr[index]; }
+    const T& operator[](size_t index) const { assert(index < _size); return _ptr[index]; }
+
+    const T& front() const { assert(_size > 0); return _ptr[0]; }
+    const T& back() const { assert(_size > 0); return _ptr[_size - 1u]; }
+
+    iterator begin() { return _ptr; }
+    iterator end() { return _ptr + _size; }
+    const_iterator begin() const { return _ptr; }
+    const_iterator end() const { return _ptr + _size; }
+};
+
+}
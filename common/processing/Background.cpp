@@ -159,6 +159,70 @@ std::pair<cv::Rect2i, size_t> imageFromLines(InputInfo input,
         //int diff;
         value_t value, diff;
         
+        if constexpr(input.channels == 1 && output.channels == 1
+                     && not input.is_r3g3b2() && not output.is_r3g3b2()
+                     && has_pixels)
+        {
+            /// greyscale rows are processed as a whole by the vectorized kernels
+            const auto& k = kernels::difference_kernels();
+            const auto info = background && (base_threshold > 0 || has_differences)
+                ? background->info<output, method, value_t>()
+                : Background::BackgroundInfo{ .data = nullptr, .width = 0, .channels = 0 };
+            static thread_local std::vector<uchar> scratch_diffs, scratch_mask;
+            
+            for (auto &l : lines) {
+                const auto N = ptr_safe_t(l.x1) - ptr_safe_t(l.x0) + 1;
+                const uchar* values = pixels_ptr;
+                pixels_ptr += N;
+                
+                const int y = l.y - r.y, x0 = l.x0 - r.x;
+                const uchar* bg = info.data
+                    ? info.data + (ptr_safe_t(l.x0) + ptr_safe_t(l.y) * info.width) * info.channels
+                    : nullptr;
+                
+                /// the difference row is either written straight into the output,
+                /// or into a scratch buffer (unless it would be a plain copy)
+                const uchar* d = values;
+                uchar* diff_row = nullptr;
+                if constexpr(has_differences) {
+                    diff_row = output_differences->ptr<uchar>(y) + x0;
+                } else if(method != DifferenceMethod_t::none && base_threshold > 0) {
+                    scratch_diffs.resize(N);
+                    diff_row = scratch_diffs.data();
+                }
+                if(diff_row) {
+                    kernels::difference(method, bg, values, diff_row, N, k);
+                    d = diff_row;
+                }
+                
+                if(base_threshold == 0) {
+                    if(output_mask)
+                        std::memset(output_mask->ptr<uchar>(y) + x0, 255, N);
+                    if constexpr(has_image)
+                        std::memcpy(output_greyscale->ptr<uchar>(y) + x0, values, N);
+                    recount += N;
+                    continue;
+                }
+                
+                uchar* mask_row;
+                if(output_mask)
+                    mask_row = output_mask->ptr<uchar>(y) + x0;
+                else {
+                    scratch_mask.resize(N);
+                    mask_row = scratch_mask.data();
+                }
+                
+                recount += kernels::threshold(d, mask_row, N, base_threshold, k);
+                
+                if constexpr(has_image)
+                    k.apply_mask(values, mask_row, output_greyscale->ptr<uchar>(y) + x0, N);
+                if constexpr(has_differences)
+                    k.apply_mask(diff_row, mask_row, diff_row, N);
+            }
+            
+            return;
+        }
+        
         for (auto &l : lines) {
             for (int x=l.x0; x<=l.x1; x++, pixels_ptr += input.channels) {
                 bool pixel_is_set = base_threshold == 0;
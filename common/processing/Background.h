@@ -4,6 +4,7 @@
 #include <misc/Image.h>
 //#include <processing/LuminanceGrid.h>
 #include <processing/encoding.h>
+#include <processing/DifferenceKernels.h>
 
 namespace cmn {
 
@@ -444,6 +445,17 @@ constexpr void push_pixel_value(PixelArray_t& image_ptr, Pixel value) {
             auto ptr_values = values.data();
             auto end = values.data() + (ptr_safe_t(x1) - ptr_safe_t(x0) + 1) * input.channels;
             assert(end <= values.data() + values.size());
+            
+            /// single channel rows are handled by the vectorized kernels
+            if constexpr(input.channels == 1) {
+                const auto N = ptr_safe_t(x1) - ptr_safe_t(x0) + 1;
+                assert(method == DifferenceMethod_t::none || ptr_image != nullptr);
+                if constexpr(input.is_r3g3b2())
+                    return kernels::count_above_threshold_r3g3b2(method, ptr_image, ptr_values, N, threshold);
+                else
+                    return kernels::count_above_threshold(method, ptr_image, ptr_values, N, threshold);
+            }
+            
             ptr_safe_t count = 0;
             
             if constexpr (method == DifferenceMethod_t::sign)
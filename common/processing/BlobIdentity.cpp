@@ -16,14 +16,16 @@ bid blob_bid(const Blob& blob) {
 }
 
 bid blob_bid(const CompressedBlob& blob) {
-    if (blob.lines().empty()) {
+    const auto N = blob.num_lines();
+    if (N == 0) {
         return bid::invalid;
     }
 
-    return bid::from_data(blob.lines().front().x0(),
-                          blob.lines().front().x1(),
+    const auto first = blob.first_line();
+    return bid::from_data(first.x0,
+                          first.x1,
                           blob.start_y,
-                          blob.lines().size());
+                          N);
 }
 
 }
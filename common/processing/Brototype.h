@@ -2,47 +2,35 @@
 
 #include <commons.pc.h>
 #include <processing/HLine.h>
+#include <processing/Arena.h>
 
 namespace cmn::CPULabeling {
 
 class DLList;
 
-inline void _emplace_back(auto& array, auto&& obj) {
-    const auto N = array.size();
-    //Print("capacity = ", N, " vs ", array.capacity());
-    if(array.capacity() <= N) {
-        array.reserve(max(64u, N * 2));
-        //Print("Had to reserve ", N, " -> ", array.capacity());
-    }
-        
-    array.push_back(std::move(obj));
-}
-
 //! A pair of a blob and a HorizontalLine
+//! Brototypes (and their arrays) live in the Arena of the DLList that created them.
 class Brototype {
 private:
-    using PVector = IllegalArray<Pixel>;
-    using LVector = IllegalArray<Line_t>;
+    using PVector = ArenaArray<Pixel>;
+    using LVector = ArenaArray<Line_t>;
     
+    Arena* _arena;
     GETTER_NCONST(PVector, pixel_starts);
     GETTER_NCONST(LVector, lines);
-    std::vector<Brototype*> _children;
+    ArenaArray<Brototype*> _children;
     Brototype* _parent{nullptr};
     
 public:
-    static std::unordered_set<Brototype*> brototypes();
     constexpr Brototype* has_parent() const {
         return _parent;
     }
     void set_parent(Brototype*);
     void finalize();
     
-    Brototype(size_t reserve_hint);
-    Brototype(const Line_t& line, const uchar* px);
-    ~Brototype();
+    Brototype(Arena& arena, size_t reserve_hint);
     
-    static std::mutex& mutex();
-    static void move_to_cache(DLList *list, typename std::unique_ptr<Brototype>& node);
+    static void move_to_cache(DLList *list, Brototype*& node);
     
     inline bool empty() const {
         return _lines.empty();
@@ -53,13 +41,11 @@ public:
     }
     
     inline void push_back(const Line_t& line, const uchar* px) {
-        _emplace_back(_lines, line);
-        _emplace_back(_pixel_starts, px);
+        _lines.push_back(*_arena, line);
+        _pixel_starts.push_back(*_arena, px);
     }
     
     void merge_with(const Brototype& b);
-    void _merge_with(const Brototype& b);
-    void __merge_with(const Brototype& b);
     
     struct Combined {
         decltype(Brototype::_lines)::iterator Lit;
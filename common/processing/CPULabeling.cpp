@@ -1,9 +1,10 @@
 #include "CPULabeling.h"
 #include <misc/GlobalSettings.h>
 #include <misc/Timer.h>
+#include <misc/Trace.h>
 #include <misc/pretty.h>
 #include <misc/ranges.h>
-#include <misc/ThreadPool.h>
+#include <misc/WorkStealingPool.h>
 #include <processing/PVBlob.h>
 #include <processing/Source.h>
 #include <processing/DLList.h>
@@ -13,8 +14,6 @@
 namespace cmn {
 namespace CPULabeling {
 
-//#define DEBUG_MEM
-
 /*void Node::Ref::release_check() {
     if(!obj)
         return;
@@ -74,15 +73,9 @@ void merge_lines(Source::RowRef &previous_vector,
             if(!(curr_lit)->node
                || !(curr_lit)->node->parent)
             {
-                auto p = blobs.cache().broto();
-                if(p)
-                    p->push_back(curr_lit->line, *current->Pit);
-                else {
-                    p = std::make_unique<Brototype>(reserve_hint);
-                    p->push_back(curr_lit->line, *current->Pit);
-                }
-                
-                blobs.insert((curr_lit->node), std::move(p));
+                auto p = blobs.broto(reserve_hint);
+                p->push_back(curr_lit->line, *current->Pit);
+                blobs.insert((curr_lit->node), p);
                 
             }
             
@@ -133,7 +126,7 @@ void merge_lines(Source::RowRef &previous_vector,
                        || cblob->obj->has_parent()
                        || pblob->obj->has_parent())
                     {*/
-                        cblob->obj->set_parent(pblob->obj.get());
+                        cblob->obj->set_parent(pblob->obj);
                     /*} else {
                         pblob->obj->merge_with(*cblob->obj);
                         moved = true;
@@ -186,27 +179,29 @@ void merge_lines(Source::RowRef &previous_vector,
     }
 }
 
-blobs_t run_fast(List_t* blobs, ptr_safe_t channels)
-{
-    blobs_t result;
-    auto& source = blobs->source();
-    const uint8_t initial_flags = pv::Blob::get_only_flag(pv::Blob::Flags::is_rgb, channels == 3);
+/**
+ * Runs the row-by-row merge over rows [row_begin, row_end) of source,
+ * inserting all Brototypes it creates into blobs. Rows outside of the
+ * given range are never touched, so disjoint ranges of the same Source
+ * can be labeled concurrently with different lists.
+ */
+void label_rows(List_t& blobs, Source& source, size_t row_begin, size_t row_end) {
+    if(row_begin >= row_end)
+        return;
     
-    if(source.empty())
-        return {};
+    /// moves row to the next row, but does not cross row_end
+    auto next_row = [row_end](Source::RowRef& row) {
+        row.inc_row();
+        if(row.idx >= row_end) {
+            row.line_start = row.line_end;
+            row.pixel_start = row.pixel_end;
+        }
+    };
     
-    /**
-     * SORT HORIZONTAL LINES INTO BLOBS
-     * tested cases:
-     *      - empty image
-     *      - only one line
-     *      - only two lines (one HorizontalLine in each of the two y-arrays)
-     */
-        
     // iterators for current row (y-coordinate in the original image)
     // and for the previous row (the last one above current that contains objects)
-    auto current_row = source.row(0);
-    auto previous_row = source.row(0);
+    auto current_row = Source::RowRef::from_row(&source, row_begin);
+    auto previous_row = current_row;
     
     // create blobs for the current line if its not empty
     if(current_row.valid()) {
@@ -214,46 +209,50 @@ blobs_t run_fast(List_t* blobs, ptr_safe_t channels)
         auto end = current_row.end();
         for(auto it = start; it != end; ++it) {
             auto &[o,l,p] = *it;
-            auto bob = blobs->cache().broto();
-            if(!bob)
-                bob = std::make_unique<Brototype>(l->line, *p);
-            else
-                bob->push_back(l->line, *p);
-            
-            blobs->insert(l->node, std::move(bob));
+            auto bob = blobs.broto(1);
+            bob->push_back(l->line, *p);
+            blobs.insert(l->node, bob);
         }
     }
     
     // previous_row remains the same, but current_row has to go to the next one (all blobs for the first row have already been created):
-    current_row.inc_row();
+    next_row(current_row);
     
     // loop until the current_row iterator reaches the end of all arrays
     while (previous_row.valid()) {
-        merge_lines(previous_row, current_row, *blobs);
+        merge_lines(previous_row, current_row, blobs);
         
         previous_row = current_row;
-        current_row.inc_row();
+        next_row(current_row);
     }
-    
-    /// finalize
-    for(auto it = blobs->begin(); it != blobs->end(); ++it) {
+}
+
+/**
+ * Merges all children of root Brototypes into them and moves empty
+ * Brototypes back into the cache of the list.
+ */
+void finalize_brototypes(List_t& blobs) {
+    for(auto it = blobs.begin(); it != blobs.end(); ++it) {
         if(not it->obj)
             continue;
         it->obj->finalize();
         
         if(it->obj->lines().empty()) {
-            Brototype::move_to_cache(blobs, it->obj);
+            Brototype::move_to_cache(&blobs, it->obj);
             assert(not it->obj);
         }
     }
-    
-    /**
-     * FILTER BLOBS FOR SIZE, transform them into proper format
-     */
-    result.reserve(std::distance(blobs->begin(), blobs->end()));
+}
 
+/**
+ * Transforms all (finalized) non-empty Brototypes of the list into
+ * blob::Pairs with their own lines / pixels and appends them to result.
+ */
+void materialize_blobs(List_t& blobs, ptr_safe_t channels, blobs_t& result) {
+    const uint8_t initial_flags = pv::Blob::get_only_flag(pv::Blob::Flags::is_rgb, channels == 3);
+    
     //! TODO: Do not store actual pixels in an object. Only store start pointers per Horizontal Line and delete image information when done with it [OPT]
-    for(auto it=blobs->begin(); it != blobs->end(); ++it) {
+    for(auto it=blobs.begin(); it != blobs.end(); ++it) {
         //! skip empty objects / merged objects
         if(!it->obj || it->obj->empty())
             continue;
@@ -321,47 +320,440 @@ blobs_t run_fast(List_t* blobs, ptr_safe_t channels)
         
         Node_t::move_to_cache(*it);
     }
+}
+
+/**
+ * Same as materialize_blobs, but only appends lines and pointers to
+ * the pixels of every line to output (without copying any pixels).
+ */
+void collect_blobs(List_t& blobs, FrameBlobs& output) {
+    const uint8_t initial_flags = pv::Blob::get_only_flag(pv::Blob::Flags::is_rgb, output.channels == 3);
+    
+    for(auto it=blobs.begin(); it != blobs.end(); ++it) {
+        if(!it->obj || it->obj->empty())
+            continue;
+        
+        FrameBlobs::Blob blob{
+            narrow_cast<uint32_t>(output.lines.size()),
+            0u, 0u,
+            initial_flags
+        };
+        
+        for(auto & [l, px] : *it->obj) {
+            const auto lx0 = l->x0();
+            const auto lx1 = l->x1();
+            blob.num_pixels += ptr_safe_t(lx1) - ptr_safe_t(lx0) + ptr_safe_t(1);
+            
+            if(blob.num_lines > 0
+               && output.lines.back().x1 + 1 == lx0
+               && output.lines.back().y == l->y())
+            {
+                output.lines.back().x1 = lx1;
+            } else {
+                output.lines.push_back(*l);
+                output.pixel_starts.push_back(*px);
+                ++blob.num_lines;
+            }
+        }
+        
+        output.blobs.push_back(blob);
+        Node_t::move_to_cache(*it);
+    }
+}
+
+blobs_t run_fast(List_t* blobs, ptr_safe_t channels)
+{
+    blobs_t result;
+    auto& source = blobs->source();
+    
+    if(source.empty())
+        return {};
+    
+    /**
+     * SORT HORIZONTAL LINES INTO BLOBS
+     * tested cases:
+     *      - empty image
+     *      - only one line
+     *      - only two lines (one HorizontalLine in each of the two y-arrays)
+     */
+    label_rows(*blobs, source, 0, source.num_rows());
     
-#if defined(DEBUG_MEM)
-    if(!Brototype::brototypes().empty())
-        Print("Still have ",Brototype::brototypes().size()," brototypes in memory");
+    /// finalize
+    finalize_brototypes(*blobs);
+    
+    /**
+     * FILTER BLOBS FOR SIZE, transform them into proper format
+     */
+    result.reserve(std::distance(blobs->begin(), blobs->end()));
+    materialize_blobs(*blobs, channels, result);
+    
+    /// all lines / pixels have been copied, so the arena can be reused
+    blobs->clear();
+    
+    return result;
+}
+
+/**
+ * Root of line i, halving the path on the way up. Roots are always the
+ * line with the smallest index in their set, so parents[i] <= i.
+ */
+inline uint32_t find_root(std::vector<uint32_t>& parents, uint32_t i) {
+    while(parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+inline void unite(std::vector<uint32_t>& parents, uint32_t a, uint32_t b) {
+    a = find_root(parents, a);
+    b = find_root(parents, b);
+    if(a < b)
+        parents[b] = a;
+    else if(b < a)
+        parents[a] = b;
+}
+
+/**
+ * Connects the lines of the (non-empty) source using union-find,
+ * following the same rules as merge_lines. Afterwards, cache.parents
+ * contains the blob index of every line and cache.counts the number
+ * of lines per blob. Blobs are numbered in order of their first line.
+ */
+void label_union_find(ListCache_t& cache) {
+    auto& source = cache.obj->source();
+    const size_t N = source._ptrs.size();
+    if(N >= size_t(std::numeric_limits<uint32_t>::max()))
+        throw U_EXCEPTION("Too many lines (", N, ") for the union_find backend.");
     
-    source._nodes.clear();
+    auto& parents = cache.parents;
+    parents.resize(N);
+    std::iota(parents.begin(), parents.end(), uint32_t(0));
     
-    {
-        Node_t::pool().clear();
+    /// connect lines of adjacent rows
+    const auto lines = source._ptrs.data();
+    const size_t rows = source.num_rows();
+    for(size_t r = 1; r < rows; ++r) {
+        if(source._row_y[r - 1] + 1 != source._row_y[r])
+            continue;
         
-        std::lock_guard guard(Node_t::mutex());
-        if(!Node_t::created_nodes().empty())
-            Print("Still have ",Node_t::created_nodes().size()," nodes in memory");
+        uint32_t previous = narrow_cast<uint32_t>(source._row_offsets[r - 1]);
+        uint32_t current = narrow_cast<uint32_t>(source._row_offsets[r]);
+        const uint32_t previous_end = current;
+        const uint32_t current_end = r + 1 < rows
+            ? narrow_cast<uint32_t>(source._row_offsets[r + 1])
+            : narrow_cast<uint32_t>(N);
+        
+        while(current != current_end && previous != previous_end) {
+            auto& c = lines[current].line;
+            auto& p = lines[previous].line;
+            if(c.x1() + 1 < p.x0()) {
+                ++current;
+            } else if(c.x0() > p.x1() + 1) {
+                ++previous;
+            } else {
+                unite(parents, current, previous);
+                if(c.x1() <= p.x1())
+                    ++current;
+                else
+                    ++previous;
+            }
+        }
     }
     
-    Brototype::brototypes().clear();
-#endif
+    /// replace parents by blob indexes. since parents[i] <= i, the
+    /// parent of every line has already been replaced by its index
+    auto& counts = cache.counts;
+    counts.clear();
+    for(uint32_t i = 0; i < N; ++i) {
+        if(parents[i] == i) {
+            parents[i] = narrow_cast<uint32_t>(counts.size());
+            counts.push_back(0);
+        } else
+            parents[i] = parents[parents[i]];
+        ++counts[parents[i]];
+    }
+}
+
+/**
+ * Same as run_fast, but using union-find over the lines of the source
+ * instead of Brototypes. Blobs are sorted by their first line.
+ */
+blobs_t run_union_find(ListCache_t& cache, ptr_safe_t channels) {
+    auto& source = cache.obj->source();
+    if(source.empty())
+        return {};
+    
+    label_union_find(cache);
+    
+    const size_t N = source._ptrs.size();
+    const auto lines = source._ptrs.data();
+    auto& parents = cache.parents;
+    auto& counts = cache.counts;
+    
+    /// allocate everything up front...
+    const uint8_t initial_flags = pv::Blob::get_only_flag(pv::Blob::Flags::is_rgb, channels == 3);
+    const size_t B = counts.size();
+    
+    blobs_t result;
+    result.reserve(B);
+    for(size_t b = 0; b < B; ++b) {
+        result.emplace_back(std::make_unique<std::vector<HorizontalLine>>(counts[b]),
+                            std::make_unique<PixelArray_t>(),
+                            initial_flags);
+        counts[b] = 0;
+    }
     
+    for(size_t i = 0; i < N; ++i) {
+        auto& l = lines[i].line;
+        counts[parents[i]] += uint32_t(ptr_safe_t(l.x1()) - ptr_safe_t(l.x0()) + ptr_safe_t(1));
+    }
+    
+    auto& line_cursors = cache.line_cursors;
+    auto& pixel_cursors = cache.pixel_cursors;
+    line_cursors.resize(B);
+    pixel_cursors.resize(B);
+    for(size_t b = 0; b < B; ++b) {
+        result[b].pixels->resize(counts[b] * channels);
+        line_cursors[b] = result[b].lines->data();
+        pixel_cursors[b] = result[b].pixels->data();
+    }
+    
+    /// ...then scatter all lines in order (same as materialize_blobs)
+    for(size_t i = 0; i < N; ++i) {
+        const auto b = parents[i];
+        auto& l = lines[i].line;
+        const auto lx0 = l.x0();
+        const auto lx1 = l.x1();
+        
+        auto& current = line_cursors[b];
+        if(current > result[b].lines->data()
+           && (current - 1)->x1 + 1 == lx0
+           && (current - 1)->y == l.y())
+        {
+            (current - 1)->x1 = lx1;
+        } else {
+            *current++ = l;
+        }
+        
+        assert(source._pixels[i]);
+        const size_t n = (ptr_safe_t(lx1) - ptr_safe_t(lx0) + ptr_safe_t(1)) * channels;
+        std::memcpy(pixel_cursors[b], source._pixels[i], n);
+        pixel_cursors[b] += n;
+    }
+    
+    for(size_t b = 0; b < B; ++b) {
+        auto& blob_lines = *result[b].lines;
+        blob_lines.resize(size_t(line_cursors[b] - blob_lines.data()));
+    }
+    
+    source.clear();
     return result;
 }
 
+/**
+ * Same as run_union_find, but writes FrameBlobs instead of copying.
+ */
+void run_union_find(ListCache_t& cache, FrameBlobs& output) {
+    auto& source = cache.obj->source();
+    if(source.empty())
+        return;
+    
+    label_union_find(cache);
+    
+    const size_t N = source._ptrs.size();
+    const auto lines = source._ptrs.data();
+    auto& parents = cache.parents;
+    auto& counts = cache.counts;
+    const size_t B = counts.size();
+    const uint8_t initial_flags = pv::Blob::get_only_flag(pv::Blob::Flags::is_rgb, output.channels == 3);
+    
+    /// reserve room for all (unmerged) lines of every blob, and
+    /// use counts as the write cursor of each blob
+    output.blobs.resize(B);
+    uint32_t offset = 0;
+    for(size_t b = 0; b < B; ++b) {
+        output.blobs[b] = FrameBlobs::Blob{offset, 0u, 0u, initial_flags};
+        offset += counts[b];
+        counts[b] = output.blobs[b].line_offset;
+    }
+    
+    output.lines.resize(N);
+    output.pixel_starts.resize(N);
+    
+    for(size_t i = 0; i < N; ++i) {
+        const auto b = parents[i];
+        auto& blob = output.blobs[b];
+        auto& l = lines[i].line;
+        const auto lx0 = l.x0();
+        const auto lx1 = l.x1();
+        blob.num_pixels += ptr_safe_t(lx1) - ptr_safe_t(lx0) + ptr_safe_t(1);
+        
+        auto& cursor = counts[b];
+        if(cursor > blob.line_offset
+           && output.lines[cursor - 1].x1 + 1 == lx0
+           && output.lines[cursor - 1].y == l.y())
+        {
+            output.lines[cursor - 1].x1 = lx1;
+        } else {
+            output.lines[cursor] = l;
+            output.pixel_starts[cursor] = source._pixels[i];
+            ++cursor;
+        }
+    }
+    
+    /// close the gaps left by merged lines
+    uint32_t write = 0;
+    for(size_t b = 0; b < B; ++b) {
+        auto& blob = output.blobs[b];
+        blob.num_lines = counts[b] - blob.line_offset;
+        if(write != blob.line_offset) {
+            std::copy_n(output.lines.begin() + blob.line_offset, blob.num_lines, output.lines.begin() + write);
+            std::copy_n(output.pixel_starts.begin() + blob.line_offset, blob.num_lines, output.pixel_starts.begin() + write);
+            blob.line_offset = write;
+        }
+        write += blob.num_lines;
+    }
+    
+    output.lines.resize(write);
+    output.pixel_starts.resize(write);
+    source.clear();
+}
+
+/**
+ * Returns the Brototype that a line has been merged into (or its own).
+ * Parents are kept flat by Brototype::set_parent, so one indirection is enough.
+ */
+inline Brototype* root_of(const Source::LinePtr& ptr) {
+    assert(ptr.node && ptr.node->obj);
+    auto obj = ptr.node->obj;
+    if(auto parent = obj->has_parent())
+        return parent;
+    return obj;
+}
+
+/**
+ * Connects the components of two adjacent rows that have been labeled
+ * by different lists, using the same connectivity rules as merge_lines.
+ */
+void merge_seam(Source& source, size_t upper_row, size_t lower_row) {
+    assert(upper_row + 1 == lower_row);
+    if(source._row_y[upper_row] + 1 != source._row_y[lower_row])
+        return;
+    
+    auto previous = source._ptrs.data() + source._row_offsets[upper_row];
+    auto current = source._ptrs.data() + source._row_offsets[lower_row];
+    auto previous_end = current;
+    auto current_end = lower_row + 1 < source._row_offsets.size()
+        ? source._ptrs.data() + source._row_offsets[lower_row + 1]
+        : source._ptrs.data() + source._ptrs.size();
+    
+    while(current != current_end && previous != previous_end) {
+        if(current->line.x1() + 1 < previous->line.x0()) {
+            ++current;
+            
+        } else if(current->line.x0() > previous->line.x1() + 1) {
+            ++previous;
+            
+        } else {
+            auto a = root_of(*current);
+            auto b = root_of(*previous);
+            if(a != b) {
+                // move the smaller set into the bigger one
+                if(a->size() > b->size())
+                    std::swap(a, b);
+                a->set_parent(b);
+            }
+            
+            if(current->line.x1() <= previous->line.x1())
+                ++current;
+            else
+                ++previous;
+        }
+    }
+}
+
 // called by user
 blobs_t run(DLList& list, const cv::Mat &image, bool enable_threads) {
-    //auto list = List_t::from_cache();
+    CMN_TRACE_SCOPE_ARG("CPULabeling::run", image.rows);
     //DLList list;
     list.clear();
     list.source().init(image, enable_threads);
     
-    blobs_t results = run_fast(&list, image.channels());
-    //List_t::to_cache(std::move(list));
-    list.clear();
-    return results;
+    return run_fast(&list, image.channels());
 }
 
 blobs_t run(const cv::Mat &image, ListCache_t& cache, bool enable_threads) {
-    //auto list = List_t::from_cache();
+    CMN_TRACE_SCOPE_ARG("CPULabeling::run", image.rows);
     //DLList list;
     cache.obj->source().init(image, enable_threads);
+    if(cache.backend == labeling_backend_t::union_find)
+        return run_union_find(cache, image.channels());
     return run_fast(cache.obj, image.channels());
-    //List_t::to_cache(std::move(list));
-    //return results;
+}
+
+void run(const cv::Mat &image, ListCache_t& cache, FrameBlobs& output, bool enable_threads) {
+    CMN_TRACE_SCOPE_ARG("CPULabeling::init", image.rows);
+    cache.obj->source().init(image, enable_threads);
+    run(cache, narrow_cast<uint8_t>(image.channels()), output);
+}
+
+blobs_t run(ListCache_t& cache, uint8_t channels) {
+    CMN_TRACE_SCOPE("CPULabeling::run");
+    if(cache.backend == labeling_backend_t::union_find)
+        return run_union_find(cache, channels);
+    return run_fast(cache.obj, channels);
+}
+
+void run(ListCache_t& cache, uint8_t channels, FrameBlobs& output) {
+    CMN_TRACE_SCOPE("CPULabeling::run");
+    output.clear();
+    output.channels = channels;
+    
+    auto& list = *cache.obj;
+    if(list.source().empty()) {
+        list.clear();
+        return;
+    }
+    
+    if(cache.backend == labeling_backend_t::union_find) {
+        run_union_find(cache, output);
+        return;
+    }
+    
+    label_rows(list, list.source(), 0, list.source().num_rows());
+    finalize_brototypes(list);
+    collect_blobs(list, output);
+    
+    /// pixels are still in the image, everything else has been copied
+    list.clear();
+}
+
+blob::Pair FrameBlobs::materialize(size_t index) const {
+    auto& blob = blobs.at(index);
+    auto L = lines_of(index);
+    auto P = pixel_starts_of(index);
+    
+    auto pixels = std::make_unique<PixelArray_t>(blob.num_pixels * channels);
+    auto pixel = pixels->data();
+    for(size_t i = 0; i < L.size(); ++i) {
+        assert(P[i]);
+        const size_t N = (ptr_safe_t(L[i].x1) - ptr_safe_t(L[i].x0) + ptr_safe_t(1)) * channels;
+        std::memcpy(pixel, P[i], N);
+        pixel += N;
+    }
+    
+    return blob::Pair(std::make_unique<std::vector<HorizontalLine>>(L.begin(), L.end()),
+                      std::move(pixels),
+                      blob.extra_flags);
+}
+
+blobs_t FrameBlobs::materialize() const {
+    blobs_t result;
+    result.reserve(size());
+    for(size_t i = 0; i < size(); ++i)
+        result.emplace_back(materialize(i));
+    return result;
 }
 
 // called by user
@@ -370,6 +762,7 @@ blobs_t run(const std::vector<HorizontalLine>& lines,
             ListCache_t& cache,
             uint8_t channels)
 {
+    CMN_TRACE_SCOPE_ARG("CPULabeling::run", lines.size());
     auto px = pixels.data();
     //list.clear();
     //List_t list;
@@ -403,6 +796,8 @@ blobs_t run(const std::vector<HorizontalLine>& lines,
             px += (ptr_safe_t(it->x1) - ptr_safe_t(it->x0) + ptr_safe_t(1)) * ptr_safe_t(channels);
     }
 
+    if(cache.backend == labeling_backend_t::union_find)
+        return run_union_find(cache, channels);
     return run_fast(&list, channels);
 }
 
@@ -414,10 +809,123 @@ blobs_t run(const std::vector<HorizontalLine>& lines,
         return {};
     
     ListCache_t cache;
-    //auto list = List_t::from_cache();
-    //List_t::to_cache(std::move(list));
     return run(lines, pixels, cache, channels);
 }
 
+/**
+ * The root of a component depends on how the image was split, so
+ * sort by first line to get the same order for any number of bands.
+ */
+void sort_by_first_line(blobs_t& blobs) {
+    std::sort(blobs.begin(), blobs.end(), [](const blob::Pair& A, const blob::Pair& B) {
+        return A.lines->front() < B.lines->front();
+    });
+}
+
+blobs_t run_tiled(const cv::Mat &image, ListCache_t& cache, uint32_t bands) {
+    CMN_TRACE_SCOPE_ARG("CPULabeling::run_tiled", image.rows);
+    auto& pool = Source::pool();
+    auto& source = cache.obj->source();
+    
+    cache.obj->clear();
+    source.init(image, true);
+    
+    if(source.empty())
+        return {};
+    
+    /// union-find labels all lines in one go (its blobs are already
+    /// sorted by their first line), only line extraction is threaded
+    if(cache.backend == labeling_backend_t::union_find)
+        return run_union_find(cache, image.channels());
+    
+    if(bands == 0)
+        bands = narrow_cast<uint32_t>(pool.num_threads());
+    bands = narrow_cast<uint32_t>(min(size_t(bands), source.num_rows()));
+    
+    /// not worth splitting anything up, fall back to the sequential path
+    if(bands <= 1) {
+        auto result = run_fast(cache.obj, image.channels());
+        sort_by_first_line(result);
+        return result;
+    }
+    
+    while(cache.bands.size() < bands)
+        cache.bands.push_back(new DLList);
+    
+    /// split rows so that every band receives roughly the same number
+    /// of lines (instead of rows), since objects are rarely spread
+    /// evenly across the image
+    std::vector<size_t> offsets(bands + 1u);
+    offsets.front() = 0;
+    offsets.back() = source.num_rows();
+    
+    const size_t total_lines = source._ptrs.size();
+    for(uint32_t i = 1; i < bands; ++i) {
+        const size_t target = total_lines * i / bands;
+        auto it = std::lower_bound(source._row_offsets.begin(), source._row_offsets.end(), target);
+        offsets[i] = max(offsets[i - 1], size_t(std::distance(source._row_offsets.begin(), it)));
+    }
+    
+    /// label all bands independently (each one with its own list)
+    distribute_indexes([&](auto, uint32_t start, uint32_t end, auto) {
+        for(uint32_t i = start; i < end; ++i) {
+            auto band = cache.bands[i];
+            band->clear();
+            label_rows(*band, source, offsets[i], offsets[i + 1]);
+        }
+    }, pool, uint32_t(0), bands, bands);
+    
+    /// connect components crossing the borders between bands
+    for(uint32_t i = 1; i < bands; ++i) {
+        if(offsets[i] == 0 || offsets[i] >= source.num_rows())
+            continue;
+        merge_seam(source, offsets[i] - 1, offsets[i]);
+    }
+    
+    /// roots may now have children that live in other bands, so we
+    /// cannot use finalize_brototypes right away: collect all roots
+    /// first (read-only), then let every root merge its own children.
+    /// children are never shared between roots, so no locks are needed.
+    std::vector<std::vector<Brototype*>> roots(bands);
+    distribute_indexes([&](auto, uint32_t start, uint32_t end, auto) {
+        for(uint32_t i = start; i < end; ++i) {
+            roots[i].clear();
+            for(auto it = cache.bands[i]->begin(); it != cache.bands[i]->end(); ++it) {
+                if(it->obj && not it->obj->has_parent())
+                    roots[i].push_back(it->obj);
+            }
+        }
+    }, pool, uint32_t(0), bands, bands);
+    
+    distribute_indexes([&](auto, uint32_t start, uint32_t end, auto) {
+        for(uint32_t i = start; i < end; ++i) {
+            for(auto root : roots[i])
+                root->finalize();
+        }
+    }, pool, uint32_t(0), bands, bands);
+    
+    /// everything is merged now, only cleanup and copying is left
+    std::vector<blobs_t> results(bands);
+    distribute_indexes([&](auto, uint32_t start, uint32_t end, auto) {
+        for(uint32_t i = start; i < end; ++i) {
+            finalize_brototypes(*cache.bands[i]);
+            materialize_blobs(*cache.bands[i], image.channels(), results[i]);
+            cache.bands[i]->clear();
+        }
+    }, pool, uint32_t(0), bands, bands);
+    
+    size_t N = 0;
+    for(auto &r : results)
+        N += r.size();
+    
+    blobs_t result;
+    result.reserve(N);
+    for(auto &r : results)
+        std::move(r.begin(), r.end(), std::back_inserter(result));
+    
+    sort_by_first_line(result);
+    return result;
+}
+
 }
 }
@@ -13,8 +13,26 @@ namespace cmn::CPULabeling {
      * @return an array of the blobs found in image
      */
     blobs_t run(DLList&, const cv::Mat &image, bool enable_threads = false);
+    
+    //! Same as above, but uses the algorithm selected by ListCache_t::backend.
     blobs_t run(const cv::Mat &image, ListCache_t& list, bool enable_threads = false);
 
+    /**
+     * Same as run(image, list, true), but also labels the image in parallel:
+     * rows are split into horizontal bands (with roughly the same number of
+     * lines each), every band is labeled by its own worker / list, and
+     * components touching the borders between bands are merged afterwards.
+     * The resulting blobs are identical to the ones returned by run(), but
+     * they are sorted by their first line (top-left to bottom-right).
+     * With ListCache_t::backend set to union_find, only the lines are
+     * extracted in parallel and labeling runs on the whole image at once.
+     *
+     * @param image a binary image in CV_8UC1 format
+     * @param bands number of bands to split the image into (0 = one per thread in the pool)
+     * @return an array of the blobs found in image
+     */
+    blobs_t run_tiled(const cv::Mat &image, ListCache_t& list, uint32_t bands = 0);
+
     /**
      * Given a set of horizontal lines, this function will extract all connected components and return them as a list of Blobs.
      * @param lines a list of HorizontalLines
@@ -28,8 +46,81 @@ namespace cmn::CPULabeling {
      * Given a set of horizontal lines, this function will extract all connected components and return them as a list of Blobs.
      * @param lines a list of HorizontalLines
      * @param pixels all pixels in the same order as the lines in lines (each from x0 to x1+1).
+     * Uses the algorithm selected by ListCache_t::backend.
      * @param channels channels of the pixel array
      * @return an array of the blobs found in image
      */
     blobs_t run(const std::vector<HorizontalLine>& lines, std::span<uchar> pixels, ListCache_t&, uint8_t channels);
+
+    /**
+     * Blobs of one frame that do not own their lines / pixels: lines of
+     * all blobs are stored back to back in one buffer, and pixels are
+     * referenced by pointers to the start of every line in the labeled
+     * image (or pixel array). Nothing is copied or allocated per blob,
+     * and all buffers are reused when the same object is passed to run()
+     * again.
+     *
+     * The pixel pointers are only valid as long as the labeled image is,
+     * so anything that needs to outlive the frame has to be materialized.
+     */
+    struct FrameBlobs {
+        struct Blob {
+            uint32_t line_offset;
+            uint32_t num_lines;
+            uint64_t num_pixels;
+            uint8_t extra_flags;
+        };
+        
+        std::vector<HorizontalLine> lines;
+        //! start of the pixels of every line (same index as lines)
+        std::vector<const uchar*> pixel_starts;
+        std::vector<Blob> blobs;
+        uint8_t channels{1};
+        
+        void clear() {
+            lines.clear();
+            pixel_starts.clear();
+            blobs.clear();
+        }
+        size_t size() const { return blobs.size(); }
+        bool empty() const { return blobs.empty(); }
+        
+        std::span<const HorizontalLine> lines_of(size_t index) const {
+            auto& blob = blobs.at(index);
+            return { lines.data() + blob.line_offset, blob.num_lines };
+        }
+        std::span<const uchar* const> pixel_starts_of(size_t index) const {
+            auto& blob = blobs.at(index);
+            return { pixel_starts.data() + blob.line_offset, blob.num_lines };
+        }
+        
+        //! Copies the given blob into its own lines / pixels.
+        blob::Pair materialize(size_t index) const;
+        //! Copies all blobs, resulting in the same as run() would have returned.
+        blobs_t materialize() const;
+    };
+    
+    /**
+     * Same as run(image, list, enable_threads), but writes blobs to output
+     * without copying any pixels (see FrameBlobs). The order of blobs is
+     * the same as for run().
+     *
+     * @param image a binary image in CV_8UC1 format, has to stay alive while output is used
+     * @param output replaced by the blobs found in image
+     */
+    void run(const cv::Mat &image, ListCache_t& list, FrameBlobs& output, bool enable_threads = false);
+    
+    /**
+     * Labels the lines that are already in the Source of list (e.g. the
+     * ones written by RawProcessing::generate_lines), instead of
+     * extracting them from an image first. Uses the algorithm selected by
+     * ListCache_t::backend. The source is cleared afterwards.
+     *
+     * @param channels channels of the image the pixel pointers point into
+     * @return an array of the blobs found in the source
+     */
+    blobs_t run(ListCache_t& list, uint8_t channels);
+    
+    //! Same as run(list, channels), but writes blobs to output (see FrameBlobs).
+    void run(ListCache_t& list, uint8_t channels, FrameBlobs& output);
 }
@@ -2,29 +2,14 @@
 
 namespace cmn::CPULabeling {
 
-Node::Node(std::unique_ptr<Brototype>&& obj, DLList* parent)
-    : parent(parent), obj(std::move(obj))
-{
-#if defined(DEBUG_MEM)
-    std::lock_guard guard(mutex());
-    created_nodes().insert(this);
-#endif
-}
+Node::Node(Brototype* obj, DLList* parent)
+    : parent(parent), obj(obj)
+{ }
 
 void Node::init(DLList* parent) {
     this->parent = parent;
 }
 
-void invalidate();
-
-Node::~Node() {
-    invalidate();
-#if defined(DEBUG_MEM)
-    std::lock_guard guard(mutex());
-    created_nodes().erase(this);
-#endif
-}
-
 void Node::invalidate() {
     Brototype::move_to_cache(parent, obj);
     
@@ -55,64 +40,46 @@ void Node::invalidate() {
     //assert(!parent);
 }
 
-void Node::move_to_cache(Node::Ref& node) {
-    move_to_cache(node.get());
-    node = nullptr;
-}
-
 void Node::move_to_cache(Node::Ptr node) {
     if(!node)
         return;
     
-    if(node->parent)
+    if(auto list = node->parent) {
         node->invalidate();
+        list->cache().receive(node);
+    }
 }
 
-std::unique_ptr<Brototype> DLList::Cache::broto() {
-    //std::lock_guard guard(_mutex);
+Brototype* DLList::Cache::broto() {
     if(_brotos.empty())
         return nullptr;
-    auto ptr = std::move(_brotos.back());
+    auto ptr = _brotos.back();
     _brotos.pop_back();
     return ptr;
 }
 
-void DLList::Cache::node(typename Node::Ref& ptr) {
-    //std::lock_guard guard(_mutex);
+Node::Ptr DLList::Cache::node() {
     if(_nodes.empty())
-        return;
-    ptr = std::move(_nodes.back());
+        return nullptr;
+    auto ptr = _nodes.back();
     _nodes.pop_back();
+    return ptr;
 }
 
-void DLList::Cache::receive(typename Node::Ref&& ref) {
-    //std::lock_guard guard(_mutex);
-    assert(!ref || ref->next == nullptr);
-    assert(!ref || ref->prev == nullptr);
-    if(ref) ref->parent = nullptr;
-    _nodes.emplace_back(std::move(ref));
-}
-void DLList::Cache::receive(std::unique_ptr<Brototype>&& ptr) {
-    //std::lock_guard guard(_mutex);
-    _brotos.emplace_back(std::move(ptr));
+void DLList::Cache::receive(Node::Ptr ptr) {
+    assert(ptr->next == nullptr);
+    assert(ptr->prev == nullptr);
+    ptr->parent = nullptr;
+    _nodes.emplace_back(ptr);
 }
 
-std::unique_ptr<DLList> DLList::from_cache() {
-    std::lock_guard g(cmutex());
-    if(!caches().empty()) {
-        auto ptr = std::move(caches().back());
-        caches().pop_back();
-        return ptr;
-    }
-    return std::make_unique<DLList>();
+void DLList::Cache::receive(Brototype* ptr) {
+    _brotos.emplace_back(ptr);
 }
 
-void DLList::to_cache(std::unique_ptr<DLList>&& ptr) {
-    ptr->clear();
-    
-    std::lock_guard g(cmutex());
-    caches().emplace_back(std::move(ptr));
-    //ptr = nullptr;
+void DLList::Cache::clear() {
+    _nodes.clear();
+    _brotos.clear();
 }
 
 Node::Ptr DLList::insert(Node::Ptr ptr) {
@@ -140,43 +107,36 @@ Node::Ptr DLList::insert(Node::Ptr ptr) {
     return ptr;
 }
 
-void DLList::insert(Node::Ptr& ptr, std::unique_ptr<Brototype>&& obj) {
-    //ptr.release_check();
-    Node::Ref ref;
-    cache().node(ref);
+void DLList::insert(Node::Ptr& ptr, Brototype* obj) {
+    auto node = cache().node();
     
-    if(!ref) {
-        ref = Node::make(std::move(obj), this);
+    if(!node) {
+        node = _arena.make<Node>(obj, this);
     } else {
-        assert(!ref->next);
-        assert(!ref->prev);
+        assert(!node->next);
+        assert(!node->prev);
         
-        ref->init(this);
-        ref->obj = std::move(obj);
+        node->init(this);
+        node->obj = obj;
     }
     
-    ptr = ref.get();
+    ptr = node;
     insert(ptr);
-    _owned.emplace_back(std::move(ref));
 }
 
-DLList::~DLList() {
-    clear();
+Brototype* DLList::broto(size_t reserve_hint) {
+    if(auto ptr = _cache.broto())
+        return ptr;
+    return _arena.make<Brototype>(_arena, reserve_hint);
 }
 
 void DLList::clear() {
     _source.clear();
     
-    auto ptr = std::move(_begin);
-    while (ptr != nullptr) {
-        auto next = ptr->next;
-        auto p = ptr;
-        Node::move_to_cache(p);
-        ptr = std::move(next);
-    }
-    _end = nullptr;
-    
-    _owned.clear();
+    /// everything lives in the arena, so there is nothing to unlink
+    _begin = _end = nullptr;
+    _cache.clear();
+    _arena.reset();
 }
 
 }
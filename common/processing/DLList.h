@@ -4,6 +4,7 @@
 #include <processing/Node.h>
 #include <processing/Brototype.h>
 #include <processing/Source.h>
+#include <processing/Arena.h>
 
 namespace cmn::CPULabeling {
 
@@ -43,46 +44,33 @@ public:
     
     Node::Ptr _begin = nullptr;
     Node::Ptr _end = nullptr;
-    std::vector<Node::Ref> _owned;
-    
-    std::unordered_map<Brototype*, std::vector<std::unique_ptr<Brototype>>> merged_objects;
     
+    //! Nodes / Brototypes that are not in use anymore, but still live in the arena
     struct Cache {
-        //std::mutex _mutex;
-        std::vector<typename Node::Ref> _nodes;
-        std::vector<std::unique_ptr<Brototype>> _brotos;
-        
-        std::unique_ptr<Brototype> broto();
+        std::vector<Node::Ptr> _nodes;
+        std::vector<Brototype*> _brotos;
         
-        void node(typename Node::Ref& ptr);
+        Brototype* broto();
+        Node::Ptr node();
         
-        void receive(typename Node::Ref&& ref);
-        void receive(std::unique_ptr<Brototype>&& ptr);
+        void receive(Node::Ptr ptr);
+        void receive(Brototype* ptr);
+        void clear();
     };
     
     GETTER_NCONST(Cache, cache);
     GETTER_NCONST(Source, source);
+    //! owns all Nodes / Brototypes of this list until the next clear()
+    GETTER_NCONST(Arena, arena);
     
 public:
-    static auto& cmutex() {
-        static std::mutex _mutex;
-        return _mutex;
-    }
-    
-    static auto& caches() {
-        static std::vector<std::unique_ptr<DLList>> _caches;
-        return _caches;
-    }
-    
-    inline static std::unique_ptr<DLList> from_cache();
-    inline static void to_cache(std::unique_ptr<DLList>&& ptr);
-    
     Node::Ptr insert(Node::Ptr ptr);
+    void insert(Node::Ptr& ptr, Brototype* obj);
     
-public:
-    void insert(Node::Ptr& ptr, std::unique_ptr<Brototype>&& obj);
+    //! Returns an empty Brototype from the cache, or a new one from the arena.
+    Brototype* broto(size_t reserve_hint);
     
-    ~DLList();
+    //! Forgets about all nodes and resets the arena in O(1).
     void clear();
     
     constexpr iterator begin() { return _iterator<Node, Node::Ptr>(_begin); }
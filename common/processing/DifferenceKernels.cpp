@@ -0,0 +1,757 @@
+#include "DifferenceKernels.h"
+#include <processing/Background.h>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define CMN_KERNELS_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define CMN_TARGET(ISA)
+    #else
+        #define CMN_TARGET(ISA) __attribute__((target(ISA)))
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define CMN_KERNELS_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace cmn::kernels {
+
+namespace {
+
+/// which value is compared to the threshold / written to the output
+enum class Op {
+    subs,       // max(0, a - b)
+    absdiff,    // |a - b|
+    value       // a
+};
+
+/// which value is compared to the per-pixel thresholds
+enum class RelativeOp {
+    sign,       // int(bg) - int(v)
+    absolute,   // |int(bg) - int(v)|
+    none        // int(v)
+};
+
+/**
+ * ===============================================
+ * Scalar fallbacks (also used for the tails of
+ * rows that do not fill a whole vector)
+ * ===============================================
+ */
+namespace scalar {
+
+template<Op op>
+size_t count(const uchar* a, const uchar* b, size_t N, uint8_t t) {
+    size_t count = 0;
+    for(size_t i = 0; i < N; ++i) {
+        if constexpr(op == Op::subs)
+            count += int32_t(a[i]) - int32_t(b[i]) >= int32_t(t);
+        else if constexpr(op == Op::absdiff)
+            count += std::abs(int32_t(a[i]) - int32_t(b[i])) >= int32_t(t);
+        else
+            count += a[i] >= t;
+    }
+    return count;
+}
+
+template<Op op>
+void transform(const uchar* a, const uchar* b, uchar* output, size_t N) {
+    for(size_t i = 0; i < N; ++i) {
+        if constexpr(op == Op::subs)
+            output[i] = uchar(std::max(0, int32_t(a[i]) - int32_t(b[i])));
+        else if constexpr(op == Op::absdiff)
+            output[i] = uchar(std::abs(int32_t(a[i]) - int32_t(b[i])));
+        else
+            output[i] = a[i] & b[i];
+    }
+}
+
+size_t threshold(const uchar* a, uchar* mask, size_t N, uint8_t t) {
+    size_t count = 0;
+    for(size_t i = 0; i < N; ++i) {
+        const bool set = a[i] >= t;
+        mask[i] = set ? 255 : 0;
+        count += set;
+    }
+    return count;
+}
+
+template<RelativeOp op>
+size_t count_relative(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold) {
+    size_t count = 0;
+    for(size_t i = 0; i < N; ++i) {
+        int32_t d;
+        if constexpr(op == RelativeOp::sign)
+            d = int32_t(bg[i]) - int32_t(v[i]);
+        else if constexpr(op == RelativeOp::absolute)
+            d = std::abs(int32_t(bg[i]) - int32_t(v[i]));
+        else
+            d = int32_t(v[i]);
+        count += d >= int32_t(relative[i]) * threshold;
+    }
+    return count;
+}
+
+}
+
+/// offsets b only if it is actually used (it may be nullptr otherwise)
+template<Op op>
+constexpr const uchar* offset(const uchar* b, size_t i) {
+    if constexpr(op == Op::value)
+        return b;
+    else
+        return b + i;
+}
+
+#if defined(CMN_KERNELS_X86)
+/**
+ * ===============================================
+ * SSE4.1
+ * ===============================================
+ */
+namespace sse41 {
+
+template<Op op>
+CMN_TARGET("sse4.1") inline __m128i apply(const uchar* a, const uchar* b) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+    if constexpr(op == Op::value) {
+        return x;
+    } else {
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        if constexpr(op == Op::subs)
+            return _mm_subs_epu8(x, y);
+        else
+            return _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+    }
+}
+
+CMN_TARGET("sse4.1") inline uint64_t horizontal_sum(__m128i v) {
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return lanes[0] + lanes[1];
+}
+
+template<Op op>
+CMN_TARGET("sse4.1") size_t count(const uchar* a, const uchar* b, size_t N, uint8_t t) {
+    const __m128i T = _mm_set1_epi8(char(t));
+    const __m128i zero = _mm_setzero_si128();
+    const size_t vec_end = N - N % 16u;
+    __m128i total = zero;
+    size_t i = 0;
+
+    while(i < vec_end) {
+        /// bytes of the accumulator overflow after 255 increments
+        const size_t block_end = std::min(vec_end, i + 16u * 255u);
+        __m128i acc = zero;
+        for(; i < block_end; i += 16) {
+            const __m128i d = apply<op>(a + i, offset<op>(b, i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_max_epu8(d, T), d));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+    }
+
+    return size_t(horizontal_sum(total)) + scalar::count<op>(a + i, offset<op>(b, i), N - i, t);
+}
+
+template<Op op>
+CMN_TARGET("sse4.1") void transform(const uchar* a, const uchar* b, uchar* output, size_t N) {
+    const size_t vec_end = N - N % 16u;
+    size_t i = 0;
+    for(; i < vec_end; i += 16) {
+        __m128i d;
+        if constexpr(op == Op::value) {
+            d = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        } else
+            d = apply<op>(a + i, b + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), d);
+    }
+    scalar::transform<op>(a + i, b + i, output + i, N - i);
+}
+
+CMN_TARGET("sse4.1") size_t threshold(const uchar* a, uchar* mask, size_t N, uint8_t t) {
+    const __m128i T = _mm_set1_epi8(char(t));
+    const __m128i zero = _mm_setzero_si128();
+    const size_t vec_end = N - N % 16u;
+    __m128i total = zero;
+    size_t i = 0;
+
+    while(i < vec_end) {
+        const size_t block_end = std::min(vec_end, i + 16u * 255u);
+        __m128i acc = zero;
+        for(; i < block_end; i += 16) {
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            const __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(d, T), d);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), m);
+            acc = _mm_sub_epi8(acc, m);
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+    }
+
+    return size_t(horizontal_sum(total)) + scalar::threshold(a + i, mask + i, N - i, t);
+}
+
+template<RelativeOp op>
+CMN_TARGET("sse4.1") size_t count_relative(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold) {
+    const __m128i T = _mm_set1_epi32(threshold);
+    const size_t vec_end = N - N % 8u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 8) {
+        __m128i d = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i)));
+        if constexpr(op != RelativeOp::none) {
+            const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bg + i)));
+            d = _mm_sub_epi16(b, d);
+            if constexpr(op == RelativeOp::absolute)
+                d = _mm_abs_epi16(d);
+        }
+
+        /// thresholds are saturated to int16, which does not
+        /// change the outcome since |d| <= 255
+        const __m128i t0 = _mm_mullo_epi32(_mm_cvttps_epi32(_mm_loadu_ps(relative + i)), T);
+        const __m128i t1 = _mm_mullo_epi32(_mm_cvttps_epi32(_mm_loadu_ps(relative + i + 4)), T);
+        const __m128i below = _mm_cmpgt_epi16(_mm_packs_epi32(t0, t1), d);
+        count += 8u - size_t(std::popcount(uint32_t(_mm_movemask_epi8(below)))) / 2u;
+    }
+
+    return count + scalar::count_relative<op>(op == RelativeOp::none ? bg : bg + i, v + i, relative + i, N - i, threshold);
+}
+
+}
+
+/**
+ * ===============================================
+ * AVX2
+ * ===============================================
+ */
+namespace avx2 {
+
+template<Op op>
+CMN_TARGET("avx2") inline __m256i apply(const uchar* a, const uchar* b) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    if constexpr(op == Op::value) {
+        return x;
+    } else {
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        if constexpr(op == Op::subs)
+            return _mm256_subs_epu8(x, y);
+        else
+            return _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+    }
+}
+
+CMN_TARGET("avx2") inline uint64_t horizontal_sum(__m256i v) {
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+template<Op op>
+CMN_TARGET("avx2") size_t count(const uchar* a, const uchar* b, size_t N, uint8_t t) {
+    const __m256i T = _mm256_set1_epi8(char(t));
+    const __m256i zero = _mm256_setzero_si256();
+    const size_t vec_end = N - N % 32u;
+    __m256i total = zero;
+    size_t i = 0;
+
+    while(i < vec_end) {
+        const size_t block_end = std::min(vec_end, i + 32u * 255u);
+        __m256i acc = zero;
+        for(; i < block_end; i += 32) {
+            const __m256i d = apply<op>(a + i, offset<op>(b, i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_max_epu8(d, T), d));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+    }
+
+    return size_t(horizontal_sum(total)) + scalar::count<op>(a + i, offset<op>(b, i), N - i, t);
+}
+
+template<Op op>
+CMN_TARGET("avx2") void transform(const uchar* a, const uchar* b, uchar* output, size_t N) {
+    const size_t vec_end = N - N % 32u;
+    size_t i = 0;
+    for(; i < vec_end; i += 32) {
+        __m256i d;
+        if constexpr(op == Op::value) {
+            d = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        } else
+            d = apply<op>(a + i, b + i);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), d);
+    }
+    scalar::transform<op>(a + i, b + i, output + i, N - i);
+}
+
+CMN_TARGET("avx2") size_t threshold(const uchar* a, uchar* mask, size_t N, uint8_t t) {
+    const __m256i T = _mm256_set1_epi8(char(t));
+    const __m256i zero = _mm256_setzero_si256();
+    const size_t vec_end = N - N % 32u;
+    __m256i total = zero;
+    size_t i = 0;
+
+    while(i < vec_end) {
+        const size_t block_end = std::min(vec_end, i + 32u * 255u);
+        __m256i acc = zero;
+        for(; i < block_end; i += 32) {
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            const __m256i m = _mm256_cmpeq_epi8(_mm256_max_epu8(d, T), d);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + i), m);
+            acc = _mm256_sub_epi8(acc, m);
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+    }
+
+    return size_t(horizontal_sum(total)) + scalar::threshold(a + i, mask + i, N - i, t);
+}
+
+template<RelativeOp op>
+CMN_TARGET("avx2") size_t count_relative(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold) {
+    const __m256i T = _mm256_set1_epi32(threshold);
+    const size_t vec_end = N - N % 16u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 16) {
+        __m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+        if constexpr(op != RelativeOp::none) {
+            const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + i)));
+            d = _mm256_sub_epi16(b, d);
+            if constexpr(op == RelativeOp::absolute)
+                d = _mm256_abs_epi16(d);
+        }
+
+        const __m256i t0 = _mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(relative + i)), T);
+        const __m256i t1 = _mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(relative + i + 8)), T);
+        /// packs works within 128-bit lanes, so we need to restore the order
+        const __m256i t = _mm256_permute4x64_epi64(_mm256_packs_epi32(t0, t1), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i below = _mm256_cmpgt_epi16(t, d);
+        count += 16u - size_t(std::popcount(uint32_t(_mm256_movemask_epi8(below)))) / 2u;
+    }
+
+    return count + scalar::count_relative<op>(op == RelativeOp::none ? bg : bg + i, v + i, relative + i, N - i, threshold);
+}
+
+}
+
+/**
+ * ===============================================
+ * AVX-512 (F + BW)
+ * ===============================================
+ */
+namespace avx512 {
+
+template<Op op>
+CMN_TARGET("avx512f,avx512bw") inline __m512i apply(const uchar* a, const uchar* b) {
+    const __m512i x = _mm512_loadu_si512(a);
+    if constexpr(op == Op::value) {
+        return x;
+    } else {
+        const __m512i y = _mm512_loadu_si512(b);
+        if constexpr(op == Op::subs)
+            return _mm512_subs_epu8(x, y);
+        else
+            return _mm512_or_si512(_mm512_subs_epu8(x, y), _mm512_subs_epu8(y, x));
+    }
+}
+
+template<Op op>
+CMN_TARGET("avx512f,avx512bw,popcnt") size_t count(const uchar* a, const uchar* b, size_t N, uint8_t t) {
+    const __m512i T = _mm512_set1_epi8(char(t));
+    const size_t vec_end = N - N % 64u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 64) {
+        const __m512i d = apply<op>(a + i, offset<op>(b, i));
+        count += size_t(std::popcount(uint64_t(_mm512_cmpge_epu8_mask(d, T))));
+    }
+
+    return count + scalar::count<op>(a + i, offset<op>(b, i), N - i, t);
+}
+
+template<Op op>
+CMN_TARGET("avx512f,avx512bw") void transform(const uchar* a, const uchar* b, uchar* output, size_t N) {
+    const size_t vec_end = N - N % 64u;
+    size_t i = 0;
+    for(; i < vec_end; i += 64) {
+        __m512i d;
+        if constexpr(op == Op::value)
+            d = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        else
+            d = apply<op>(a + i, b + i);
+        _mm512_storeu_si512(output + i, d);
+    }
+    scalar::transform<op>(a + i, b + i, output + i, N - i);
+}
+
+CMN_TARGET("avx512f,avx512bw,popcnt") size_t threshold(const uchar* a, uchar* mask, size_t N, uint8_t t) {
+    const __m512i T = _mm512_set1_epi8(char(t));
+    const size_t vec_end = N - N % 64u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 64) {
+        const __mmask64 m = _mm512_cmpge_epu8_mask(_mm512_loadu_si512(a + i), T);
+        _mm512_storeu_si512(mask + i, _mm512_movm_epi8(m));
+        count += size_t(std::popcount(uint64_t(m)));
+    }
+
+    return count + scalar::threshold(a + i, mask + i, N - i, t);
+}
+
+template<RelativeOp op>
+CMN_TARGET("avx512f,avx512bw,popcnt") size_t count_relative(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold) {
+    const __m512i T = _mm512_set1_epi32(threshold);
+    const size_t vec_end = N - N % 32u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 32) {
+        __m512i d = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+        if constexpr(op != RelativeOp::none) {
+            const __m512i b = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + i)));
+            d = _mm512_sub_epi16(b, d);
+            if constexpr(op == RelativeOp::absolute)
+                d = _mm512_abs_epi16(d);
+        }
+
+        const __m512i t0 = _mm512_mullo_epi32(_mm512_cvttps_epi32(_mm512_loadu_ps(relative + i)), T);
+        const __m512i t1 = _mm512_mullo_epi32(_mm512_cvttps_epi32(_mm512_loadu_ps(relative + i + 16)), T);
+        const __m512i t = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtsepi32_epi16(t0)), _mm512_cvtsepi32_epi16(t1), 1);
+        count += size_t(std::popcount(uint32_t(_mm512_cmpge_epi16_mask(d, t))));
+    }
+
+    return count + scalar::count_relative<op>(op == RelativeOp::none ? bg : bg + i, v + i, relative + i, N - i, threshold);
+}
+
+}
+
+struct CPUFeatures {
+    bool sse41{false}, avx2{false}, avx512{false};
+};
+
+const CPUFeatures& cpu_features() {
+    static const CPUFeatures features = [](){
+        CPUFeatures f;
+#if defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        const int max_leaf = info[0];
+
+        __cpuid(info, 1);
+        f.sse41 = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        const uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+
+        if(max_leaf >= 7) {
+            __cpuidex(info, 7, 0);
+            f.avx2 = avx && (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+            f.avx512 = (xcr0 & 0xE6) == 0xE6
+                && (info[1] & (1 << 16)) != 0   // AVX512F
+                && (info[1] & (1 << 30)) != 0;  // AVX512BW
+        }
+#else
+        __builtin_cpu_init();
+        f.sse41 = __builtin_cpu_supports("sse4.1");
+        f.avx2 = __builtin_cpu_supports("avx2");
+        f.avx512 = __builtin_cpu_supports("avx512f")
+                && __builtin_cpu_supports("avx512bw")
+                && __builtin_cpu_supports("popcnt");
+#endif
+        return f;
+    }();
+    return features;
+}
+
+#elif defined(CMN_KERNELS_NEON)
+/**
+ * ===============================================
+ * NEON
+ * ===============================================
+ */
+namespace neon {
+
+template<Op op>
+inline uint8x16_t apply(const uchar* a, const uchar* b) {
+    const uint8x16_t x = vld1q_u8(a);
+    if constexpr(op == Op::value) {
+        return x;
+    } else {
+        const uint8x16_t y = vld1q_u8(b);
+        if constexpr(op == Op::subs)
+            return vqsubq_u8(x, y);
+        else
+            return vabdq_u8(x, y);
+    }
+}
+
+template<Op op>
+size_t count(const uchar* a, const uchar* b, size_t N, uint8_t t) {
+    const uint8x16_t T = vdupq_n_u8(t);
+    const size_t vec_end = N - N % 16u;
+    size_t count = 0, i = 0;
+
+    while(i < vec_end) {
+        /// bytes of the accumulator overflow after 255 increments
+        const size_t block_end = std::min(vec_end, i + 16u * 255u);
+        uint8x16_t acc = vdupq_n_u8(0);
+        for(; i < block_end; i += 16) {
+            const uint8x16_t d = apply<op>(a + i, offset<op>(b, i));
+            acc = vsubq_u8(acc, vcgeq_u8(d, T));
+        }
+        count += vaddlvq_u8(acc);
+    }
+
+    return count + scalar::count<op>(a + i, offset<op>(b, i), N - i, t);
+}
+
+template<Op op>
+void transform(const uchar* a, const uchar* b, uchar* output, size_t N) {
+    const size_t vec_end = N - N % 16u;
+    size_t i = 0;
+    for(; i < vec_end; i += 16) {
+        uint8x16_t d;
+        if constexpr(op == Op::value)
+            d = vandq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        else
+            d = apply<op>(a + i, b + i);
+        vst1q_u8(output + i, d);
+    }
+    scalar::transform<op>(a + i, b + i, output + i, N - i);
+}
+
+size_t threshold(const uchar* a, uchar* mask, size_t N, uint8_t t) {
+    const uint8x16_t T = vdupq_n_u8(t);
+    const size_t vec_end = N - N % 16u;
+    size_t count = 0, i = 0;
+
+    while(i < vec_end) {
+        const size_t block_end = std::min(vec_end, i + 16u * 255u);
+        uint8x16_t acc = vdupq_n_u8(0);
+        for(; i < block_end; i += 16) {
+            const uint8x16_t m = vcgeq_u8(vld1q_u8(a + i), T);
+            vst1q_u8(mask + i, m);
+            acc = vsubq_u8(acc, m);
+        }
+        count += vaddlvq_u8(acc);
+    }
+
+    return count + scalar::threshold(a + i, mask + i, N - i, t);
+}
+
+template<RelativeOp op>
+size_t count_relative(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold) {
+    const size_t vec_end = N - N % 8u;
+    size_t count = 0, i = 0;
+
+    for(; i < vec_end; i += 8) {
+        int16x8_t d = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + i)));
+        if constexpr(op != RelativeOp::none) {
+            const int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(bg + i)));
+            d = vsubq_s16(b, d);
+            if constexpr(op == RelativeOp::absolute)
+                d = vabsq_s16(d);
+        }
+
+        /// vcvtq_s32_f32 truncates like a C++ cast does
+        const int32x4_t t0 = vmulq_n_s32(vcvtq_s32_f32(vld1q_f32(relative + i)), threshold);
+        const int32x4_t t1 = vmulq_n_s32(vcvtq_s32_f32(vld1q_f32(relative + i + 4)), threshold);
+        const uint16x8_t ge = vcgeq_s16(d, vcombine_s16(vqmovn_s32(t0), vqmovn_s32(t1)));
+        count += vaddvq_u16(vshrq_n_u16(ge, 15));
+    }
+
+    return count + scalar::count_relative<op>(op == RelativeOp::none ? bg : bg + i, v + i, relative + i, N - i, threshold);
+}
+
+}
+#endif
+
+/// builds a kernel table from the functions in one of the namespaces above
+#define CMN_DIFFERENCE_KERNELS(NS, ISA, NAME) DifferenceKernels { \
+    .isa = ISA, \
+    .name = NAME, \
+    .count_subs_ge = &NS::count<Op::subs>, \
+    .count_absdiff_ge = &NS::count<Op::absdiff>, \
+    .count_ge = [](const uchar* a, size_t N, uint8_t t) -> size_t { return NS::count<Op::value>(a, nullptr, N, t); }, \
+    .count_sign_relative = &NS::count_relative<RelativeOp::sign>, \
+    .count_absolute_relative = &NS::count_relative<RelativeOp::absolute>, \
+    .count_none_relative = [](const uchar* v, const float* relative, size_t N, int32_t threshold) -> size_t { return NS::count_relative<RelativeOp::none>(nullptr, v, relative, N, threshold); }, \
+    .subs = &NS::transform<Op::subs>, \
+    .absdiff = &NS::transform<Op::absdiff>, \
+    .threshold = &NS::threshold, \
+    .apply_mask = &NS::transform<Op::value> \
+}
+
+const DifferenceKernels scalar_kernels = CMN_DIFFERENCE_KERNELS(scalar, InstructionSet::scalar, "scalar");
+#if defined(CMN_KERNELS_X86)
+const DifferenceKernels sse41_kernels = CMN_DIFFERENCE_KERNELS(sse41, InstructionSet::sse41, "sse4.1");
+const DifferenceKernels avx2_kernels = CMN_DIFFERENCE_KERNELS(avx2, InstructionSet::avx2, "avx2");
+const DifferenceKernels avx512_kernels = CMN_DIFFERENCE_KERNELS(avx512, InstructionSet::avx512, "avx512");
+#elif defined(CMN_KERNELS_NEON)
+const DifferenceKernels neon_kernels = CMN_DIFFERENCE_KERNELS(neon, InstructionSet::neon, "neon");
+#endif
+
+#undef CMN_DIFFERENCE_KERNELS
+
+const DifferenceKernels& best_kernels() {
+    static const DifferenceKernels& best = []() -> const DifferenceKernels& {
+#if defined(CMN_KERNELS_X86)
+        if(cpu_features().avx512)
+            return avx512_kernels;
+        if(cpu_features().avx2)
+            return avx2_kernels;
+        if(cpu_features().sse41)
+            return sse41_kernels;
+#elif defined(CMN_KERNELS_NEON)
+        return neon_kernels;
+#endif
+        return scalar_kernels;
+    }();
+    return best;
+}
+
+}
+
+bool is_supported(InstructionSet isa) {
+    switch(isa) {
+        case InstructionSet::scalar:
+        case InstructionSet::best:
+            return true;
+#if defined(CMN_KERNELS_X86)
+        case InstructionSet::sse41:
+            return cpu_features().sse41;
+        case InstructionSet::avx2:
+            return cpu_features().avx2;
+        case InstructionSet::avx512:
+            return cpu_features().avx512;
+#elif defined(CMN_KERNELS_NEON)
+        case InstructionSet::neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const DifferenceKernels& difference_kernels(InstructionSet isa) {
+    if(not is_supported(isa))
+        throw InvalidArgumentException("Instruction set ", static_cast<int>(isa), " is not supported on this machine.");
+
+    switch(isa) {
+#if defined(CMN_KERNELS_X86)
+        case InstructionSet::sse41:
+            return sse41_kernels;
+        case InstructionSet::avx2:
+            return avx2_kernels;
+        case InstructionSet::avx512:
+            return avx512_kernels;
+#elif defined(CMN_KERNELS_NEON)
+        case InstructionSet::neon:
+            return neon_kernels;
+#endif
+        case InstructionSet::scalar:
+            return scalar_kernels;
+        default:
+            return best_kernels();
+    }
+}
+
+const std::array<uchar, 256>& r3g3b2_grey_table() {
+    static const std::array<uchar, 256> table = [](){
+        static constexpr InputInfo input{
+            .channels = 1u,
+            .encoding = meta_encoding_t::r3g3b2
+        };
+        static constexpr OutputInfo output{
+            .channels = 1u,
+            .encoding = meta_encoding_t::gray
+        };
+
+        std::array<uchar, 256> table;
+        for(size_t i = 0; i < table.size(); ++i) {
+            const uchar value = uchar(i);
+            table[i] = uchar(diffable_pixel_value<input, output>(&value));
+        }
+        return table;
+    }();
+    return table;
+}
+
+size_t count_above_threshold(DifferenceMethod method, const uchar* background, const uchar* values, size_t N, int32_t threshold, const DifferenceKernels& k) {
+    if(method == DifferenceMethod_t::none) {
+        if(threshold <= 0)
+            return N;
+        if(threshold > 255)
+            return 0;
+        return k.count_ge(values, N, uint8_t(threshold));
+    }
+
+    assert(background != nullptr);
+
+    if(method == DifferenceMethod_t::absolute) {
+        if(threshold <= 0)
+            return N;
+        if(threshold > 255)
+            return 0;
+        return k.count_absdiff_ge(background, values, N, uint8_t(threshold));
+    }
+
+    /// DifferenceMethod_t::sign counts int(bg) - int(v) >= threshold,
+    /// which (for threshold <= 0) is the same as *not* v - bg >= 1 - threshold
+    if(threshold > 255)
+        return 0;
+    if(threshold >= 1)
+        return k.count_subs_ge(background, values, N, uint8_t(threshold));
+    if(1 - threshold > 255)
+        return N;
+    return N - k.count_subs_ge(values, background, N, uint8_t(1 - threshold));
+}
+
+size_t count_above_threshold_r3g3b2(DifferenceMethod method, const uchar* background, const uchar* values, size_t N, int32_t threshold, const DifferenceKernels& k) {
+    static thread_local std::vector<uchar> grey;
+    grey.resize(N);
+
+    const auto& table = r3g3b2_grey_table();
+    for(size_t i = 0; i < N; ++i)
+        grey[i] = table[values[i]];
+
+    return count_above_threshold(method, background, grey.data(), N, threshold, k);
+}
+
+size_t count_above_threshold(DifferenceMethod method, const uchar* background, const uchar* values, const float* relative, size_t N, int32_t threshold, const DifferenceKernels& k) {
+    if(method == DifferenceMethod_t::none)
+        return k.count_none_relative(values, relative, N, threshold);
+
+    assert(background != nullptr);
+    if(method == DifferenceMethod_t::absolute)
+        return k.count_absolute_relative(background, values, relative, N, threshold);
+    return k.count_sign_relative(background, values, relative, N, threshold);
+}
+
+void difference(DifferenceMethod method, const uchar* background, const uchar* values, uchar* output, size_t N, const DifferenceKernels& k) {
+    if(method == DifferenceMethod_t::none) {
+        if(output != values)
+            std::memcpy(output, values, N);
+        return;
+    }
+
+    assert(background != nullptr);
+    if(method == DifferenceMethod_t::absolute)
+        k.absdiff(background, values, output, N);
+    else
+        k.subs(background, values, output, N);
+}
+
+size_t threshold(const uchar* values, uchar* mask, size_t N, int32_t threshold, const DifferenceKernels& k) {
+    if(threshold <= 0) {
+        std::memset(mask, 255, N);
+        return N;
+    }
+    if(threshold > 255) {
+        std::memset(mask, 0, N);
+        return 0;
+    }
+    return k.threshold(values, mask, N, uint8_t(threshold));
+}
+
+}
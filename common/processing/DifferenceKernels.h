@@ -0,0 +1,91 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <processing/encoding.h>
+
+namespace cmn::kernels {
+
+/**
+ * Instruction sets that the row kernels below are compiled for.
+ * `best` selects the fastest one supported by the current CPU.
+ */
+enum class InstructionSet {
+    scalar,
+    sse41,
+    avx2,
+    avx512,
+    neon,
+    best
+};
+
+/**
+ * Table of primitive row kernels for one instruction set. All of them
+ * work on rows of 8-bit (single channel) values and expect thresholds
+ * to be in [1, 255] - the wrappers below take care of all other cases.
+ */
+struct DifferenceKernels {
+    InstructionSet isa;
+    const char* name;
+
+    //! counts values where max(0, a - b) >= t
+    size_t (*count_subs_ge)(const uchar* a, const uchar* b, size_t N, uint8_t t);
+    //! counts values where |a - b| >= t
+    size_t (*count_absdiff_ge)(const uchar* a, const uchar* b, size_t N, uint8_t t);
+    //! counts values where a >= t
+    size_t (*count_ge)(const uchar* a, size_t N, uint8_t t);
+
+    //! counts values where int(bg) - int(v) >= int(relative) * threshold
+    size_t (*count_sign_relative)(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold);
+    //! counts values where |int(bg) - int(v)| >= int(relative) * threshold
+    size_t (*count_absolute_relative)(const uchar* bg, const uchar* v, const float* relative, size_t N, int32_t threshold);
+    //! counts values where int(v) >= int(relative) * threshold
+    size_t (*count_none_relative)(const uchar* v, const float* relative, size_t N, int32_t threshold);
+
+    //! output = max(0, a - b)
+    void (*subs)(const uchar* a, const uchar* b, uchar* output, size_t N);
+    //! output = |a - b|
+    void (*absdiff)(const uchar* a, const uchar* b, uchar* output, size_t N);
+    //! mask = a >= t ? 255 : 0, returns the number of set values
+    size_t (*threshold)(const uchar* a, uchar* mask, size_t N, uint8_t t);
+    //! output = a & mask
+    void (*apply_mask)(const uchar* a, const uchar* mask, uchar* output, size_t N);
+};
+
+//! Returns true if the given instruction set can be used on this machine.
+bool is_supported(InstructionSet isa);
+
+/**
+ * Returns the kernel table for the given instruction set (or the
+ * best supported one). Throws if the instruction set is not supported.
+ */
+const DifferenceKernels& difference_kernels(InstructionSet isa = InstructionSet::best);
+
+//! Lookup table converting r3g3b2 values to greyscale (same as diffable_pixel_value).
+const std::array<uchar, 256>& r3g3b2_grey_table();
+
+/**
+ * Counts pixels of a row that are different from the background by at least
+ * `threshold` - the same as Background::count_above_threshold does for
+ * greyscale input. `background` may be nullptr for DifferenceMethod_t::none.
+ */
+size_t count_above_threshold(DifferenceMethod method, const uchar* background, const uchar* values, size_t N, int32_t threshold, const DifferenceKernels& k = difference_kernels());
+
+//! Same as above, but the input values are r3g3b2 encoded.
+size_t count_above_threshold_r3g3b2(DifferenceMethod method, const uchar* background, const uchar* values, size_t N, int32_t threshold, const DifferenceKernels& k = difference_kernels());
+
+/**
+ * Same as above, but every pixel has its own threshold of
+ * int(relative[i]) * threshold (e.g. LuminanceGrid::thresholds()).
+ */
+size_t count_above_threshold(DifferenceMethod method, const uchar* background, const uchar* values, const float* relative, size_t N, int32_t threshold, const DifferenceKernels& k = difference_kernels());
+
+/**
+ * Writes the difference image of a row (Background::diff for greyscale values).
+ * For DifferenceMethod_t::none this copies the values.
+ */
+void difference(DifferenceMethod method, const uchar* background, const uchar* values, uchar* output, size_t N, const DifferenceKernels& k = difference_kernels());
+
+//! mask = values >= threshold ? 255 : 0, returns the number of set values.
+size_t threshold(const uchar* values, uchar* mask, size_t N, int32_t threshold, const DifferenceKernels& k = difference_kernels());
+
+}
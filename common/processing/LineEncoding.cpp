@@ -0,0 +1,305 @@
+#include "LineEncoding.h"
+#include <processing/PVBlob.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CMN_LINES_SSE2
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define CMN_LINES_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace pv::line_encoding {
+
+using namespace cmn;
+
+namespace {
+
+void write_varint(std::vector<uint8_t>& output, uint32_t value) {
+    while(value >= 0x80u) {
+        output.push_back(uint8_t(value | 0x80u));
+        value >>= 7;
+    }
+    output.push_back(uint8_t(value));
+}
+
+uint32_t read_varint(const uint8_t*& ptr, const uint8_t* end) {
+    uint32_t value = 0;
+    for(uint32_t shift = 0; shift < 35; shift += 7) {
+        if(ptr == end)
+            throw U_EXCEPTION("Line data is truncated.");
+        const uint8_t byte = *ptr++;
+        value |= uint32_t(byte & 0x7Fu) << shift;
+        if(not (byte & 0x80u))
+            return value;
+    }
+    throw U_EXCEPTION("Invalid varint in line data.");
+}
+
+constexpr uint32_t zigzag(int32_t value) {
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+constexpr int32_t unzigzag(uint32_t value) {
+    return int32_t(value >> 1) ^ -int32_t(value & 1u);
+}
+
+struct Header {
+    LineFormat format;
+    size_t num_lines;
+    uint16_t start_y;
+    //! first byte after the header
+    const uint8_t* body;
+    const uint8_t* end;
+};
+
+Header read_header(std::span<const uint8_t> data) {
+    if(data.empty())
+        throw U_EXCEPTION("Line data is empty.");
+
+    Header header;
+    header.format = format(data);
+    header.end = data.data() + data.size();
+    header.body = data.data() + 1;
+    header.num_lines = read_varint(header.body, header.end);
+    header.start_y = narrow_cast<uint16_t>(read_varint(header.body, header.end));
+
+    const size_t needed = header.format == LineFormat::short_lines
+        ? header.num_lines * sizeof(ShortHorizontalLine)
+        : (header.num_lines + 7u) / 8u;
+    if(size_t(header.end - header.body) < needed)
+        throw U_EXCEPTION("Line data is truncated (", header.num_lines, " lines, ", header.end - header.body, " bytes).");
+    return header;
+}
+
+/**
+ * Sets bit i of mask if line i is the last one in its row (and not the
+ * last line overall). mask has to be zeroed.
+ */
+void eol_mask(std::span<const HorizontalLine> lines, uint8_t* mask) {
+    const size_t N = lines.size();
+    size_t i = 0;
+
+    // the next line's y is needed for the last line of a block
+#if defined(CMN_LINES_SSE2)
+    static_assert(sizeof(HorizontalLine) == sizeof(uint64_t));
+    const __m128i low_words = _mm_set1_epi32(0xFFFF);
+    for(; i + 8u < N; i += 8u) {
+        auto ptr = reinterpret_cast<const __m128i*>(lines.data() + i);
+
+        /// every register holds two lines (x0, x1, y, padding), so
+        /// dwords 1 and 3 are (y, padding)
+        auto ys = [&](int k) {
+            return _mm_shuffle_epi32(_mm_loadu_si128(ptr + k), _MM_SHUFFLE(2, 0, 3, 1));
+        };
+        const __m128i y0 = _mm_and_si128(_mm_unpacklo_epi64(ys(0), ys(1)), low_words);
+        const __m128i y1 = _mm_and_si128(_mm_unpacklo_epi64(ys(2), ys(3)), low_words);
+        const __m128i next = _mm_set1_epi32(lines[i + 8u].y);
+
+        const __m128i n0 = _mm_or_si128(_mm_srli_si128(y0, 4), _mm_slli_si128(y1, 12));
+        const __m128i n1 = _mm_or_si128(_mm_srli_si128(y1, 4), _mm_slli_si128(next, 12));
+
+        const int same = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(y0, n0)))
+                      | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(y1, n1))) << 4);
+        mask[i / 8u] = uint8_t(~same);
+    }
+#elif defined(CMN_LINES_NEON)
+    static constexpr uint16_t bit_values[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint16x8_t bits = vld1q_u16(bit_values);
+    for(; i + 8u < N; i += 8u) {
+        const uint16x8x4_t data = vld4q_u16(reinterpret_cast<const uint16_t*>(lines.data() + i));
+        const uint16x8_t next = vextq_u16(data.val[2], vdupq_n_u16(lines[i + 8u].y), 1);
+        const uint16x8_t changed = vmvnq_u16(vceqq_u16(data.val[2], next));
+        mask[i / 8u] = uint8_t(vaddvq_u16(vandq_u16(changed, bits)));
+    }
+#endif
+
+    for(; i + 1u < N; ++i) {
+        if(lines[i].y != lines[i + 1u].y)
+            mask[i / 8u] |= uint8_t(1u << (i % 8u));
+    }
+}
+
+/**
+ * Returns true if the next 2 * 8 bytes at ptr are all single byte
+ * varints (that is the case for almost all lines of normal blobs).
+ */
+inline bool single_bytes(const uint8_t* ptr) {
+#if defined(CMN_LINES_SSE2)
+    return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr))) == 0;
+#elif defined(CMN_LINES_NEON)
+    return vmaxvq_u8(vld1q_u8(ptr)) < 0x80u;
+#else
+    uint64_t a, b;
+    std::memcpy(&a, ptr, sizeof(a));
+    std::memcpy(&b, ptr + sizeof(a), sizeof(b));
+    return ((a | b) & 0x8080808080808080ull) == 0;
+#endif
+}
+
+//! Reconstructs lines from (zigzag x0 delta, length) pairs.
+class LineBuilder {
+    const uint8_t* _mask;
+    HorizontalLine* _output;
+    size_t _index{0};
+    int32_t _y;
+    int32_t _row_x0{0}, _previous_x1{0};
+
+public:
+    LineBuilder(const uint8_t* mask, HorizontalLine* output, uint16_t start_y)
+        : _mask(mask), _output(output), _y(start_y)
+    {}
+
+    size_t index() const { return _index; }
+
+    void push(uint32_t delta, uint32_t length) {
+        int32_t reference = _previous_x1;
+        const bool new_row = _index == 0
+            || ((_mask[(_index - 1u) / 8u] >> ((_index - 1u) % 8u)) & 1u);
+        if(new_row) {
+            reference = _row_x0;
+            if(_index > 0)
+                ++_y;
+        }
+
+        const int32_t x0 = reference + unzigzag(delta);
+        const int32_t x1 = x0 + int32_t(length);
+        if(new_row)
+            _row_x0 = x0;
+        _previous_x1 = x1;
+
+        _output[_index++] = HorizontalLine(coord_t(_y), coord_t(x0), coord_t(x1));
+    }
+};
+
+}
+
+void encode(std::span<const HorizontalLine> lines, std::vector<uint8_t>& output) {
+    const size_t N = lines.size();
+    output.reserve(output.size() + 16u + (N + 7u) / 8u + N * 2u);
+    output.push_back(uint8_t(LineFormat::delta_varint));
+    write_varint(output, narrow_cast<uint32_t>(N));
+    write_varint(output, N > 0 ? lines.front().y : 0u);
+    if(N == 0)
+        return;
+
+    const size_t mask_offset = output.size();
+    output.resize(output.size() + (N + 7u) / 8u, 0);
+    eol_mask(lines, output.data() + mask_offset);
+
+    int32_t row_x0 = 0, previous_x1 = 0;
+    for(size_t i = 0; i < N; ++i) {
+        auto& line = lines[i];
+        assert(line.x1 >= line.x0);
+
+        const bool new_row = i == 0 || lines[i - 1u].y != line.y;
+        assert(i == 0 || line.y == lines[i - 1u].y || line.y == lines[i - 1u].y + 1u);
+
+        const int32_t reference = new_row ? row_x0 : previous_x1;
+        if(new_row)
+            row_x0 = line.x0;
+        previous_x1 = line.x1;
+
+        const uint32_t delta = zigzag(int32_t(line.x0) - reference);
+        const uint32_t length = uint32_t(line.x1 - line.x0);
+        if((delta | length) < 0x80u) {
+            output.push_back(uint8_t(delta));
+            output.push_back(uint8_t(length));
+        } else {
+            write_varint(output, delta);
+            write_varint(output, length);
+        }
+    }
+}
+
+void encode(std::span<const ShortHorizontalLine> lines, uint16_t start_y, std::vector<uint8_t>& output) {
+    output.push_back(uint8_t(LineFormat::short_lines));
+    write_varint(output, narrow_cast<uint32_t>(lines.size()));
+    write_varint(output, start_y);
+
+    const size_t offset = output.size();
+    output.resize(offset + lines.size_bytes());
+    if(not lines.empty())
+        std::memcpy(output.data() + offset, lines.data(), lines.size_bytes());
+}
+
+LineFormat format(std::span<const uint8_t> data) {
+    if(data.empty())
+        throw U_EXCEPTION("Line data is empty.");
+
+    switch(data.front()) {
+        case uint8_t(LineFormat::short_lines):
+            return LineFormat::short_lines;
+        case uint8_t(LineFormat::delta_varint):
+            return LineFormat::delta_varint;
+        default:
+            throw U_EXCEPTION("Unknown line format ", int(data.front()), ".");
+    }
+}
+
+size_t num_lines(std::span<const uint8_t> data) {
+    return read_header(data).num_lines;
+}
+
+uint16_t start_y(std::span<const uint8_t> data) {
+    return read_header(data).start_y;
+}
+
+HorizontalLine first_line(std::span<const uint8_t> data) {
+    auto header = read_header(data);
+    if(header.num_lines == 0)
+        throw U_EXCEPTION("There are no lines.");
+
+    if(header.format == LineFormat::short_lines) {
+        ShortHorizontalLine line;
+        std::memcpy(&line, header.body, sizeof(line));
+        return HorizontalLine(header.start_y, line.x0(), line.x1());
+    }
+
+    auto ptr = header.body + (header.num_lines + 7u) / 8u;
+    const auto delta = read_varint(ptr, header.end);
+    const auto length = read_varint(ptr, header.end);
+
+    HorizontalLine line;
+    LineBuilder(header.body, &line, header.start_y).push(delta, length);
+    return line;
+}
+
+void decode(std::span<const uint8_t> data, std::vector<HorizontalLine>& output) {
+    auto header = read_header(data);
+
+    if(header.format == LineFormat::short_lines) {
+        std::vector<ShortHorizontalLine> lines(header.num_lines);
+        if(not lines.empty())
+            std::memcpy(lines.data(), header.body, header.num_lines * sizeof(ShortHorizontalLine));
+        ShortHorizontalLine::uncompress(output, header.start_y, lines);
+        return;
+    }
+
+    const size_t N = header.num_lines;
+    output.resize(N);
+
+    const uint8_t* mask = header.body;
+    const uint8_t* ptr = mask + (N + 7u) / 8u;
+    const uint8_t* end = header.end;
+    LineBuilder builder(mask, output.data(), header.start_y);
+
+    while(builder.index() < N) {
+        /// blocks of 8 lines with 1 byte per value need no varint decoding
+        if(builder.index() + 8u <= N
+           && end - ptr >= 16
+           && single_bytes(ptr))
+        {
+            for(size_t j = 0; j < 8u; ++j)
+                builder.push(ptr[j * 2u], ptr[j * 2u + 1u]);
+            ptr += 16;
+            continue;
+        }
+
+        const auto delta = read_varint(ptr, end);
+        const auto length = read_varint(ptr, end);
+        builder.push(delta, length);
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <commons.pc.h>
+
+namespace pv {
+
+struct ShortHorizontalLine;
+
+/**
+ * Formats that lines of a CompressedBlob can be stored in. Encoded line
+ * arrays start with this value as a tag byte, so the values must never
+ * change - new formats get new values, and old ones can always be read.
+ */
+enum class LineFormat : uint8_t {
+    //! 4 bytes per line (x0, x1 | eol), see ShortHorizontalLine
+    short_lines = 1,
+    /**
+     * About 2 bytes per line: one eol bit per line (bitmask in front of
+     * the lines), then per line the x0 delta (zigzag varint) and x1 - x0
+     * (varint). x0 is relative to x1 of the previous line in the same row,
+     * or to x0 of the first line of the previous row for the first line
+     * of a row.
+     */
+    delta_varint = 2
+};
+
+namespace line_encoding {
+
+/**
+ * Appends lines in the delta_varint format (including the tag byte) to
+ * output. Lines have to be sorted by y, then x, and - same as for
+ * ShortHorizontalLine - every row between the first and the last line
+ * has to contain at least one line.
+ */
+void encode(std::span<const cmn::HorizontalLine> lines, std::vector<uint8_t>& output);
+
+//! Appends lines in the short_lines format (including the tag byte) to output.
+void encode(std::span<const ShortHorizontalLine> lines, uint16_t start_y, std::vector<uint8_t>& output);
+
+//! Format of the given encoded lines. Throws for unknown tags.
+LineFormat format(std::span<const uint8_t> data);
+
+//! Number of lines in data (only reads the header).
+size_t num_lines(std::span<const uint8_t> data);
+
+//! y of the first line in data (only reads the header).
+uint16_t start_y(std::span<const uint8_t> data);
+
+//! First line in data, without decoding the others. data must not be empty.
+cmn::HorizontalLine first_line(std::span<const uint8_t> data);
+
+/**
+ * Replaces the contents of output with the lines encoded in data, in
+ * any of the LineFormats. Throws if data is truncated.
+ */
+void decode(std::span<const uint8_t> data, std::vector<cmn::HorizontalLine>& output);
+
+}
+
+}
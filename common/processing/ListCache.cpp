@@ -11,7 +11,13 @@ ListCache_t::ListCache_t()
 }
 
 ListCache_t::~ListCache_t() {
+    for(auto band : bands)
+        delete band;
     delete obj;
 }
 
+Source& ListCache_t::source() {
+    return obj->source();
+}
+
 }
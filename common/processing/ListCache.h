@@ -1,14 +1,44 @@
 #pragma once
 
+#include <commons.pc.h>
+
 namespace cmn {
 namespace CPULabeling {
 
 class DLList;
+struct Source;
+
+/**
+ * Algorithms that can be used to find connected components:
+ *  - brototypes: merges lines row by row into Brototypes (the default)
+ *  - union_find: run-length union-find with path compression over all
+ *    lines, which does not degrade for U-shaped or noisy components.
+ *    Blobs are the same, but sorted by their first line.
+ */
+ENUM_CLASS(labeling_backend_t, brototypes, union_find);
+using LabelingBackend = labeling_backend_t::Class;
 
+//! Keeps labeling lists (and with them, their arenas) alive between runs.
 struct ListCache_t {
     DLList* obj{ nullptr };
+    
+    //! per-band lists used by run_tiled, grown on demand
+    std::vector<DLList*> bands;
+    
+    //! algorithm used by run(..., ListCache_t&, ...)
+    LabelingBackend backend{labeling_backend_t::brototypes};
+    
+    //! scratch space of the union_find backend, reused between runs
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> counts;
+    std::vector<HorizontalLine*> line_cursors;
+    std::vector<uchar*> pixel_cursors;
+    
     ListCache_t();
     ~ListCache_t();
+    
+    //! lines that are labeled by run(ListCache_t&, ...)
+    Source& source();
 };
 
 }
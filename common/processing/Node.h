@@ -89,41 +89,17 @@ public:
     };*/
     
 public:
-    using Ref = std::unique_ptr<Node>;
     using Ptr = Node*;
     Node::Ptr prev = nullptr;
     Node::Ptr next = nullptr;
-    std::unique_ptr<Brototype> obj;
+    //! lives in the Arena of the parent list
+    Brototype* obj = nullptr;
     
-    template<class... Args>
-    static Ref make(Args... args) {
-        return std::make_unique<Node>(std::forward<Args>(args)...);
-    }
-    
-    static auto& mutex() {
-        static std::mutex _mutex;
-        return _mutex;
-    }
-    
-#if defined(DEBUG_MEM)
-    static auto& created_nodes() {
-        static std::unordered_set<void*> _created_nodes;
-        return _created_nodes;
-    }
-#endif
-    static std::vector<Node::Ref>& pool() {
-        static std::vector<Node::Ref> p;
-        return p;
-    }
-    
-    static void move_to_cache(Node::Ref& node);
     static void move_to_cache(Node::Ptr node);
     
-    Node(std::unique_ptr<Brototype>&& obj, DLList* parent);
+    Node(Brototype* obj, DLList* parent);
     void init(DLList* parent);
     void invalidate();
-    
-    ~Node();
 };
 
 using List_t = DLList;
@@ -3,6 +3,8 @@
 #include <misc/Timer.h>
 #include <misc/create_struct.h>
 #include <misc/ThreadPool.h>
+#include <processing/DifferenceKernels.h>
+#include <processing/RunMoments.h>
 
 #if defined(USE_NEON)
     #include <arm_neon.h>
@@ -113,104 +115,12 @@ void Blob::calculate_moments() {
         return;
     
     assert(_properties.ready);
-
-    static GenericThreadPool pool(8, "moments_pool");
-    const uint32_t num_threads = _hor_lines->size() > 1000 ? min(narrow_cast<uint32_t>(_hor_lines->size()), 4u) : 1;
-    // Create a vector of _moments copies for each thread
-    std::vector<Moments> thread_moments(num_threads, Moments{});
-
-    // Parallel processing of the first loop
-    //fn(i, it, nex, conditional_conversion<4, size_t, int64_t, Iterator, Iterator, size_t>::template convert<std::remove_cvref_t<F>>(j));
-    distribute_indexes([&](auto, auto start, auto end, int64_t thread_index) {
-        Moments& local_moments = thread_moments.at(thread_index);
-        assert(thread_index < num_threads);
-    
-        for(auto it = start; it != end; ++it) {
-            auto& h = *it;
-            const uint my = h.y;
-            const uint mysq = my * my;
-            
-            int mx = h.x0;
-            
-            for (int x = h.x0; x <= h.x1; x++, mx++) {
-                const uint mxsq = mx * mx;
-                
-                local_moments.m[0][0] += 1;
-                local_moments.m[0][1] += 1 * my;
-                local_moments.m[1][0] += mx * 1;
-                local_moments.m[1][1] += mx * my;
-                
-                local_moments.m[2][0] += mxsq;
-                local_moments.m[0][2] += mysq;
-                local_moments.m[2][1] += mxsq * my;
-                local_moments.m[1][2] += mx * mysq;
-                local_moments.m[2][2] += mxsq * mysq;
-            }
-        }
-    }, pool, _hor_lines->begin(), _hor_lines->end(), num_threads);
     
-    // Merge thread-local moments into the main _moments structure
-    for (const auto& local_moments : thread_moments) {
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                _moments.m[i][j] += local_moments.m[i][j];
-            }
-        }
-    }
-
-    _properties.center = Vec2(_moments.m[1][0] / _moments.m[0][0],
-                              _moments.m[0][1] / _moments.m[0][0]);
+    /// closed form per line, so this is O(#lines) - see RunMoments
+    _moments = RunMoments::calculate(*_hor_lines, &_properties.center, &_properties.angle);
     
     assert(not cmn::isnan(_properties.center.x)
            && not cmn::isnan(_properties.center.y));
-
-    // Parallel processing of the second loop
-    distribute_indexes([&](auto, auto start, auto end, int64_t thread_index) {
-        Moments& local_moments = thread_moments[thread_index];
-
-        for(auto it = start; it != end; ++it) {
-            auto& h = *it;
-            const int vy = (h.y) - _properties.center.y;
-            const int vy2 = vy * vy;
-            
-            int vx = (h.x0) - _properties.center.x;
-            
-            for (int x = h.x0; x <= h.x1; x++, vx++) {
-                const auto vx2 = vx * vx;
-                
-                local_moments.mu[0][0] += 1;
-                local_moments.mu[0][1] += 1 * vy;
-                local_moments.mu[0][2] += 1 * vy2;
-                
-                local_moments.mu[1][0] += vx * 1;
-                local_moments.mu[1][1] += float(vx) * float(vy);
-                local_moments.mu[1][2] += float(vx) * float(vy2);
-                
-                local_moments.mu[2][0] += vx2 * 1;
-                local_moments.mu[2][1] += float(vx2) * float(vy);
-                local_moments.mu[2][2] += float(vx2) * float(vy2);
-            }
-        }
-    }, pool, _hor_lines->data(), _hor_lines->data() + _hor_lines->size(), num_threads);
-
-    // Merge thread-local moments into the main _moments structure
-    for (const auto& local_moments : thread_moments) {
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                _moments.mu[i][j] += local_moments.mu[i][j];
-            }
-        }
-    }
-
-    float mu00_inv = 1.0f / float(_moments.mu[0][0]);
-    for (int i = 0; i<3; i++) {
-        for (int j = 0; j<3; j++) {
-            _moments.mu_[i][j] = _moments.mu[i][j] * mu00_inv;
-        }
-    }
-
-    _properties.angle = 0.5 * cmn::fast_atan2(2 * _moments.mu_[1][1], _moments.mu_[2][0] - _moments.mu_[0][2]);
-    _moments.ready = true;
 }
 
 void Blob::calculate_properties() {
@@ -255,7 +165,135 @@ bool Blob::operator==(const pv::Blob& other) const {
     return blob_id() == other.blob_id();
 }
 
+uint64_t CompressedBlob::num_pixels() const {
+    if(line_format() == LineFormat::delta_varint) {
+        std::vector<HorizontalLine> lines;
+        uncompress_lines(lines);
+        
+        uint64_t result = lines.size();
+        for(auto &line : lines)
+            result += line.x1 - line.x0;
+        return result;
+    }
+    
+    // adding +1 to result for each line (in order to include x1 as part of the total count)
+    uint64_t result = _lines.size();
+        
+    // adding all line lengths
+    for(auto &line : _lines)
+        result += line.x1() - line.x0();
+        
+    return result;
+}
+
+void CompressedBlob::compact() {
+    if(line_format() == LineFormat::delta_varint || _lines.empty())
+        return;
+    
+    std::vector<HorizontalLine> lines;
+    ShortHorizontalLine::uncompress(lines, start_y, _lines);
+    line_encoding::encode(lines, _encoded_lines);
+    _encoded_lines.shrink_to_fit();
+    
+    _lines.clear();
+    _lines.shrink_to_fit();
+}
+
+void CompressedBlob::encode_lines(std::vector<uint8_t>& output) const {
+    if(line_format() == LineFormat::delta_varint)
+        output.insert(output.end(), _encoded_lines.begin(), _encoded_lines.end());
+    else
+        line_encoding::encode(_lines, start_y, output);
+}
+
+void CompressedBlob::decode_lines(std::span<const uint8_t> data) {
+    _lines.clear();
+    _encoded_lines.clear();
+    start_y = line_encoding::start_y(data);
+    
+    if(line_encoding::format(data) == LineFormat::delta_varint) {
+        if(line_encoding::num_lines(data) > 0)
+            _encoded_lines.assign(data.begin(), data.end());
+        return;
+    }
+    
+    std::vector<HorizontalLine> lines;
+    line_encoding::decode(data, lines);
+    _lines = ShortHorizontalLine::compress(lines);
+}
+
+const std::vector<ShortHorizontalLine>& CompressedBlob::lines() const {
+    if(line_format() == LineFormat::delta_varint)
+        throw U_EXCEPTION("Lines of blob ", own_id, " are stored compact(), use uncompress_lines() or encode_lines() to read them.");
+    return _lines;
+}
+
+void CompressedBlob::set_lines(std::vector<ShortHorizontalLine>&& lines) {
+    _encoded_lines.clear();
+    _lines = std::move(lines);
+}
+
+size_t CompressedBlob::lines_memory() const {
+    return _lines.capacity() * sizeof(ShortHorizontalLine)
+        + _encoded_lines.capacity();
+}
+
+uint64_t CompressedBlob::write_lines(cmn::Data& data) const {
+    std::vector<uint8_t> buffer;
+    encode_lines(buffer);
+    
+    const uint64_t pos = data.write<uint32_t>(narrow_cast<uint32_t>(buffer.size()));
+    data.write_data(buffer.size(), (const char*)buffer.data());
+    return pos;
+}
+
+void CompressedBlob::read_lines(cmn::Data& data) {
+    uint32_t size;
+    data.read<uint32_t>(size);
+    
+    std::vector<uint8_t> buffer(size);
+    if(data.read_data(size, (char*)buffer.data()) != size)
+        throw U_EXCEPTION("Cannot read ", size, " bytes of lines for blob ", own_id, ".");
+    
+    /// the tag tells which LineFormat the lines were written in
+    decode_lines(buffer);
+}
+
+void CompressedBlob::uncompress_lines(std::vector<HorizontalLine>& output) const {
+    if(line_format() == LineFormat::delta_varint)
+        line_encoding::decode(_encoded_lines, output);
+    else
+        ShortHorizontalLine::uncompress(output, start_y, _lines);
+}
+
+size_t CompressedBlob::num_lines() const {
+    if(line_format() == LineFormat::delta_varint)
+        return line_encoding::num_lines(_encoded_lines);
+    return _lines.size();
+}
+
+HorizontalLine CompressedBlob::first_line() const {
+    if(line_format() == LineFormat::delta_varint)
+        return line_encoding::first_line(_encoded_lines);
+    
+    assert(not _lines.empty());
+    return HorizontalLine(start_y, _lines.front().x0(), _lines.front().x1());
+}
+
 cmn::Bounds CompressedBlob::calculate_bounds() const {
+    if(line_format() == LineFormat::delta_varint) {
+        std::vector<HorizontalLine> lines;
+        uncompress_lines(lines);
+        
+        int max_x = 0, min_x = lines.empty() ? 0 : infinity<int>();
+        for(auto &line : lines) {
+            if(line.x1 > max_x) max_x = line.x1;
+            if(line.x0 < min_x) min_x = line.x0;
+        }
+        const int height = lines.empty() ? 0 : lines.back().y - start_y;
+        return cmn::Bounds(min_x, start_y, max_x - min_x + 1, height + 1);
+    }
+    
     int max_x = 0, height = 0, min_x = _lines.empty() ? 0 : infinity<int>();
     int x0, x1;
     for(auto &line : _lines) {
@@ -271,7 +309,7 @@ cmn::Bounds CompressedBlob::calculate_bounds() const {
 
 pv::BlobPtr CompressedBlob::unpack() const {
     auto flines = pv::buffers().get(source_location::current());
-    ShortHorizontalLine::uncompress(*flines, start_y, _lines);
+    uncompress_lines(*flines);
     
     auto ptr = pv::Blob::Make(std::move(flines), nullptr, 0, blob::Prediction{pred});
     ptr->set_parent_id((status_byte & 0x2) != 0 ? parent_id : pv::bid::invalid);
@@ -411,6 +449,23 @@ pv::BlobPtr CompressedBlob::unpack() const {
 #endif*/
     }
 
+    namespace {
+    
+    //! scalar version, also used for the tails of the vectorized ones. returns the y after the last line.
+    inline uint16_t uncompress_lines(HorizontalLine* uptr, uint16_t y, const uint32_t* cptr, size_t N) noexcept {
+        for(auto end = cptr + N; cptr != end; ++cptr, ++uptr) {
+            const uint32_t data = *cptr;
+            uptr->y = y;
+            uptr->x0 = uint16_t(data & 0xFFFF);
+            uptr->x1 = uint16_t((data >> 16) & 0x7FFF);
+            uptr->padding = 0;
+            if (data & 0x80000000) y++;
+        }
+        return y;
+    }
+    
+    }
+
 #ifdef USE_NEON
     __attribute__((target("neon"))) // NEON is required for vld1q_u32
     //__attribute__((noinline))
@@ -530,56 +585,90 @@ pv::BlobPtr CompressedBlob::unpack() const {
 #elif defined(USE_SSE)
 
 #if defined(_MSC_VER)
-    bool check_cpu_features() {
-        int cpuInfo[4] = {};
-        __cpuid(cpuInfo, 0);
+    #define PV_TARGET(ISA)
+#else
+    #define PV_TARGET(ISA) __attribute__((target(ISA)))
+#endif
 
-        if (cpuInfo[0] >= 7) {
-            __cpuidex(cpuInfo, 7, 0);
-            return (cpuInfo[1] & (1 << 16)) != 0;  // Check for AVX-512F support
+    namespace {
+
+    static_assert(sizeof(ShortHorizontalLine) == 4, "ShortHorizontalLine is not 4 bytes");
+    static_assert(sizeof(HorizontalLine) == sizeof(uint64_t), "HorizontalLine is not 8 bytes");
+
+    /**
+     * The y coordinate of every line is start_y plus the number of eol bits
+     * before it, i.e. an exclusive prefix sum over the eol bits. Within a
+     * vector that takes log2(lanes) shift+add steps, and the running y stays
+     * in a register as well. Lines are then written as (x0 | x1 << 16) and
+     * (y | padding << 16) - one 64-bit HorizontalLine per 32-bit input.
+     * All of them return the y after the last line.
+     */
+    PV_TARGET("sse4.1") uint16_t uncompress_sse41(HorizontalLine* uptr, uint16_t start_y, const uint32_t* cptr, size_t N) noexcept {
+        const __m128i x_mask = _mm_set1_epi32(0x7FFFFFFF);
+        const __m128i y_mask = _mm_set1_epi32(0xFFFF);
+        __m128i y = _mm_set1_epi32(start_y);
+
+        size_t i = 0;
+        for(; i + 4 <= N; i += 4) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cptr + i));
+            const __m128i eol = _mm_srli_epi32(data, 31);
+
+            // inclusive prefix sum of the eol bits
+            __m128i sum = _mm_add_epi32(eol, _mm_slli_si128(eol, 4));
+            sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+
+            const __m128i ys = _mm_and_si128(_mm_add_epi32(y, _mm_sub_epi32(sum, eol)), y_mask);
+            const __m128i X = _mm_and_si128(data, x_mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(uptr + i), _mm_unpacklo_epi32(X, ys));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(uptr + i + 2), _mm_unpackhi_epi32(X, ys));
+
+            y = _mm_add_epi32(y, _mm_shuffle_epi32(sum, 0xFF));
         }
 
-        return false;
+        return uncompress_lines(uptr + i, uint16_t(_mm_cvtsi128_si32(y)), cptr + i, N - i);
     }
-    static bool use_avx512f = check_cpu_features();
-#endif
 
-#if !defined(_MSC_VER)
-    __attribute__((target("avx512f"))) // AVX512F is required for _mm512_setr_epi64
-#endif
-    void ShortHorizontalLine::uncompress(
-            std::vector<cmn::HorizontalLine>& result,
-            uint16_t start_y,
-            const std::vector<ShortHorizontalLine>& compressed) 
-        noexcept // Assuming compressed is a vector of uint32_t
-    {
-#if defined(_MSC_VER)
-        if (not use_avx512f) {
-            static std::once_flag print_flag;
-            std::call_once(print_flag, []() {
-                std::cout << "[AVX512] Using fallback instruction set." << std::endl;
-            });
-            uncompress_normal(result, start_y, compressed);
-            return;
+    PV_TARGET("avx2") uint16_t uncompress_avx2(HorizontalLine* uptr, uint16_t start_y, const uint32_t* cptr, size_t N) noexcept {
+        const __m256i x_mask = _mm256_set1_epi32(0x7FFFFFFF);
+        const __m256i y_mask = _mm256_set1_epi32(0xFFFF);
+        const __m256i last = _mm256_set1_epi32(7);
+        __m256i y = _mm256_set1_epi32(start_y);
+
+        size_t i = 0;
+        for(; i + 8 <= N; i += 8) {
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cptr + i));
+            const __m256i eol = _mm256_srli_epi32(data, 31);
+
+            // inclusive prefix sum within both 128-bit halves...
+            __m256i sum = _mm256_add_epi32(eol, _mm256_slli_si256(eol, 4));
+            sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+            // ...plus the total of the lower half added to the upper half
+            const __m256i carry = _mm256_shuffle_epi32(sum, 0xFF);
+            sum = _mm256_add_epi32(sum, _mm256_permute2x128_si256(carry, carry, 0x08));
+
+            const __m256i ys = _mm256_and_si256(_mm256_add_epi32(y, _mm256_sub_epi32(sum, eol)), y_mask);
+            const __m256i X = _mm256_and_si256(data, x_mask);
+
+            // unpack works within halves: lo = lines 0,1,4,5 and hi = lines 2,3,6,7
+            const __m256i lo = _mm256_unpacklo_epi32(X, ys);
+            const __m256i hi = _mm256_unpackhi_epi32(X, ys);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(uptr + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(uptr + i + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+
+            y = _mm256_add_epi32(y, _mm256_permutevar8x32_epi32(sum, last));
         }
-#endif
 
-        result.resize(compressed.size());
-
-        auto y = start_y;
-        auto uptr = result.data();
-        auto cptr = reinterpret_cast<const __m256i*>(compressed.data());
-        auto end = reinterpret_cast<const __m256i*>(compressed.data() + compressed.size() - compressed.size() % 8u); // Processing 4 elements per loop with 256-bit vectors
+        return uncompress_lines(uptr + i, uint16_t(_mm_cvtsi128_si32(_mm256_castsi256_si128(y))), cptr + i, N - i);
+    }
 
+    PV_TARGET("avx512f") uint16_t uncompress_avx512(HorizontalLine* uptr, uint16_t y, const uint32_t* cptr, size_t N) noexcept {
         const __m256i x_mask = _mm256_set1_epi32(0x7FFFFFFF);
         const __m256i eol_mask = _mm256_set1_epi32(0x80000000);
         const __m512i zeros = _mm512_setzero_si512();
 
-        static_assert(sizeof(ShortHorizontalLine) == 4, "ShortHorizontalLine is not 4 bytes");
-        static_assert(sizeof(HorizontalLine) == sizeof(uint64_t), "HorizontalLine is not 8 bytes");
-
-        for (; cptr < end; ++cptr, uptr += 8) {
-            __m256i data_vec = _mm256_loadu_si256(cptr);
+        size_t i = 0;
+        for (; i + 8 <= N; i += 8, uptr += 8) {
+            __m256i data_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cptr + i));
 
             // Extract x0 and x1, interleave with zeros to 512 bits
             __m256i X = _mm256_and_si256(data_vec, x_mask);
@@ -615,16 +704,78 @@ pv::BlobPtr CompressedBlob::unpack() const {
         }
 
         // Process the remaining elements (if any)
-        auto remaining_ptr = reinterpret_cast<const uint32_t*>(cptr);
-        for (auto remaining_end = remaining_ptr + (compressed.size() % 8); remaining_ptr < remaining_end; ++remaining_ptr, ++uptr) {
-            uint32_t data = *remaining_ptr;
-            uptr->y = y;
-            uptr->x0 = uint16_t(data & 0xFFFF);
-            uptr->x1 = uint16_t((data >> 16) & 0x7FFF);
-            if (data & 0x80000000) y++;
+        return uncompress_lines(uptr, y, cptr + i, N - i);
+    }
+
+    }
+
+#if defined(_MSC_VER)
+    void ShortHorizontalLine::uncompress(
+            std::vector<cmn::HorizontalLine>& result,
+            uint16_t start_y,
+            const std::vector<ShortHorizontalLine>& compressed)
+        noexcept
+    {
+        using kernels::InstructionSet;
+        static const auto isa = []() {
+            for(auto isa : { InstructionSet::avx512, InstructionSet::avx2, InstructionSet::sse41 }) {
+                if(kernels::is_supported(isa))
+                    return isa;
+            }
+            std::cout << "[SSE] Using fallback instruction set." << std::endl;
+            return InstructionSet::scalar;
+        }();
+
+        result.resize(compressed.size());
+        auto cptr = reinterpret_cast<const uint32_t*>(compressed.data());
+        switch(isa) {
+            case InstructionSet::avx512:
+                uncompress_avx512(result.data(), start_y, cptr, compressed.size());
+                break;
+            case InstructionSet::avx2:
+                uncompress_avx2(result.data(), start_y, cptr, compressed.size());
+                break;
+            case InstructionSet::sse41:
+                uncompress_sse41(result.data(), start_y, cptr, compressed.size());
+                break;
+            default:
+                uncompress_lines(result.data(), start_y, cptr, compressed.size());
+                break;
         }
     }
 
+#else
+    __attribute__((target("avx512f")))
+    void ShortHorizontalLine::uncompress(
+            std::vector<cmn::HorizontalLine>& result,
+            uint16_t start_y,
+            const std::vector<ShortHorizontalLine>& compressed) noexcept
+    {
+        result.resize(compressed.size());
+        uncompress_avx512(result.data(), start_y, reinterpret_cast<const uint32_t*>(compressed.data()), compressed.size());
+    }
+
+    __attribute__((target("avx2")))
+    void ShortHorizontalLine::uncompress(
+            std::vector<cmn::HorizontalLine>& result,
+            uint16_t start_y,
+            const std::vector<ShortHorizontalLine>& compressed) noexcept
+    {
+        result.resize(compressed.size());
+        uncompress_avx2(result.data(), start_y, reinterpret_cast<const uint32_t*>(compressed.data()), compressed.size());
+    }
+
+    __attribute__((target("sse4.1")))
+    void ShortHorizontalLine::uncompress(
+            std::vector<cmn::HorizontalLine>& result,
+            uint16_t start_y,
+            const std::vector<ShortHorizontalLine>& compressed) noexcept
+    {
+        result.resize(compressed.size());
+        uncompress_sse41(result.data(), start_y, reinterpret_cast<const uint32_t*>(compressed.data()), compressed.size());
+    }
+#endif
+
 #endif
 
 #if defined(USE_NEON) || defined(_MSC_VER)
@@ -643,18 +794,49 @@ pv::BlobPtr CompressedBlob::unpack() const {
 #endif
     {
         _result.resize(compressed.size());
-        
-        auto y = start_y;
-        auto uptr = _result.data();
-        auto cptr = compressed.data(), end = compressed.data()+compressed.size();
-        
-        for(; cptr != end; cptr++, uptr++) {
-            uptr->y = y;
-            uptr->x0 = cptr->x0();
-            uptr->x1 = cptr->x1();
-            
-            if(cptr->eol())
-                y++;
+        uncompress_lines(_result.data(), start_y, reinterpret_cast<const uint32_t*>(compressed.data()), compressed.size());
+    }
+
+    void ShortHorizontalLine::uncompress_with(
+            kernels::InstructionSet isa,
+            std::vector<cmn::HorizontalLine>& result,
+            uint16_t start_y,
+            const std::vector<ShortHorizontalLine>& compressed)
+    {
+        using kernels::InstructionSet;
+        if(isa == InstructionSet::best) {
+            uncompress(result, start_y, compressed);
+            return;
+        }
+        if(not kernels::is_supported(isa))
+            throw InvalidArgumentException("Instruction set ", static_cast<int>(isa), " is not supported on this machine.");
+
+        result.resize(compressed.size());
+        auto uptr = result.data();
+        auto cptr = reinterpret_cast<const uint32_t*>(compressed.data());
+        const size_t N = compressed.size();
+
+        switch(isa) {
+            case InstructionSet::scalar:
+                uncompress_lines(uptr, start_y, cptr, N);
+                break;
+#if defined(USE_SSE)
+            case InstructionSet::sse41:
+                uncompress_sse41(uptr, start_y, cptr, N);
+                break;
+            case InstructionSet::avx2:
+                uncompress_avx2(uptr, start_y, cptr, N);
+                break;
+            case InstructionSet::avx512:
+                uncompress_avx512(uptr, start_y, cptr, N);
+                break;
+#elif defined(USE_NEON)
+            case InstructionSet::neon:
+                uncompress(result, start_y, compressed);
+                break;
+#endif
+            default:
+                throw InvalidArgumentException("Instruction set ", static_cast<int>(isa), " is not available in this build.");
         }
     }
     
@@ -8,6 +8,7 @@
 #include <misc/bid.h>
 #include <processing/ProximityGrid.h>
 #include <processing/BlobIdentity.h>
+#include <processing/LineEncoding.h>
 #include <file/DataFormat.h>
 #include <misc/Buffers.h>
 
@@ -22,6 +23,10 @@ namespace Output {
     class ResultsFormat;
 }
 
+namespace cmn::kernels {
+    enum class InstructionSet;
+}
+
 namespace pv {
 
 struct LineMaker {
@@ -309,6 +314,8 @@ public:
     // if SSE is enabled and its not MSVC
 #if defined(USE_SSE) && !defined(_MSC_VER)
     __attribute__((target("avx512f"))) static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
+    __attribute__((target("avx2"))) static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
+    __attribute__((target("sse4.1"))) static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
     __attribute__((target("default"))) static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
 #else
     static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
@@ -317,6 +324,8 @@ public:
 #else
     static void uncompress(std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed) noexcept;
 #endif
+    //! same as uncompress, but with the given instruction set (e.g. for benchmarks). throws if it is not available.
+    static void uncompress_with(cmn::kernels::InstructionSet isa, std::vector<cmn::HorizontalLine>& _result, uint16_t start_y, const std::vector<ShortHorizontalLine>& compressed);
     
 public:
     constexpr ShortHorizontalLine() : _x0(0), _x1(0) {}
@@ -351,14 +360,21 @@ struct CompressedBlob {
     cmn::blob::Prediction pred;
     
 protected:
-    GETTER(std::vector<ShortHorizontalLine>, lines);
+    /// Lines are stored in exactly one of the two formats. The friends below
+    /// read _lines directly, which is only valid for line_format() ==
+    /// short_lines (everything that is not compact()ed). Everything else
+    /// should go through the accessors, which handle both formats.
+    //! lines in the short_lines format (empty if the blob is compact())
+    std::vector<ShortHorizontalLine> _lines;
+    //! lines in the delta_varint format, including the tag (empty unless compact())
+    GETTER(std::vector<uint8_t>, encoded_lines);
     
     friend struct MemoryStats;
     friend class Output::ResultsFormat;
 
 public:
     CompressedBlob() = default;
-    CompressedBlob(const pv::Blob& val) :
+    CompressedBlob(const pv::Blob& val, LineFormat format = LineFormat::short_lines) :
         parent_id(val.parent_id()),
         own_id(val.blob_id()),
         pred(val.prediction())
@@ -371,9 +387,45 @@ public:
                     | (uint8_t(val.is_rgb()) << 5)
                     | (uint8_t(val.is_r3g3b2()) << 6)
                     | (uint8_t(val.is_binary()) << 7);
-        _lines = ShortHorizontalLine::compress(val.hor_lines());
         start_y = val.lines()->empty() ? 0 : val.lines()->front().y;
+        if(format == LineFormat::delta_varint)
+            line_encoding::encode(val.hor_lines(), _encoded_lines);
+        else
+            _lines = ShortHorizontalLine::compress(val.hor_lines());
+    }
+    
+    LineFormat line_format() const {
+        return _encoded_lines.empty() ? LineFormat::short_lines : LineFormat::delta_varint;
     }
+    
+    //! Converts lines to the (about twice as dense) delta_varint format.
+    void compact();
+    
+    /**
+     * Lines in the short_lines format. Throws if the blob is compact(),
+     * use uncompress_lines() / encode_lines() for those.
+     */
+    const std::vector<ShortHorizontalLine>& lines() const;
+    //! Replaces lines with lines in the short_lines format (relative to start_y).
+    void set_lines(std::vector<ShortHorizontalLine>&& lines);
+    //! Number of bytes allocated for lines (in either format).
+    size_t lines_memory() const;
+    
+    //! Writes lines, tagged with their LineFormat, to data (see read_lines).
+    uint64_t write_lines(cmn::Data& data) const;
+    //! Reads lines written by write_lines (in any LineFormat), replacing start_y.
+    void read_lines(cmn::Data& data);
+    
+    //! Appends lines to output in the current format, tagged with it.
+    void encode_lines(std::vector<uint8_t>& output) const;
+    //! Replaces lines (and start_y) with data in any LineFormat.
+    void decode_lines(std::span<const uint8_t> data);
+    //! Uncompresses lines, regardless of the format they are stored in.
+    void uncompress_lines(std::vector<cmn::HorizontalLine>& output) const;
+    
+    size_t num_lines() const;
+    //! First line (the blob must not be empty).
+    cmn::HorizontalLine first_line() const;
         
     bool split() const { return status_byte & 0x1; }
     bool is_tag() const { return (status_byte >> 3) & 1u; }
@@ -384,16 +436,7 @@ public:
     cmn::Bounds calculate_bounds() const;
         
     pv::BlobPtr unpack() const;
-    uint64_t num_pixels() const {
-        // adding +1 to result for each line (in order to include x1 as part of the total count)
-        uint64_t result = _lines.size();
-            
-        // adding all line lengths
-        for(auto &line : _lines)
-            result += line.x1() - line.x0();
-            
-        return result;
-    }
+    uint64_t num_pixels() const;
         
     constexpr const bid& blob_id() const {
         return own_id;
@@ -6,6 +6,7 @@
 #include <misc/ranges.h>
 #include <misc/Image.h>
 #include <processing/PVBlob.h>
+#include <processing/RunContours.h>
 
 //#define DEBUG_TREE_WALK
 //#define DEBUG_EDGES
@@ -495,6 +496,13 @@ std::vector<pv::BlobPtr> threshold_blob(CPULabeling::ListCache_t& cache, pv::Blo
     }
     
     std::vector<std::unique_ptr<std::vector<Vec2>>> find_outer_points(pv::BlobWeakPtr blob, int)
+    {
+        static thread_local RunContours contours;
+        contours.trace(blob->hor_lines(), true);
+        return contours.to_vectors();
+    }
+    
+    std::vector<std::unique_ptr<std::vector<Vec2>>> find_outer_points_tree(pv::BlobWeakPtr blob, int)
     {
         if(blob->hor_lines().empty())
             return {};
@@ -152,7 +152,10 @@ namespace cmn::pixel {
         std::unique_ptr<std::vector<Vec2>> walk(Subnode* node);
     };
     
+    //! Outlines of all objects and holes in the blob (see RunContours).
     std::vector<std::unique_ptr<std::vector<Vec2>>> find_outer_points(pv::BlobWeakPtr blob, int threshold);
+    //! The same outlines, built from a pixel::Tree of all border pixels (slower, kept for comparison).
+    std::vector<std::unique_ptr<std::vector<Vec2>>> find_outer_points_tree(pv::BlobWeakPtr blob, int threshold);
 
     pv::BlobPtr threshold_get_biggest_blob(pv::BlobWeakPtr blob, int threshold, const cmn::Background* bg, uint8_t use_closing = 0, uint8_t closing_size = 2, CPULabeling::ListCache_t&& = CPULabeling::ListCache_t{});
     //std::vector<pv::BlobPtr> threshold_blob(pv::BlobWeakPtr blob, int threshold, const cmn::Background* bg, const Rangel& size_range = Rangel(-1, -1));
@@ -142,5 +142,214 @@ fdx_pos ProximityGrid::query(float, float) const {
     return pv::bid::invalid;
 }
 
+DenseProximityGrid::DenseProximityGrid() noexcept
+    : _scale(1.0f, 1.0f),
+      _resolution(0, 0),
+      _n(0)
+{}
+
+DenseProximityGrid::DenseProximityGrid(const Size2& resolution, int r)
+    : DenseProximityGrid()
+{
+    set_resolution(resolution, r != -1 ? r : proximity_res);
+}
+
+void DenseProximityGrid::set_resolution(const Size2& resolution, uint n) {
+    /// same cell layout as Grid2D
+    _scale = Vec2(ceilf(resolution.max() / float(n)), ceilf(resolution.max() / float(n)));
+    _resolution = Size2(resolution.max(), resolution.max());
+    _n = n;
+    _offsets.assign(size_t(n) * size_t(n) + 1u, 0u);
+    _xs.clear();
+    _ys.clear();
+    _ids.clear();
+    _staged.clear();
+}
+
+void DenseProximityGrid::clear() {
+    std::fill(_offsets.begin(), _offsets.end(), 0u);
+    _xs.clear();
+    _ys.clear();
+    _ids.clear();
+    _staged.clear();
+}
+
+void DenseProximityGrid::insert(float x, float y, fdx_pos v) {
+    _staged.emplace_back(x, y, v);
+}
+
+std::tuple<int, int> DenseProximityGrid::cell_coordinates(const Vec2& point) const {
+    return {
+        (int)cmn::max(0.f, floorf(min(_resolution.width - 1, point.x) / _scale.x)),
+        (int)cmn::max(0.f, floorf(min(_resolution.height - 1, point.y) / _scale.y))
+    };
+}
+
+uint32_t DenseProximityGrid::cell(float x, float y) const {
+    auto [cx, cy] = cell_coordinates(Vec2(x, y));
+    return uint32_t(cx) + uint32_t(cy) * _n;
+}
+
+void DenseProximityGrid::build() {
+    const size_t N = size_t(_n) * size_t(_n);
+    assert(_offsets.size() == N + 1);
+    
+    /// counting sort of all staged points by their cell
+    std::fill(_offsets.begin(), _offsets.end(), 0u);
+    for(auto &p : _staged)
+        ++_offsets[cell(p.x, p.y) + 1];
+    for(size_t i = 1; i <= N; ++i)
+        _offsets[i] += _offsets[i - 1];
+    
+    _cursor.assign(_offsets.begin(), _offsets.end() - 1);
+    _xs.resize(_staged.size());
+    _ys.resize(_staged.size());
+    _ids.resize(_staged.size());
+    
+    for(auto &p : _staged) {
+        const uint32_t i = _cursor[cell(p.x, p.y)]++;
+        _xs[i] = p.x;
+        _ys[i] = p.y;
+        _ids[i] = p.v;
+    }
+    
+    _staged.clear();
+}
+
+void DenseProximityGrid::collect(uint32_t cell, const Vec2& point, float max_sqd, std::vector<result_t>& results) const {
+    const uint32_t end = _offsets[cell + 1];
+    for(uint32_t i = _offsets[cell]; i < end; ++i) {
+        const float dx = _xs[i] - point.x, dy = _ys[i] - point.y;
+        const float d = dx * dx + dy * dy;
+        if(d < max_sqd)
+            results.emplace_back(d, _ids[i]);
+    }
+}
+
+size_t DenseProximityGrid::deduplicate(std::vector<result_t>& results, size_t start) {
+    /// keep only the closest entry per id
+    const auto first = results.begin() + start;
+    std::sort(first, results.end(), [](const result_t& A, const result_t& B) {
+        return std::get<1>(A) < std::get<1>(B)
+            || (std::get<1>(A) == std::get<1>(B) && std::get<0>(A) < std::get<0>(B));
+    });
+    const auto last = std::unique(first, results.end(), [](const result_t& A, const result_t& B) {
+        return std::get<1>(A) == std::get<1>(B);
+    });
+    results.erase(last, results.end());
+    return results.size() - start;
+}
+
+void DenseProximityGrid::query(std::span<const Vec2> points, float max_d, Results& output) const {
+    output.clear();
+    output.offsets.push_back(0);
+    
+    if(_n == 0) {
+        output.offsets.resize(points.size() + 1u, 0u);
+        return;
+    }
+    
+    const float max_sqd = max_d * max_d;
+    const int last = int(_n) - 1;
+    const int max_cells = std::isfinite(max_d)
+        ? min(last, (int)ceilf(max_d / _scale.max()))
+        : last;
+    
+    for(auto &point : points) {
+        const size_t start = output.results.size();
+        auto [cx, cy] = cell_coordinates(point);
+        
+        const int x0 = max(0, cx - max_cells), x1 = min(last, cx + max_cells);
+        const int y0 = max(0, cy - max_cells), y1 = min(last, cy + max_cells);
+        
+        for(int y = y0; y <= y1; ++y) {
+            for(int x = x0; x <= x1; ++x)
+                collect(uint32_t(x) + uint32_t(y) * _n, point, max_sqd, output.results);
+        }
+        
+        deduplicate(output.results, start);
+        for(auto it = output.results.begin() + start; it != output.results.end(); ++it)
+            std::get<0>(*it) = sqrtf(std::get<0>(*it));
+        
+        output.offsets.push_back(uint32_t(output.results.size()));
+    }
+}
+
+void DenseProximityGrid::query_nearest(std::span<const Vec2> points, size_t k, float max_d, Results& output) const {
+    output.clear();
+    output.offsets.push_back(0);
+    
+    if(_n == 0 || k == 0) {
+        output.offsets.resize(points.size() + 1u, 0u);
+        return;
+    }
+    
+    const float max_sqd = max_d * max_d;
+    const int last = int(_n) - 1;
+    const int max_ring = std::isfinite(max_d)
+        ? min(last, (int)ceilf(max_d / _scale.max()))
+        : last;
+    
+    auto by_distance = [](const result_t& A, const result_t& B) {
+        return std::get<0>(A) < std::get<0>(B);
+    };
+    
+    for(auto &point : points) {
+        const size_t start = output.results.size();
+        auto [cx, cy] = cell_coordinates(point);
+        
+        /// visit rings of cells around the center cell until the k-th
+        /// closest id is closer than anything outside of the visited block
+        for(int r = 0; r <= max_ring; ++r) {
+            const int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+            
+            for(int y = max(0, y0); y <= min(last, y1); ++y) {
+                if(y == y0 || y == y1) {
+                    for(int x = max(0, x0); x <= min(last, x1); ++x)
+                        collect(uint32_t(x) + uint32_t(y) * _n, point, max_sqd, output.results);
+                } else {
+                    if(x0 >= 0)
+                        collect(uint32_t(x0) + uint32_t(y) * _n, point, max_sqd, output.results);
+                    if(x1 <= last && x1 != x0)
+                        collect(uint32_t(x1) + uint32_t(y) * _n, point, max_sqd, output.results);
+                }
+            }
+            
+            /// the whole grid has been visited
+            if(x0 <= 0 && y0 <= 0 && x1 >= last && y1 >= last)
+                break;
+            
+            if(output.results.size() - start < k
+               || deduplicate(output.results, start) < k)
+            {
+                continue;
+            }
+            
+            /// distance to the closest cell that has not been visited yet
+            /// (sides that touch the border of the grid have none)
+            float bound = std::numeric_limits<float>::infinity();
+            if(x0 > 0) bound = min(bound, point.x - float(x0) * _scale.x);
+            if(x1 < last) bound = min(bound, float(x1 + 1) * _scale.x - point.x);
+            if(y0 > 0) bound = min(bound, point.y - float(y0) * _scale.y);
+            if(y1 < last) bound = min(bound, float(y1 + 1) * _scale.y - point.y);
+            
+            auto kth = output.results.begin() + start + (k - 1);
+            std::nth_element(output.results.begin() + start, kth, output.results.end(), by_distance);
+            if(bound > 0 && std::get<0>(*kth) <= bound * bound)
+                break;
+        }
+        
+        const size_t found = min(k, deduplicate(output.results, start));
+        const auto first = output.results.begin() + start;
+        std::partial_sort(first, first + found, output.results.end(), by_distance);
+        output.results.erase(first + found, output.results.end());
+        
+        for(auto it = first; it != output.results.end(); ++it)
+            std::get<0>(*it) = sqrtf(std::get<0>(*it));
+        
+        output.offsets.push_back(uint32_t(output.results.size()));
+    }
+}
+
 }
 }
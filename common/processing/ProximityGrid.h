@@ -44,5 +44,79 @@ private:
     virtual fdx_pos query(float, float) const override;
 };
 
+/**
+ * Same grid layout as ProximityGrid, but all points are stored in flat
+ * arrays sorted by cell (offsets + x / y / id, CSR style). It is meant
+ * to be rebuilt every frame: insert() all points, then build() once.
+ * Queries are batched and write into caller-owned Results, so there are
+ * no heap allocations once the buffers have grown large enough.
+ */
+class DenseProximityGrid {
+public:
+    using result_t = ProximityGrid::result_t;
+    
+    //! Results of a batched query. Query i owns results[offsets[i], offsets[i+1]).
+    struct Results {
+        std::vector<result_t> results;
+        std::vector<uint32_t> offsets;
+        
+        size_t size() const { return offsets.empty() ? 0u : offsets.size() - 1u; }
+        std::span<const result_t> operator[](size_t i) const {
+            assert(i + 1 < offsets.size());
+            return std::span<const result_t>(results.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        void clear() {
+            results.clear();
+            offsets.clear();
+        }
+    };
+    
+    GETTER(Vec2, scale);
+    GETTER(Size2, resolution);
+    GETTER(uint, n);
+    
+private:
+    std::vector<uint32_t> _offsets;
+    std::vector<float> _xs, _ys;
+    std::vector<fdx_pos> _ids;
+    std::vector<pixel<fdx_pos>> _staged;
+    std::vector<uint32_t> _cursor;
+    
+public:
+    DenseProximityGrid() noexcept;
+    DenseProximityGrid(const Size2& resolution, int r = -1);
+    
+    void set_resolution(const Size2& resolution, uint n);
+    
+    //! Removes all points (keeps the allocated memory).
+    void clear();
+    //! Stages a point, it will be searchable after the next build().
+    void insert(float x, float y, fdx_pos v);
+    //! Sorts all staged points into cells.
+    void build();
+    
+    size_t size() const { return _ids.size(); }
+    bool empty() const { return _ids.empty(); }
+    
+    /**
+     * For every point, finds all ids with a distance < max_d. Like
+     * ProximityGrid::query, every id is reported once with its
+     * smallest distance. Results within a query are in no specific order.
+     */
+    void query(std::span<const Vec2> points, float max_d, Results& output) const;
+    
+    /**
+     * For every point, finds the (up to) k closest ids with a distance
+     * < max_d, sorted by distance.
+     */
+    void query_nearest(std::span<const Vec2> points, size_t k, float max_d, Results& output) const;
+    
+private:
+    uint32_t cell(float x, float y) const;
+    std::tuple<int, int> cell_coordinates(const Vec2& point) const;
+    void collect(uint32_t cell, const Vec2& point, float max_sqd, std::vector<result_t>& results) const;
+    static size_t deduplicate(std::vector<result_t>& results, size_t start);
+};
+
 }
 }
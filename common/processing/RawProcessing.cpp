@@ -1,12 +1,17 @@
 #include "RawProcessing.h"
 #include "CPULabeling.h"
+#include <processing/DLList.h>
+#include <processing/Source.h>
 #include "misc/GlobalSettings.h"
+#include <misc/SettingHandle.h>
 #include "misc/Timer.h"
+#include <misc/Trace.h>
 #include <misc/ocl.h>
 #include <processing/LuminanceGrid.h>
 #include <misc/ranges.h>
 #include <processing/PadImage.h>
 #include <misc/ThreadPool.h>
+#include <misc/WorkStealingPool.h>
 #include <misc/colors.h>
 #include <processing/PVBlob.h>
 #include <gui/DrawCVBase.h>
@@ -34,6 +39,258 @@ public:
     }
 };
 
+#ifndef USE_GPU_MAT
+namespace {
+
+//! Settings relevant to generate_binary_fused.
+struct FusedParameters {
+    bool invert;
+    bool difference;
+    bool absolute;
+    int threshold;
+    int threshold_maximum;
+    //! dilate + erode with this element (if set)
+    const cv::Mat* closing_element;
+    //! dilate with this element afterwards (if set)
+    const cv::Mat* dilation_element;
+};
+
+//! Per-thread buffers of generate_binary_fused, reused between tiles.
+struct FusedBuffers {
+    cv::Mat grey, mask, tmp;
+};
+
+/**
+ * Writes the thresholded difference of a range of rows into mask. Every
+ * step does exactly what the corresponding OpenCV call in generate_binary
+ * does (subtract / absdiff saturate, threshold is >, inRange is [lo, hi]).
+ */
+template<bool invert, bool difference, bool absolute>
+void threshold_rows(const cv::Mat& grey, const cv::Mat& average, int y0, const FusedParameters& p, cv::Mat& mask) {
+    const bool in_range = p.threshold_maximum < 255;
+    const int lower = in_range ? p.threshold : abs(p.threshold) + 1;
+    const int upper = in_range ? p.threshold_maximum : 255;
+    const uchar off = p.threshold < 0 ? 255 : 0;
+    const int cols = grey.cols;
+    
+    for(int r = 0; r < mask.rows; ++r) {
+        const uchar* g = grey.ptr<uchar>(r);
+        const uchar* a = average.ptr<uchar>(y0 + r);
+        uchar* m = mask.ptr<uchar>(r);
+        
+        for(int x = 0; x < cols; ++x) {
+            int v = g[x];
+            if constexpr(invert)
+                v = 255 - v;
+            if constexpr(difference) {
+                if constexpr(absolute)
+                    v = std::abs(v - int(a[x]));
+                else
+                    v = max(0, int(a[x]) - v);
+            }
+            m[x] = uchar((v >= lower && v <= upper) ? ~off : off);
+        }
+    }
+}
+
+//! Rows above and below a mask row that all morphological operations together depend on.
+struct FusedHalo {
+    int above{0}, below{0};
+    
+    explicit FusedHalo(const FusedParameters& p) {
+        /// dilate / erode with the default anchor (the center) read
+        /// rows [y - anchor, y + rows - 1 - anchor], and every step of
+        /// the chain reads the result of the one before
+        const auto add = [this](const cv::Mat& element, int times) {
+            const int anchor = element.rows / 2;
+            above += times * anchor;
+            below += times * (element.rows - 1 - anchor);
+        };
+        if(p.closing_element)
+            add(*p.closing_element, 2);
+        if(p.dilation_element)
+            add(*p.dilation_element, 1);
+    }
+    
+    int rows() const { return above + below; }
+};
+
+/**
+ * Computes the binary mask for rows [y0, y1) of input. Morphological
+ * operations need rows above and below to be correct, so the mask
+ * is computed for rows [*e0, e1) including the halo (clamped to the image).
+ */
+void fused_mask(const cv::Mat& input, const cv::Mat& average, const FusedParameters& p, int y0, int y1, int* e0, FusedBuffers& buffers) {
+    const FusedHalo halo(p);
+    *e0 = max(0, y0 - halo.above);
+    const int e1 = min(input.rows, y1 + halo.below);
+    
+    cv::Mat grey;
+    if(input.channels() == 3) {
+        cv::cvtColor(input.rowRange(*e0, e1), buffers.grey, cv::COLOR_BGR2GRAY);
+        grey = buffers.grey;
+    } else
+        grey = input.rowRange(*e0, e1);
+    
+    buffers.mask.create(e1 - *e0, input.cols, CV_8UC1);
+    
+    using threshold_t = void(*)(const cv::Mat&, const cv::Mat&, int, const FusedParameters&, cv::Mat&);
+    static constexpr std::array<threshold_t, 8> functions{
+        &threshold_rows<false, false, false>, &threshold_rows<false, false, true>,
+        &threshold_rows<false, true, false>,  &threshold_rows<false, true, true>,
+        &threshold_rows<true, false, false>,  &threshold_rows<true, false, true>,
+        &threshold_rows<true, true, false>,   &threshold_rows<true, true, true>
+    };
+    functions[size_t(p.invert) * 4u + size_t(p.difference) * 2u + size_t(p.absolute)](grey, average, *e0, p, buffers.mask);
+    
+    if(p.closing_element) {
+        cv::dilate(buffers.mask, buffers.tmp, *p.closing_element);
+        cv::erode(buffers.tmp, buffers.mask, *p.closing_element);
+    }
+    if(p.dilation_element) {
+        cv::dilate(buffers.mask, buffers.tmp, *p.dilation_element);
+        std::swap(buffers.mask, buffers.tmp);
+    }
+}
+
+WorkStealingPool& binary_pool() {
+    static WorkStealingPool pool(max(1u, cmn::hardware_concurrency()), "binary_pool");
+    return pool;
+}
+
+/**
+ * Number of rows per tile, so that every tile has ~256kb of input. Tiles
+ * are at least four times as high as the halo, so that not much more than
+ * a quarter of the rows is thresholded and filtered twice.
+ */
+int fused_tile_rows(const cv::Mat& input, const FusedParameters& p) {
+    static constexpr size_t tile_bytes = 256u * 1024u;
+    const int rows = int(tile_bytes / max(size_t(1), size_t(input.cols) * size_t(input.channels())));
+    return max(16, rows, 4 * FusedHalo(p).rows());
+}
+
+/**
+ * Computes the binary mask of input tile by tile (in parallel) and calls
+ * fn(tile, y, mask_row) for every row of every tile while its mask is still
+ * in the cache.
+ */
+template<typename F>
+void for_each_fused_row(const cv::Mat& input, const cv::Mat& average, const FusedParameters& p, F&& fn) {
+    assert(input.type() == CV_8UC1 || input.type() == CV_8UC3);
+    assert(average.type() == CV_8UC1 && average.size() == input.size());
+    
+    const int tile_rows = fused_tile_rows(input, p);
+    const int tiles = (input.rows + tile_rows - 1) / tile_rows;
+    
+    distribute_indexes_dynamic([&](auto, int start, int end, auto) {
+        static thread_local FusedBuffers buffers;
+        
+        for(int tile = start; tile < end; ++tile) {
+            const int y0 = tile * tile_rows;
+            const int y1 = min(input.rows, y0 + tile_rows);
+            
+            int e0;
+            fused_mask(input, average, p, y0, y1, &e0, buffers);
+            
+            for(int y = y0; y < y1; ++y)
+                fn(tile, y, buffers.mask.ptr<uchar>(y - e0));
+        }
+        
+    }, binary_pool(), 0, tiles);
+}
+
+/**
+ * Same as the OpenCV path of generate_binary for the given parameters,
+ * but working on tiles of rows that fit into the cache: every tile goes
+ * from input to the masked output at once, and tiles are processed in
+ * parallel.
+ */
+void generate_binary_fused(const cv::Mat& input, const cv::Mat& average, const FusedParameters& p, cv::Mat& output) {
+    output.create(input.rows, input.cols, input.type());
+    const int channels = input.channels();
+    
+    // use the mask on the original input (cv::bitwise_and / cv::merge)
+    for_each_fused_row(input, average, p, [&](int, int y, const uchar* m) {
+        const uchar* in = input.ptr<uchar>(y);
+        uchar* out = output.ptr<uchar>(y);
+        
+        if(channels == 3) {
+            for(int x = 0; x < input.cols; ++x) {
+                out[x * 3 + 0] = in[x * 3 + 0] & m[x];
+                out[x * 3 + 1] = in[x * 3 + 1] & m[x];
+                out[x * 3 + 2] = in[x * 3 + 2] & m[x];
+            }
+        } else {
+            for(int x = 0; x < input.cols; ++x)
+                out[x] = in[x] & m[x];
+        }
+    });
+}
+
+/**
+ * Same as generate_binary_fused followed by Source::init on the output,
+ * but lines are extracted from the mask directly. A pixel is part of a
+ * line if it is set in the mask and any of its channels in input is
+ * non-zero (= non-zero in the masked output). Pixel pointers point into
+ * input, which has the same values as the masked output for those pixels.
+ */
+void generate_lines_fused(const cv::Mat& input, const cv::Mat& average, const FusedParameters& p, CPULabeling::Source& source) {
+    using namespace CPULabeling;
+    
+    // lines of every tile, appended in order once all tiles are done. one
+    // set per calling thread, so the buffers are reused for the next frame.
+    // workers have to go through the reference, since naming tile_sources
+    // inside them would refer to their own (empty) thread_local.
+    static thread_local std::vector<Source> tile_sources;
+    auto& tiles = tile_sources;
+    const int tile_rows = fused_tile_rows(input, p);
+    tiles.resize(size_t((input.rows + tile_rows - 1) / tile_rows));
+    for(auto& tile : tiles)
+        tile.clear();
+    
+    const int channels = input.channels();
+    const size_t step_px = size_t(channels);
+    
+    for_each_fused_row(input, average, p, [&](int tile, int y, const uchar* m) {
+        auto& lines = tiles[size_t(tile)];
+        const uchar* in = input.ptr<uchar>(y);
+        
+        const auto is_set = [&](int x) -> bool {
+            if(not m[x])
+                return false;
+            if(channels == 3)
+                return in[x * 3 + 0] | in[x * 3 + 1] | in[x * 3 + 2];
+            return in[x];
+        };
+        
+        for(int x = 0; x < input.cols; ) {
+            if(not is_set(x)) {
+                ++x;
+                continue;
+            }
+            
+            const int x0 = x;
+            while(x + 1 < input.cols && is_set(x + 1)
+                  && ptr_safe_t(x + 1 - x0) <= Line_t::bit_size_x1)
+            {
+                ++x;
+            }
+            
+            lines.push_back(Line_t(coord_t(x0), coord_t(x), coord_t(y)), in + size_t(x0) * step_px);
+            ++x;
+        }
+    });
+    
+    source.clear();
+    source.lw = coord_t(input.cols);
+    source.lh = coord_t(input.rows);
+    for(auto& tile : tiles)
+        source.append(tile);
+}
+
+}
+#endif
+
 template<typename Iterator>
 void process_tags(int32_t index,
                   Iterator start,
@@ -260,71 +517,75 @@ RawProcessing::RawProcessing(const gpuMat &average, const gpuMat *float_average,
     : _average(&average), _float_average(float_average)
 { }
 
+const gpuMat& RawProcessing::dilation_element(int32_t dilation_size) {
+    std::call_once(dilation_flag, [this, dilation_size]() {
+        const cv::Mat element = cv::Mat::ones(abs(dilation_size), abs(dilation_size), CV_8UC1);
+        element.copyTo(gpu_dilation_element);
+    });
+    return gpu_dilation_element;
+}
+
+const gpuMat& RawProcessing::closing_element_for(int closing_size) {
+    if(_last_morph_size != closing_size) {
+        morph_flag = std::make_unique<std::once_flag>();
+    }
+    
+    std::call_once(*morph_flag, [this, closing_size]() {
+        const int morph_size = closing_size;
+        const cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * morph_size + 1, 2 * morph_size + 1), cv::Point(morph_size, morph_size));
+        element.copyTo(closing_element);
+        _last_morph_size = closing_size;
+    });
+    return closing_element;
+}
+
 void RawProcessing::generate_binary(const cv::Mat& /*cpu_input*/, const gpuMat& input, cv::Mat& output, TagCache* tag_cache) {
+    CMN_TRACE_SCOPE("RawProcessing::generate_binary");
+    generate(input, output, nullptr, tag_cache);
+}
+
+void RawProcessing::generate_lines(const cv::Mat& /*cpu_input*/, const gpuMat& input, CPULabeling::ListCache_t& cache, TagCache* tag_cache) {
+    CMN_TRACE_SCOPE("RawProcessing::generate_lines");
+    cache.obj->clear();
+    if(generate(input, _lines_binary, &cache, tag_cache))
+        return;
+    
+    cache.source().init(_lines_binary, true);
+}
+
+bool RawProcessing::generate(const gpuMat& input, cv::Mat& output, CPULabeling::ListCache_t* cache, TagCache* tag_cache) {
     assert(input.type() == CV_8UC1 || input.type() == CV_8UC3);
 
-    static bool enable_diff = BOOL_SETTING(enable_difference);
-    static bool enable_abs_diff = BOOL_SETTING(detect_threshold_is_absolute);
-    static bool blur_difference = BOOL_SETTING(blur_difference);
-    static std::once_flag registered_callback;
-    static float adaptive_threshold_scale = 0;
-    static int detect_threshold = 25, threshold_maximum = 255;
-    static bool use_closing = false;
-    static int closing_size = 1;
-    static bool use_adaptive_threshold = false;
-    static int32_t dilation_size = 0;
-    static bool tags_enable = false, image_invert = false;
-    static bool tags_equalize_hist = false;
-    static int tags_threshold = 15;
+    static const struct {
+        SettingHandle<bool> enable_difference{"enable_difference"};
+        SettingHandle<bool> detect_threshold_is_absolute{"detect_threshold_is_absolute"};
+        SettingHandle<bool> blur_difference{"blur_difference"};
+        SettingHandle<float> adaptive_threshold_scale{"adaptive_threshold_scale"};
+        SettingHandle<int> detect_threshold{"detect_threshold", 25};
+        SettingHandle<int> threshold_maximum{"threshold_maximum", 255};
+        SettingHandle<bool> use_closing{"use_closing"};
+        SettingHandle<int> closing_size{"closing_size", 1};
+        SettingHandle<bool> use_adaptive_threshold{"use_adaptive_threshold"};
+        SettingHandle<int32_t> dilation_size{"dilation_size"};
+        SettingHandle<bool> image_invert{"image_invert"};
+        SettingHandle<bool> tags_enable{"tags_enable"};
+        SettingHandle<bool> tags_equalize_hist{"tags_equalize_hist"};
+        SettingHandle<int> tags_threshold{"tags_threshold", 15};
+    } settings;
     
-    std::call_once(registered_callback, [](){
-        static const auto callback = [](std::string_view key) {
-            auto value = GlobalSettings::read_value<NoType>(key);
-            if (key == "enable_difference")
-                enable_diff = value.template value<bool>();
-            else if (key == "detect_threshold_is_absolute")
-                enable_abs_diff = value.template value<bool>();
-            else if (key == "adaptive_threshold_scale")
-                adaptive_threshold_scale = value.template value<float>();
-            else if (key == "detect_threshold")
-                detect_threshold = value.template value<int>();
-            else if (key == "threshold_maximum")
-                threshold_maximum = value.template value<int>();
-            else if (key == "use_closing")
-                use_closing = value.template value<bool>();
-            else if (key == "closing_size")
-                closing_size = value.template value<int>();
-            else if (key == "use_adaptive_threshold")
-                use_adaptive_threshold = value.template value<bool>();
-            else if (key == "dilation_size")
-                dilation_size = value.template value<int32_t>();
-            else if (key == "image_invert")
-                image_invert = value.template value<bool>();
-            else if (key == "tags_enable")
-                tags_enable = value.template value<bool>();
-            else if (key == "tags_equalize_hist")
-                tags_equalize_hist = value.template value<bool>();
-            else if (key == "tags_threshold")
-                tags_threshold = value.template value<int>();
-        };
-        
-        GlobalSettings::register_callbacks({
-            "enable_difference",
-            "detect_threshold_is_absolute",
-            "adaptive_threshold_scale",
-            "detect_threshold",
-            "threshold_maximum",
-            "use_closing",
-            "closing_size",
-            "use_adaptive_threshold",
-            "dilation_size",
-            "image_invert",
-            "tags_enable",
-            "tags_equalize_hist",
-            "tags_threshold"
-            
-        }, callback);
-    });
+    /// one copy per frame, so the whole frame sees the same values
+    const bool enable_diff = settings.enable_difference();
+    const bool enable_abs_diff = settings.detect_threshold_is_absolute();
+    const bool blur_difference = settings.blur_difference();
+    const float adaptive_threshold_scale = settings.adaptive_threshold_scale();
+    const int detect_threshold = settings.detect_threshold(), threshold_maximum = settings.threshold_maximum();
+    const bool use_closing = settings.use_closing();
+    const int closing_size = settings.closing_size();
+    const bool use_adaptive_threshold = settings.use_adaptive_threshold();
+    const int32_t dilation_size = settings.dilation_size();
+    const bool tags_enable = settings.tags_enable(), image_invert = settings.image_invert();
+    const bool tags_equalize_hist = settings.tags_equalize_hist();
+    const int tags_threshold = settings.tags_threshold();
 
     // These two buffers are constantly going to be exchanged
     // after every call to a cv function. This means that no additional
@@ -347,6 +608,39 @@ void RawProcessing::generate_binary(const cv::Mat& /*cpu_input*/, const gpuMat&
     if (_average->empty()) {
         throw U_EXCEPTION("Average image is empty.");
     }
+    
+#ifndef USE_GPU_MAT
+    // everything except for blurring, adaptive thresholds, negative
+    // dilation and tags can be done in one pass over the image:
+    if(_fused_pipeline
+       && not blur_difference
+       && not use_adaptive_threshold
+       && not tags_enable
+       && dilation_size >= 0)
+    {
+        if(input.channels() == 3 && _grey_average.empty())
+            cv::cvtColor(*_average, _grey_average, cv::COLOR_BGR2GRAY);
+        
+        const FusedParameters parameters{
+            .invert = image_invert,
+            .difference = enable_diff,
+            .absolute = enable_abs_diff,
+            .threshold = detect_threshold,
+            .threshold_maximum = threshold_maximum,
+            .closing_element = use_closing ? &closing_element_for(closing_size) : nullptr,
+            .dilation_element = dilation_size > 0 ? &dilation_element(dilation_size) : nullptr
+        };
+        
+        auto& average = input.channels() == 1 ? *_average : _grey_average;
+        if(cache) {
+            generate_lines_fused(input, average, parameters, cache->source());
+            return true;
+        }
+        
+        generate_binary_fused(input, average, parameters, output);
+        return false;
+    }
+#endif
 
     // DO we need to invert the image? Cause if yes, then the average
     // would be inverted already (so we need to do the same with the
@@ -415,11 +709,7 @@ void RawProcessing::generate_binary(const cv::Mat& /*cpu_input*/, const gpuMat&
         }
         
         if (dilation_size != 0) {
-            std::call_once(dilation_flag, [this]() {
-                const cv::Mat element = cv::Mat::ones(abs(dilation_size), abs(dilation_size), CV_8UC1);
-                element.copyTo(gpu_dilation_element);
-            });
-            
+            dilation_element(dilation_size);
             INPUT->copyTo(diff);
         }
         
@@ -436,16 +726,7 @@ void RawProcessing::generate_binary(const cv::Mat& /*cpu_input*/, const gpuMat&
         //      2. dilate + erode
         //      3. use dilation flag
         if (use_closing) {
-            if(_last_morph_size != closing_size) {
-                morph_flag = std::make_unique<std::once_flag>();
-            }
-            
-            std::call_once(*morph_flag, [this]() {
-                const int morph_size = closing_size;
-                const cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * morph_size + 1, 2 * morph_size + 1), cv::Point(morph_size, morph_size));
-                element.copyTo(closing_element);
-                _last_morph_size = closing_size;
-            });
+            closing_element_for(closing_size);
             
             if (use_adaptive_threshold) {
                 //cv::Mat local;
@@ -678,6 +959,8 @@ void RawProcessing::generate_binary(const cv::Mat& /*cpu_input*/, const gpuMat&
             //tf::imshow("result", result);
         }
     }
+    
+    return false;
 }
 
 }
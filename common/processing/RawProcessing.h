@@ -11,6 +11,10 @@ namespace cmn {
     class LuminanceGrid;
 }
 
+namespace cmn::CPULabeling {
+    struct ListCache_t;
+}
+
 struct TagCache {
     std::vector<pv::BlobPtr> tags;
     
@@ -40,6 +44,12 @@ class cmn::RawProcessing {
     
     int _last_morph_size{-1};
     
+    //! binary image that generate_lines' lines point into, if it needs one
+    cv::Mat _lines_binary;
+    
+    //! use the fused, row-tiled CPU pipeline where possible (same results)
+    GETTER_SETTER_I(bool, fused_pipeline, true);
+    
     //const LuminanceGrid *_grid;
     //gpuMat _binary;
     //gpuMat _difference;
@@ -56,7 +66,25 @@ public:
     }
 
     void generate_binary(const cv::Mat& cpu_input, const gpuMat& input, cv::Mat& output, TagCache*);
+    
+    /**
+     * Same as generate_binary, followed by extracting the lines of the
+     * binary image into the Source of cache (ready for CPULabeling::run(cache, channels)).
+     * Where the fused pipeline applies, lines are emitted straight from
+     * the thresholded tiles and no binary image is written at all - pixel
+     * pointers then point into input, which has to stay alive until the
+     * lines have been labeled. Otherwise they point into an internal
+     * image that is valid until the next call.
+     */
+    void generate_lines(const cv::Mat& cpu_input, const gpuMat& input, CPULabeling::ListCache_t& cache, TagCache*);
+    
     cv::Mat get_binary() const;
+    
+private:
+    //! returns true if lines have been written to cache directly (output is untouched then)
+    bool generate(const gpuMat& input, cv::Mat& output, CPULabeling::ListCache_t* cache, TagCache*);
+    const gpuMat& dilation_element(int32_t dilation_size);
+    const gpuMat& closing_element_for(int closing_size);
 };
 
 
@@ -0,0 +1,213 @@
+#include "RunContours.h"
+
+namespace cmn::pixel {
+
+namespace {
+
+//! the side of a pixel an outline point sits on
+enum class Side : uint8_t {
+    TOP, RIGHT, BOTTOM, LEFT
+};
+
+}
+
+const RunContours::Run* RunContours::row_begin(int32_t y) const {
+    if(y < _y0 || y - _y0 + 1 >= int32_t(_rows.size()))
+        return nullptr;
+    return _runs.data() + _rows[size_t(y - _y0)];
+}
+
+const RunContours::Run* RunContours::row_end(int32_t y) const {
+    if(y < _y0 || y - _y0 + 1 >= int32_t(_rows.size()))
+        return nullptr;
+    return _runs.data() + _rows[size_t(y - _y0) + 1u];
+}
+
+const RunContours::Run* RunContours::find(int32_t y, int32_t x) const {
+    return std::partition_point(row_begin(y), row_end(y), [x](const Run& run) {
+        return run.x1 < x;
+    });
+}
+
+bool RunContours::is_set(int32_t x, int32_t y) const {
+    auto it = find(y, x);
+    return it != row_end(y) && it->x0 <= x;
+}
+
+void RunContours::trace(std::span<const HorizontalLine> lines, bool include_inner) {
+    _points.clear();
+    _contours.clear();
+    _runs.clear();
+    _rows.clear();
+
+    if(lines.empty())
+        return;
+
+    assert(std::is_sorted(lines.begin(), lines.end(), [](const HorizontalLine& A, const HorizontalLine& B) {
+        return A.y < B.y || (A.y == B.y && A.x0 < B.x0);
+    }));
+
+    /// one range of runs per row (empty for rows without lines), where
+    /// lines that touch each other are merged into one run
+    _y0 = lines.front().y;
+    const int32_t rows = int32_t(lines.back().y) - _y0 + 1;
+    _rows.resize(size_t(rows) + 1u);
+
+    int32_t y = _y0 - 1;
+    for(auto& line : lines) {
+        if(line.y != y) {
+            for(++y; y <= line.y; ++y)
+                _rows[size_t(y - _y0)] = narrow_cast<uint32_t>(_runs.size());
+            y = line.y;
+            _runs.push_back(Run{ line.x0, line.x1 });
+
+        } else if(int32_t(line.x0) <= _runs.back().x1 + 1) {
+            _runs.back().x1 = max(_runs.back().x1, int32_t(line.x1));
+        } else
+            _runs.push_back(Run{ line.x0, line.x1 });
+    }
+    _rows.back() = narrow_cast<uint32_t>(_runs.size());
+    _visited.assign(_runs.size(), false);
+
+    /// every contour passes the left side of at least one run (the
+    /// left-most pixel of an object, or the pixel right of a hole)
+    for(int32_t r = 0; r < rows; ++r) {
+        for(uint32_t i = _rows[size_t(r)]; i < _rows[size_t(r) + 1u]; ++i) {
+            if(not _visited[i])
+                trace_from(_runs.data() + i, _y0 + r, include_inner);
+        }
+    }
+}
+
+void RunContours::trace_from(const Run* run, int32_t y, bool include_inner) {
+    const size_t offset = _points.size();
+
+    /// points are kept in half-pixel units, which are integers, so the
+    /// (doubled) signed area can be summed up exactly
+    int64_t area = 0;
+    int32_t first_x = 0, first_y = 0, last_x = 0, last_y = 0;
+    auto add = [&](Side at, int32_t px, int32_t py) {
+        int32_t X = 2 * px, Y = 2 * py;
+        switch(at) {
+            case Side::TOP:    X += 1;          break;
+            case Side::RIGHT:  X += 2; Y += 1;  break;
+            case Side::BOTTOM: X += 1; Y += 2;  break;
+            case Side::LEFT:           Y += 1;  break;
+        }
+
+        if(_points.size() == offset) {
+            first_x = X;
+            first_y = Y;
+        } else
+            area += int64_t(last_x) * Y - int64_t(X) * last_y;
+        last_x = X;
+        last_y = Y;
+
+        _points.emplace_back(Float2_t(X) * 0.5_F, Float2_t(Y) * 0.5_F);
+    };
+
+    /// The same rules as Tree::generate_edges: from every side, go to the
+    /// side of the diagonal neighbor if it is set, otherwise to the same
+    /// side of the next pixel if that is set, otherwise around the corner
+    /// of this pixel. The object is always on the left.
+    const int32_t sx = run->x0, sy = y;
+    Side side = Side::LEFT;
+    int32_t x = sx;
+
+    do {
+        add(side, x, y);
+
+        switch(side) {
+            case Side::LEFT:
+                _visited[size_t(find(y, x) - _runs.data())] = true;
+                if(is_set(x - 1, y + 1)) {
+                    side = Side::TOP;
+                    --x;
+                    ++y;
+                } else if(is_set(x, y + 1))
+                    ++y;
+                else
+                    side = Side::BOTTOM;
+                break;
+
+            case Side::TOP: {
+                /// walk left along the top of the run, until there is a
+                /// pixel above (or the run ends)
+                int32_t stop = find(y, x)->x0;
+                auto above = find(y - 1, x);
+                if(above != row_begin(y - 1))
+                    stop = max(stop, (above - 1)->x1 + 1);
+                for(int32_t i = x - 1; i >= stop; --i)
+                    add(Side::TOP, i, y);
+                x = stop;
+
+                if(is_set(x - 1, y - 1)) {
+                    side = Side::RIGHT;
+                    --x;
+                    --y;
+                } else
+                    side = Side::LEFT;
+                break;
+            }
+
+            case Side::RIGHT:
+                if(is_set(x + 1, y - 1)) {
+                    side = Side::BOTTOM;
+                    ++x;
+                    --y;
+                } else if(is_set(x, y - 1))
+                    --y;
+                else
+                    side = Side::TOP;
+                break;
+
+            case Side::BOTTOM: {
+                /// walk right along the bottom of the run, until there is
+                /// a pixel below (or the run ends)
+                int32_t stop = find(y, x)->x1;
+                auto below = find(y + 1, x);
+                if(below != row_end(y + 1))
+                    stop = min(stop, below->x0 - 1);
+                for(int32_t i = x + 1; i <= stop; ++i)
+                    add(Side::BOTTOM, i, y);
+                x = stop;
+
+                if(is_set(x + 1, y + 1)) {
+                    side = Side::LEFT;
+                    ++x;
+                    ++y;
+                } else
+                    side = Side::RIGHT;
+                break;
+            }
+        }
+
+    } while(side != Side::LEFT || x != sx || y != sy);
+
+    area += int64_t(last_x) * first_y - int64_t(first_x) * last_y;
+
+    /// outer contours run counter-clockwise, so their area is negative
+    const bool inner = area > 0;
+    if(inner && not include_inner) {
+        _points.resize(offset);
+        return;
+    }
+
+    _contours.push_back(Contour{
+        .offset = narrow_cast<uint32_t>(offset),
+        .size = narrow_cast<uint32_t>(_points.size() - offset),
+        .inner = inner
+    });
+}
+
+std::vector<std::unique_ptr<std::vector<Vec2>>> RunContours::to_vectors() const {
+    std::vector<std::unique_ptr<std::vector<Vec2>>> result;
+    result.reserve(_contours.size());
+    for(auto& contour : _contours) {
+        auto p = points(contour);
+        result.emplace_back(std::make_unique<std::vector<Vec2>>(p.begin(), p.end()));
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/detail.h>
+
+namespace cmn::pixel {
+
+/**
+ * Traces the outlines of a set of horizontal lines (sorted by y, then x0),
+ * without building a pixel::Tree.
+ *
+ * The outline points are the same as the ones of find_outer_points: the
+ * midpoints of all pixel sides between a set and an unset pixel, where
+ * diagonal pixels are connected (8-neighborhood). Every contour is walked
+ * once along its boundary, looking up neighbors in the lines of the rows
+ * above and below; sides along the top / bottom of a line are added in one
+ * go. Points of all contours go into one flat buffer.
+ *
+ * Outer contours run counter-clockwise (on screen, with y pointing down) and
+ * holes clockwise. Contours start at the left side of a pixel and come in
+ * the order they are found in, scanning from top-left to bottom-right -
+ * so the outer contour of the first row comes first.
+ *
+ * Buffers are kept between calls, so a tracer that is reused does not
+ * allocate once it has seen a big enough blob.
+ */
+class RunContours {
+public:
+    struct Contour {
+        //! index of the first point in points()
+        uint32_t offset;
+        uint32_t size;
+        //! the outline of a hole
+        bool inner;
+    };
+
+private:
+    struct Run {
+        int32_t x0, x1;
+    };
+
+    GETTER(std::vector<Vec2>, points);
+    GETTER(std::vector<Contour>, contours);
+
+    //! lines with touching / overlapping ones merged, and the first run of every row
+    std::vector<Run> _runs;
+    std::vector<uint32_t> _rows;
+    std::vector<bool> _visited;
+    int32_t _y0{0};
+
+public:
+    /**
+     * Replaces the current contours with the ones of the given lines.
+     * Holes are only kept if include_inner is set.
+     */
+    void trace(std::span<const HorizontalLine> lines, bool include_inner = false);
+
+    std::span<const Vec2> points(const Contour& contour) const {
+        return std::span<const Vec2>(_points.data() + contour.offset, contour.size);
+    }
+
+    //! all contours in the format returned by find_outer_points
+    std::vector<std::unique_ptr<std::vector<Vec2>>> to_vectors() const;
+
+private:
+    //! first run in row y that ends at or after x (or the end of the row)
+    const Run* find(int32_t y, int32_t x) const;
+    const Run* row_begin(int32_t y) const;
+    const Run* row_end(int32_t y) const;
+    bool is_set(int32_t x, int32_t y) const;
+    void trace_from(const Run* run, int32_t y, bool include_inner);
+};
+
+}
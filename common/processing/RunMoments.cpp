@@ -0,0 +1,149 @@
+#include "RunMoments.h"
+#include <misc/WorkStealingPool.h>
+#include <misc/ThreadPool.h>
+
+namespace pv {
+
+using namespace cmn;
+
+namespace {
+
+//! lines per block, one accumulator lane each
+constexpr size_t lanes = 8;
+
+WorkStealingPool& moments_pool() {
+    static WorkStealingPool pool(max(1u, cmn::hardware_concurrency()), "moments_pool");
+    return pool;
+}
+
+/**
+ * sum[i][j] = sum over all pixels of (x - cx)^i * (y - cy)^j.
+ *
+ * For a line of n pixels starting at u = x0 - cx (with v = y - cy):
+ *   sum 1     = n
+ *   sum x     = n*u + T1,                 T1 = n(n-1)/2
+ *   sum x^2   = n*u^2 + 2*u*T1 + T2,      T2 = (n-1)n(2n-1)/6
+ * and every one of them is multiplied by 1, v and v^2.
+ */
+void run_sums(std::span<const HorizontalLine> lines, double cx, double cy, double sum[3][3]) {
+    alignas(64) double acc[3][3][lanes]{};
+    alignas(64) double n[lanes], u[lanes], v[lanes];
+
+    for(size_t i = 0; i < lines.size(); i += lanes) {
+        const size_t M = min(lanes, lines.size() - i);
+        for(size_t j = 0; j < M; ++j) {
+            auto& h = lines[i + j];
+            n[j] = double(h.x1) - double(h.x0) + 1.0;
+            u[j] = double(h.x0) - cx;
+            v[j] = double(h.y) - cy;
+        }
+        /// empty lanes do not contribute anything
+        for(size_t j = M; j < lanes; ++j)
+            n[j] = u[j] = v[j] = 0.0;
+
+        for(size_t j = 0; j < lanes; ++j) {
+            const double T1 = n[j] * (n[j] - 1.0) * 0.5;
+            const double T2 = (n[j] - 1.0) * n[j] * (2.0 * n[j] - 1.0) * (1.0 / 6.0);
+
+            const double s0 = n[j];
+            const double s1 = n[j] * u[j] + T1;
+            const double s2 = n[j] * u[j] * u[j] + 2.0 * u[j] * T1 + T2;
+            const double v1 = v[j];
+            const double v2 = v[j] * v[j];
+
+            acc[0][0][j] += s0;
+            acc[0][1][j] += s0 * v1;
+            acc[0][2][j] += s0 * v2;
+            acc[1][0][j] += s1;
+            acc[1][1][j] += s1 * v1;
+            acc[1][2][j] += s1 * v2;
+            acc[2][0][j] += s2;
+            acc[2][1][j] += s2 * v1;
+            acc[2][2][j] += s2 * v2;
+        }
+    }
+
+    for(int p = 0; p < 3; ++p) {
+        for(int q = 0; q < 3; ++q) {
+            double s = 0;
+            for(size_t j = 0; j < lanes; ++j)
+                s += acc[p][q][j];
+            sum[p][q] = s;
+        }
+    }
+}
+
+}
+
+void RunMoments::raw(std::span<const HorizontalLine> lines, float m[3][3]) {
+    double sum[3][3];
+    run_sums(lines, 0.0, 0.0, sum);
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            m[i][j] = float(sum[i][j]);
+}
+
+void RunMoments::central(std::span<const HorizontalLine> lines, const Vec2& center, float mu[3][3]) {
+    double sum[3][3];
+    run_sums(lines, double(center.x), double(center.y), sum);
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            mu[i][j] = float(sum[i][j]);
+}
+
+Moments RunMoments::calculate(std::span<const HorizontalLine> lines, Vec2* center, float* angle) {
+    Moments moments;
+    if(lines.empty())
+        return moments;
+
+    /// the centroid is taken from the double sums, before rounding to float
+    double sum[3][3];
+    run_sums(lines, 0.0, 0.0, sum);
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            moments.m[i][j] = float(sum[i][j]);
+
+    const double cx = sum[1][0] / sum[0][0];
+    const double cy = sum[0][1] / sum[0][0];
+    run_sums(lines, cx, cy, sum);
+
+    const double mu00_inv = 1.0 / sum[0][0];
+    for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 3; ++j) {
+            moments.mu[i][j] = float(sum[i][j]);
+            moments.mu_[i][j] = float(sum[i][j] * mu00_inv);
+        }
+    }
+
+    if(center)
+        *center = Vec2(Float2_t(cx), Float2_t(cy));
+    if(angle)
+        *angle = 0.5f * cmn::fast_atan2(2 * moments.mu_[1][1], moments.mu_[2][0] - moments.mu_[0][2]);
+
+    moments.ready = true;
+    return moments;
+}
+
+void RunMoments::calculate(std::span<const pv::BlobPtr> blobs) {
+    auto fn = [&](auto, size_t start, size_t end, auto) {
+        for(size_t i = start; i < end; ++i) {
+            auto& blob = blobs[i];
+            if(not blob)
+                continue;
+            blob->calculate_properties();
+            blob->calculate_moments();
+        }
+    };
+
+    /// a few blobs are not worth waking up the pool
+    if(blobs.size() < 64) {
+        fn(0, size_t(0), blobs.size(), 0);
+        return;
+    }
+
+    distribute_indexes_dynamic(fn, moments_pool(), size_t(0), blobs.size(), DistributeOptions{
+        .min_chunk = 16
+    });
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <processing/PVBlob.h>
+
+namespace pv {
+
+/**
+ * Image moments of all pixels covered by a set of horizontal lines.
+ *
+ * Every line is a run of pixels x0..x1 on one row, so the sums over its
+ * pixels (of 1, x and x^2) have closed forms and each line costs the same,
+ * no matter how long it is. Lines are processed in blocks, with one
+ * accumulator per lane, so the compiler can vectorize across lines.
+ * Sums are accumulated in double precision.
+ */
+struct RunMoments {
+    //! raw moments: m[i][j] = sum of x^i * y^j
+    static void raw(std::span<const cmn::HorizontalLine> lines, float m[3][3]);
+    //! central moments: mu[i][j] = sum of (x - cx)^i * (y - cy)^j
+    static void central(std::span<const cmn::HorizontalLine> lines, const cmn::Vec2& center, float mu[3][3]);
+
+    /**
+     * Raw and central moments, as calculated by Blob::calculate_moments.
+     * Returns them together with the centroid and the orientation.
+     */
+    static Moments calculate(std::span<const cmn::HorizontalLine> lines, cmn::Vec2* center = nullptr, float* angle = nullptr);
+
+    /**
+     * Calculates properties and moments of all blobs of a frame in one
+     * parallel sweep over the blobs (instead of fanning out per blob).
+     * Blobs that are already done are skipped.
+     */
+    static void calculate(std::span<const pv::BlobPtr> blobs);
+};
+
+}
@@ -1,5 +1,5 @@
 #include "Source.h"
-#include <misc/ThreadPool.h>
+#include <misc/WorkStealingPool.h>
 
 namespace cmn::CPULabeling {
 
@@ -65,6 +65,18 @@ void Source::push_back(const Line_t& line) {
     });
 }
 
+void Source::append(const Source& other) {
+    assert(other.empty() || empty() || other._row_y.front() > _row_y.back());
+    
+    const size_t S = _ptrs.size();
+    _pixels.insert(_pixels.end(), other._pixels.begin(), other._pixels.end());
+    _ptrs.insert(_ptrs.end(), other._ptrs.begin(), other._ptrs.end());
+    
+    for(auto o : other._row_offsets)
+        _row_offsets.push_back(o + S);
+    _row_y.insert(_row_y.end(), other._row_y.begin(), other._row_y.end());
+}
+
 //! assumes external ownership of Line ptr -- needs to stay alive during the process
 /*void push_back(const Line* line, const Pixel& px) {
     if(_row_offsets.empty() || line->y > _row_y.back()) {
@@ -80,10 +92,13 @@ void Source::push_back(const Line_t& line) {
 /**
  * Initialize source entity based on an OpenCV image. All 0 pixels are interpreted as background. This function extracts all horizontal lines from an image and saves them inside, along with information about where which y-coordinate is located.
  */
-void Source::init(const cv::Mat& image, bool enable_threads) {
+WorkStealingPool& Source::pool() {
     // assuming the number of threads allowed is < 255
-    static GenericThreadPool pool(max(1u, cmn::hardware_concurrency()), "extract_lines");
-    
+    static WorkStealingPool _pool(max(1u, cmn::hardware_concurrency()), "extract_lines");
+    return _pool;
+}
+
+void Source::init(const cv::Mat& image, bool enable_threads) {
     assert(image.cols < USHRT_MAX && image.rows < USHRT_MAX);
     assert(image.type() == CV_8UC1 || image.type() == CV_8UC3);
     assert(image.isContinuous());
@@ -100,45 +115,23 @@ void Source::init(const cv::Mat& image, bool enable_threads) {
         /**
          * FIND HORIZONTAL LINES IN ORIGINAL IMAGE
          */
-        uint8_t current_index{0};
-        std::mutex m;
-        std::condition_variable variable;
+        // every chunk fills its own source, which are appended in order
+        // afterwards. chunks must not wait for each other: the pool runs
+        // them in any order (and chunks of concurrent calls share workers).
+        std::vector<Source> chunks(pool().num_threads(), Source{
+            ._pixels = {},
+            .lw = lw,
+            .lh = lh,
+        });
         
         distribute_indexes([&](const uint8_t, int32_t start, int32_t end, const uint8_t i){
-            Source source{
-                ._pixels = {},
-                .lw = lw,
-                .lh = lh,
-            };
-            
             //! perform the actual work
-            Source::extract_lines(image, &source, Range<int32_t>(start, end));
-            
-            // now merge lines (partly) in parallel:
-            std::unique_lock guard(m);
-            while(current_index < i) {
-                variable.wait(guard);
-            }
-            
-            size_t S = _ptrs.size();
-            _pixels.insert(_pixels.end(), source._pixels.begin(), source._pixels.end());
-            //_full_lines.insert(_full_lines.end(), source._full_lines.begin(), source._full_lines.end());
-            /*for(auto &o : source._lines) {
-                o = (const HorizontalLine*)((size_t)o + S);
-            }*/
-            _ptrs.insert(_ptrs.end(), std::make_move_iterator(source._ptrs.begin()), std::make_move_iterator(source._ptrs.end()));
-            //_nodes.insert(_nodes.end(), std::make_move_iterator(source._nodes.begin()), std::make_move_iterator(source._nodes.end()));
+            Source::extract_lines(image, &chunks.at(i), Range<int32_t>(start, end));
             
-            for(auto &o : source._row_offsets)
-                o += S;
-                
-            _row_offsets.insert(_row_offsets.end(), std::make_move_iterator(source._row_offsets.begin()), std::make_move_iterator(source._row_offsets.end()));
-            _row_y.insert(_row_y.end(), std::make_move_iterator(source._row_y.begin()), std::make_move_iterator(source._row_y.end()));
-            
-            ++current_index;
-            variable.notify_all();
-            
-        }, pool, int32_t(0), int32_t(lh));
+        }, pool(), int32_t(0), int32_t(lh));
+        
+        for(auto& chunk : chunks)
+            append(chunk);
         
     } else {
         extract_lines(image, this, Range<int32_t>{0, int32_t(lh)});
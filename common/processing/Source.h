@@ -5,6 +5,10 @@
 #include <processing/Node.h>
 #include <processing/HLine.h>
 
+namespace cmn {
+class WorkStealingPool;
+}
+
 namespace cmn::CPULabeling {
 
 struct Source {
@@ -34,6 +38,9 @@ struct Source {
     void push_back(const Line_t& line, const Pixel& px);
     void push_back(const Line_t& line);
     
+    //! Appends all lines of other, which have to be below our own lines.
+    void append(const Source& other);
+    
     void finalize() {}
     
     class RowRef {
@@ -150,27 +157,36 @@ struct Source {
         static RowRef from_index(Source* source, coord_t y) {
             auto it = std::upper_bound(source->_row_y.begin(), source->_row_y.end(), y);
             
-            // beyond the value ranges
-            if(it == source->_row_y.end()) {
-                return RowRef(); // return nullptr
-            }
-            
             // if the found row is bigger than the desired y, then it will either be because the y we sought is the previous element, or because it does not exist.
             if(it > source->_row_y.begin() && *(it - 1)  == y) {
                 --it;
             }
             
-            y = *it;
+            // beyond the value ranges
+            if(it == source->_row_y.end()) {
+                return RowRef(); // return nullptr
+            }
+            
+            return from_row(source, size_t(std::distance(source->_row_y.begin(), it)));
+        }
+        
+        /**
+         * Constructs a RowRef for the idx-th non-empty row of source.
+         * @param source Source object that contains the desired row
+         * @param idx index of the row (not its y-coordinate)
+         */
+        static RowRef from_row(Source* source, size_t idx) {
+            if(idx >= source->_row_y.size())
+                return RowRef();
             
-            size_t idx = std::distance(source->_row_y.begin(), it);
             size_t idx0 = source->_row_offsets.at(idx);
-            size_t idx1 = idx0+1 == source->_row_offsets.size() ? source->_ptrs.size() : source->_row_offsets.at(idx+1);
+            size_t idx1 = idx+1 == source->_row_offsets.size() ? source->_ptrs.size() : source->_row_offsets.at(idx+1);
             
             return RowRef{
                 source,
                 
                 idx,
-                y,
+                source->_row_y[idx],
                 
                 source->_pixels.data() + idx0,
                 source->_pixels.data() + idx1,
@@ -187,6 +203,12 @@ struct Source {
      */
     void init(const cv::Mat& image, bool enable_threads);
     
+    /**
+     * Thread pool shared by all labeling stages that work on a Source
+     * (line extraction in init() and band labeling in CPULabeling).
+     */
+    static WorkStealingPool& pool();
+    
     /**
      * Constructs a RowRef struct for a given y-coordinate (see RowRef::from_index).
      */
@@ -3,9 +3,30 @@
 #include <misc/Image.h>
 #include <misc/SpriteMap.h>
 #include <misc/Timer.h>
+#include <misc/ThreadPool.h>
+#include <bit>
 
 namespace cmn {
 
+namespace {
+
+//! number of rows that share one lock in add_threaded (mode only)
+constexpr uint64_t mode_rows_per_lock = 100;
+
+//! memory needed per pixel and channel for the given number of bins
+constexpr uint64_t mode_bytes_per_value(uint32_t bins) {
+    return bins * sizeof(uint16_t) + (bins < 256 ? bins * sizeof(uint32_t) : 0);
+}
+
+std::atomic<uint64_t> next_accumulator_id{0};
+
+GenericThreadPool& finalize_pool() {
+    static GenericThreadPool _pool(max(1u, cmn::hardware_concurrency()), "AveragingFinalize");
+    return _pool;
+}
+
+}
+
 ENUM_CLASS_DOCS(averaging_method_t,
     "Sum all samples and divide by N.",
     "Calculate a per-pixel median of the samples to avoid noise. More computationally involved than mean, but often better results.",
@@ -13,11 +34,16 @@ ENUM_CLASS_DOCS(averaging_method_t,
     "Use a per-pixel maximum across samples. Usually a good choice for short videos with white backgrounds and individuals that do not move much."
 )
 
-AveragingAccumulator::AveragingAccumulator() {
+AveragingAccumulator::AveragingAccumulator()
+    : _id(next_accumulator_id++)
+{
     _mode = GlobalSettings::read_value_with_default("averaging_method", averaging_method_t::mean);
+    _mode_memory_limit = GlobalSettings::read_value_with_default("averaging_mode_memory_limit", default_mode_memory_limit);
 }
-AveragingAccumulator::AveragingAccumulator(averaging_method_t::Class mode)
-    : _mode(mode)
+AveragingAccumulator::AveragingAccumulator(averaging_method_t::Class mode, uint64_t mode_memory_limit)
+    : _mode(mode),
+      _id(next_accumulator_id++),
+      _mode_memory_limit(mode_memory_limit)
 { }
 
 void AveragingAccumulator::add(const Mat& f) {
@@ -28,129 +54,221 @@ void AveragingAccumulator::add_threaded(const Mat& f) {
     _add<true>(f);
 }
 
+AveragingAccumulator::Mat AveragingAccumulator::_empty_accumulator(int channels) const {
+    Mat accumulator = cv::Mat::zeros((int)_size.height, (int)_size.width, _mode == averaging_method_t::mean ? CV_32FC(channels) : CV_8UC(channels));
+    if(_mode == averaging_method_t::min)
+        accumulator.setTo(255);
+    return accumulator;
+}
+
+void AveragingAccumulator::_accumulate(Mat& accumulator, Mat& float_mat, double& samples, const Mat& f) const {
+    if(_mode == averaging_method_t::mean) {
+        f.convertTo(float_mat, CV_32FC(f.channels()));
+        cv::add(accumulator, float_mat, accumulator);
+        ++samples;
+        
+    } else if(_mode == averaging_method_t::max) {
+        cv::max(accumulator, f, accumulator);
+        
+    } else if(_mode == averaging_method_t::min) {
+        cv::min(accumulator, f, accumulator);
+        
+    } else
+        throw U_EXCEPTION("Unknown averaging_method ", _mode.name());
+}
+
+AveragingAccumulator::Shard& AveragingAccumulator::_local_shard() {
+    /// remember the last shard this thread used, so the shared
+    /// map only has to be consulted when switching accumulators
+    struct Cache {
+        uint64_t id = std::numeric_limits<uint64_t>::max();
+        Shard* shard = nullptr;
+    };
+    thread_local Cache cache;
+    
+    if(cache.id == _id && cache.shard)
+        return *cache.shard;
+    
+    std::lock_guard guard(_shards_mutex);
+    auto& shard = _shards[std::this_thread::get_id()];
+    if(not shard)
+        shard = std::make_unique<Shard>();
+    
+    cache = Cache{ .id = _id, .shard = shard.get() };
+    return *shard;
+}
+
 template<bool threaded>
 void AveragingAccumulator::_add(const Mat &f) {
     const uint8_t channels = f.channels();
     assert(channels == 1 || channels == 3);
     assert(f.type() == CV_8UC1 || f.type() == CV_8UC3);
 
-    {
-        std::unique_ptr<std::lock_guard<std::mutex>> guard;
+    if(not _initialized.load(std::memory_order_acquire)) {
+        std::unique_lock guard(_accumulator_mutex, std::defer_lock);
         if constexpr(threaded) {
-            guard = std::make_unique<std::lock_guard<std::mutex>>(_accumulator_mutex);
+            guard.lock();
         }
         
         // initialization code
-        if(_accumulator.empty()) {
+        if(not _initialized.load(std::memory_order_relaxed)) {
             _size = Size2(f.cols, f.rows);
-            _accumulator = cv::Mat::zeros((int)_size.height, (int)_size.width, _mode == averaging_method_t::mean ? CV_32FC(channels) : CV_8UC(channels));
-            if(_mode == averaging_method_t::min)
-                _accumulator.setTo(255);
+            _accumulator = _empty_accumulator(channels);
             
             if(_mode == averaging_method_t::mode) {
-                spatial_histogram.resize(size_t(f.cols) * size_t(f.rows));
-                spatial_mutex.resize(size_t(f.cols));
+                const uint64_t values = uint64_t(f.cols) * uint64_t(f.rows) * channels;
+                
+                /// use the finest binning that still fits into memory
+                _mode_bins = 8;
+                for(uint32_t bins : { 256u, 64u, 32u, 16u }) {
+                    if(values * mode_bytes_per_value(bins) <= _mode_memory_limit) {
+                        _mode_bins = bins;
+                        break;
+                    }
+                }
+                
+                if(_mode_bins < 256) {
+                    FormatWarning("[AveragingAccumulator] Exact histograms for ", _size, "x", channels, " would need ", FileSize{values * mode_bytes_per_value(256)}.to_string(), " (limit is ", FileSize{_mode_memory_limit}.to_string(), "). Using ", _mode_bins, " bins per value instead (", FileSize{values * mode_bytes_per_value(_mode_bins)}.to_string(), "), which makes the background less accurate. Raise averaging_mode_memory_limit to avoid this.");
+                }
+                
+                _mode_shift = uint8_t(std::countr_zero(256u / _mode_bins));
+                _mode_counts.assign(values * _mode_bins, 0);
+                if(_mode_bins < 256)
+                    _mode_sums.assign(values * _mode_bins, 0);
+                else
+                    _mode_sums.clear();
+                
+                spatial_mutex.resize(size_t((uint64_t(f.rows) + mode_rows_per_lock - 1) / mode_rows_per_lock));
                 for(auto &m : spatial_mutex)
                     m = std::make_unique<std::mutex>();
-                for(uint64_t i=0; i<spatial_histogram.size(); ++i) {
-                    std::fill(spatial_histogram.at(i).begin(), spatial_histogram.at(i).end(), RGB{0, 0, 0});
-                }
             }
+            
+            _initialized.store(true, std::memory_order_release);
         }
     }
     
-    if(_mode == averaging_method_t::mean) {
-        if constexpr(threaded) {
-            std::lock_guard guard(_accumulator_mutex);
-            f.convertTo(_float_mat, CV_32FC(channels));
-            cv::add(_accumulator, _float_mat, _accumulator);
-            ++count;
-        } else {
-            f.convertTo(_float_mat, CV_32FC(channels));
-            cv::add(_accumulator, _float_mat, _accumulator);
-            ++count;
-        }
-        
-    } else if(_mode == averaging_method_t::mode) {
+    if(_mode == averaging_method_t::mode) {
         assert(f.isContinuous());
         assert(f.type() == CV_8UC(channels));
+        assert(_mode_counts.size() == uint64_t(f.cols) * uint64_t(f.rows) * channels * _mode_bins);
         
-        /// TODO: multiple channels will have weird results here
-        const uchar* ptr = (const uchar*)f.data;
-        auto array_ptr = spatial_histogram.data();
-        const auto end = spatial_histogram.data() + uint64_t(f.cols) * uint64_t(f.rows);
-        auto mutex_ptr = spatial_mutex.begin(); //! one lock per line
-        //thread_local Timing timing("MutexSwitch", 0.001);
-        //thread_local Timing mtiming("MutexLock", 0.001);
-        
-        assert(spatial_histogram.size() == uint64_t(f.cols) * uint64_t(f.rows));
         if constexpr(threaded) {
-            //timing.start_measure();
-            (*mutex_ptr)->lock();
-            
-            for (size_t x = 0; array_ptr != end; ptr += channels, ++array_ptr, ++x) {
-                if(x >= size_t(f.cols) * 100) {
-                    x = 0;
-                    
-                    (*mutex_ptr)->unlock();
-                    //timing.conclude_measure();
-                    
-                    //mtiming.start_measure();
-                    ++mutex_ptr;
-                    (*mutex_ptr)->lock();
-                    //mtiming.conclude_measure();
-                    
-                    //timing.start_measure();
-                }
-                
-                if(channels == 1) {
-                    ++(*array_ptr)[*(ptr + 0)][0];
-                } else {
-                    assert(channels == 3);
-                    ++(*array_ptr)[*(ptr + 0)][0];
-                    ++(*array_ptr)[*(ptr + 1)][1];
-                    ++(*array_ptr)[*(ptr + 2)][2];
-                }
-            }
-            
-            if(mutex_ptr == spatial_mutex.end())
-                throw RuntimeError("Should not be past end");
-            (*mutex_ptr)->unlock();
-            //timing.conclude_measure();
-            
+            _add_mode_threaded(f);
         } else {
-            for (; array_ptr != end; ptr += channels, ++array_ptr) {
-                if(channels == 1) {
-                    ++(*array_ptr)[*(ptr + 0)][0];
-                } else {
-                    assert(channels == 3);
-                    ++(*array_ptr)[*(ptr + 0)][0];
-                    ++(*array_ptr)[*(ptr + 1)][1];
-                    ++(*array_ptr)[*(ptr + 2)][2];
-                }
-            }
+            _add_mode((const uchar*)f.data, 0, uint64_t(f.cols) * uint64_t(f.rows), channels);
         }
         
-    } else if(_mode == averaging_method_t::max) {
-        if constexpr(threaded) {
-            std::lock_guard guard(_accumulator_mutex);
-            cv::max(_accumulator, f, _accumulator);
-        } else
-            cv::max(_accumulator, f, _accumulator);
+    } else if constexpr(threaded) {
+        /// the shard is only ever contended by finalize()
+        auto& shard = _local_shard();
+        std::lock_guard guard(shard.mutex);
+        if(shard.accumulator.empty())
+            shard.accumulator = _empty_accumulator(channels);
+        _accumulate(shard.accumulator, shard.float_mat, shard.count, f);
         
-    } else if(_mode == averaging_method_t::min) {
-        if constexpr(threaded) {
-            std::lock_guard guard(_accumulator_mutex);
-            cv::min(_accumulator, f, _accumulator);
-        } else
-            cv::min(_accumulator, f, _accumulator);
+    } else {
+        _accumulate(_accumulator, _float_mat, count, f);
+    }
+}
+
+void AveragingAccumulator::_add_mode_threaded(const Mat& f) {
+    const uchar* ptr = (const uchar*)f.data;
+    const uint64_t N = uint64_t(f.cols) * uint64_t(f.rows);
+    const uint64_t block = uint64_t(f.cols) * mode_rows_per_lock;
+    const size_t blocks = spatial_mutex.size();
+    const uint8_t channels = f.channels();
+    
+    auto add_block = [&](size_t i) {
+        const uint64_t start = uint64_t(i) * block;
+        _add_mode(ptr, start, min(N, start + block), channels);
+    };
+    
+    /// every call starts at a different block of rows and skips blocks
+    /// that are currently locked by other threads, so threads do not
+    /// convoy behind each other on the same sequence of locks.
+    thread_local std::vector<size_t> pending;
+    pending.clear();
+    
+    const size_t first = _mode_start_block.fetch_add(1, std::memory_order_relaxed) % blocks;
+    for(size_t j = 0; j < blocks; ++j)
+        pending.push_back((first + j) % blocks);
+    
+    while(not pending.empty()) {
+        bool progress = false;
+        for(auto it = pending.begin(); it != pending.end(); ) {
+            auto& mutex = *spatial_mutex[*it];
+            if(mutex.try_lock()) {
+                std::lock_guard guard(mutex, std::adopt_lock);
+                add_block(*it);
+                it = pending.erase(it);
+                progress = true;
+            } else
+                ++it;
+        }
         
-    } else
-        throw U_EXCEPTION("Unknown averaging_method ", _mode.name());
+        if(not progress) {
+            /// everything we still need is busy, so wait for one of them
+            const size_t i = pending.front();
+            std::lock_guard guard(*spatial_mutex[i]);
+            add_block(i);
+            pending.erase(pending.begin());
+        }
+    }
+}
+
+void AveragingAccumulator::_add_mode(const uchar* ptr, uint64_t start, uint64_t end, uint8_t channels) {
+    const uint64_t bins = _mode_bins;
+    const uint8_t shift = _mode_shift;
+    uint16_t* counts = _mode_counts.data();
+    uint32_t* sums = _mode_sums.empty() ? nullptr : _mode_sums.data();
+    
+    /// every channel of every pixel has its own histogram
+    for(uint64_t i = start * channels; i < end * channels; ++i) {
+        const uchar value = ptr[i];
+        const uint64_t offset = i * bins;
+        const uint64_t bin = offset + (value >> shift);
+        
+        if(sums)
+            sums[bin] += value;
+        
+        if(++counts[bin] == std::numeric_limits<uint16_t>::max()) {
+            /// halve the histogram so counters cannot overflow. this keeps
+            /// the ratios between bins (and the means within them) intact.
+            for(uint64_t b = offset; b < offset + bins; ++b) {
+                counts[b] >>= 1;
+                if(sums)
+                    sums[b] >>= 1;
+            }
+        }
+    }
 }
 
 std::unique_ptr<cmn::Image> AveragingAccumulator::finalize() {
     std::lock_guard guard(_accumulator_mutex);
+    
+    /// reduce the per-thread partial accumulators into the main one
+    if(_mode != averaging_method_t::mode) {
+        std::lock_guard shards_guard(_shards_mutex);
+        for(auto& [id, shard] : _shards) {
+            std::lock_guard shard_guard(shard->mutex);
+            if(shard->accumulator.empty())
+                continue;
+            
+            if(_mode == averaging_method_t::mean) {
+                cv::add(_accumulator, shard->accumulator, _accumulator);
+                count += shard->count;
+            } else if(_mode == averaging_method_t::max) {
+                cv::max(_accumulator, shard->accumulator, _accumulator);
+            } else if(_mode == averaging_method_t::min) {
+                cv::min(_accumulator, shard->accumulator, _accumulator);
+            }
+            
+            /// samples are now part of _accumulator
+            shard->accumulator = _empty_accumulator(shard->accumulator.channels());
+            shard->count = 0;
+        }
+    }
+    
     auto image = std::make_unique<cmn::Image>(_accumulator.rows, _accumulator.cols, _accumulator.channels());
     
     if(_mode == averaging_method_t::mean) {
@@ -158,31 +276,33 @@ std::unique_ptr<cmn::Image> AveragingAccumulator::finalize() {
         _local.convertTo(image->get(), CV_8UC(_local.channels()));
         
     } else if(_mode == averaging_method_t::mode) {
-        //_accumulator.copyTo(image->get());
-        
         auto ptr = image->data();
-        auto array_ptr = spatial_histogram.data();
-        const auto end = spatial_histogram.data() + uint64_t(image->cols) * uint64_t(image->rows);
+        const uint64_t values = uint64_t(image->cols) * uint64_t(image->rows) * uint64_t(image->channels());
+        const uint64_t bins = _mode_bins;
+        const uint8_t shift = _mode_shift;
+        const uint16_t* counts = _mode_counts.data();
+        const uint32_t* sums = _mode_sums.empty() ? nullptr : _mode_sums.data();
         
-        const uint8_t channels = image->channels();
-        for (; array_ptr != end; ptr += channels, ++array_ptr) {
-            if(channels == 1) {
-                *ptr = std::distance(array_ptr->begin(), std::max_element(array_ptr->begin(), array_ptr->end(), [](const RGB& A, const RGB& B) {
-                    return A[0] < B[0];
-                }));
-            } else {
-                /// this is very inefficient
-                assert(channels == 3);
-                *(ptr + 0) = std::distance(array_ptr->begin(), std::max_element(array_ptr->begin(), array_ptr->end(), [](const RGB& A, const RGB& B) {
-                    return A[0] < B[0];
-                }));
-                *(ptr + 1) = std::distance(array_ptr->begin(), std::max_element(array_ptr->begin(), array_ptr->end(), [](const RGB& A, const RGB& B) {
-                    return A[1] < B[1];
-                }));
-                *(ptr + 2) = std::distance(array_ptr->begin(), std::max_element(array_ptr->begin(), array_ptr->end(), [](const RGB& A, const RGB& B) {
-                    return A[2] < B[2];
-                }));
-            }
+        if(bins > 0) {
+            assert(_mode_counts.size() == values * bins);
+            
+            distribute_indexes([&](auto, uint64_t start, uint64_t end, auto) {
+                for(uint64_t i = start; i < end; ++i) {
+                    const uint16_t* histogram = counts + i * bins;
+                    const uint64_t best = uint64_t(std::distance(histogram, std::max_element(histogram, histogram + bins)));
+                    
+                    if(not sums) {
+                        ptr[i] = uchar(best);
+                    } else if(histogram[best] == 0) {
+                        ptr[i] = uchar(best << shift);
+                    } else {
+                        /// mean of all samples inside the fullest bin
+                        const uint32_t n = histogram[best];
+                        ptr[i] = uchar((sums[i * bins + best] + n / 2u) / n);
+                    }
+                }
+                
+            }, finalize_pool(), uint64_t(0), values);
         }
         
     } else
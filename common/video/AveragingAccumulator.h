@@ -20,22 +20,55 @@ protected:
     Size2 _size;
     
     std::mutex _accumulator_mutex;
+    std::atomic<bool> _initialized{false};
     
-    using RGB = std::array<uint32_t, 3>;
-    std::vector<std::array<RGB, 256>> spatial_histogram;
+    /// add_threaded() accumulates mean / min / max into one partial
+    /// accumulator per thread, which are only reduced in finalize().
+    struct Shard {
+        std::mutex mutex;
+        Mat accumulator;
+        Mat float_mat;
+        double count = 0;
+    };
+    const uint64_t _id;
+    std::mutex _shards_mutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<Shard>> _shards;
+    
+    /// averaging_method_t::mode keeps one compact histogram per pixel
+    /// and channel. If the exact (256 bins) histograms would exceed
+    /// the memory limit, values are binned more coarsely and the mode
+    /// is estimated as the mean of all samples in the fullest bin.
+    uint64_t _mode_memory_limit;
+    uint32_t _mode_bins{0};
+    uint8_t _mode_shift{0};
+    std::vector<uint16_t> _mode_counts;
+    std::vector<uint32_t> _mode_sums;
     std::vector<std::unique_ptr<std::mutex>> spatial_mutex;
+    std::atomic<uint32_t> _mode_start_block{0};
     
 public:
+    //! Default upper bound for the histograms of averaging_method_t::mode (4GB).
+    static constexpr uint64_t default_mode_memory_limit = uint64_t(4) * 1024u * 1024u * 1024u;
+    
+    //! Reads averaging_method and averaging_mode_memory_limit (in bytes) from the settings.
     AveragingAccumulator();
-    AveragingAccumulator(averaging_method_t::Class mode);
+    AveragingAccumulator(averaging_method_t::Class mode, uint64_t mode_memory_limit = default_mode_memory_limit);
     
     void add(const Mat &f);
     void add_threaded(const Mat &f);
     
     std::unique_ptr<cmn::Image> finalize();
     
+    //! Number of histogram bins per pixel and channel (256 = exact mode, 0 = not initialized).
+    uint32_t mode_bins() const { return _mode_bins; }
+    
 private:
     template<bool threaded> void _add(const Mat& f);
+    void _add_mode(const uchar* ptr, uint64_t start, uint64_t end, uint8_t channels);
+    void _add_mode_threaded(const Mat& f);
+    void _accumulate(Mat& accumulator, Mat& float_mat, double& samples, const Mat& f) const;
+    Mat _empty_accumulator(int channels) const;
+    Shard& _local_shard();
 };
 
 }
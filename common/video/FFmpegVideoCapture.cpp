@@ -1,7 +1,9 @@
 #include "FFmpegVideoCapture.h"
 #include <misc/Path.h>
 #include <misc/Timer.h>
+#include <misc/Trace.h>
 #include <file/ask_for_permission.h>
+#include <video/KeyframeIndex.h>
 
 //#undef NDEBUG
 //#define DEBUG_FFMPEG_PACKETS
@@ -12,6 +14,49 @@ namespace cmn {
 IMPLEMENT(FfmpegVideoCapture::tested_video_lengths);
 IMPLEMENT(FfmpegVideoCapture::tested_video_lengths_mutex);
 
+/**
+ * Ring of decoded frames. Slot i % N holds frame i once it is ready;
+ * the background thread decodes frames [next, base + N) in order and
+ * read() moves base forward as it consumes frames. A slot only belongs to
+ * the background thread while its index is -1 and it is the next slot.
+ */
+struct FfmpegVideoCapture::Prefetcher {
+    struct Slot {
+        Image image;
+        int64_t index{-1};
+        bool ok{false};
+    };
+
+    std::vector<Slot> slots;
+    std::mutex mutex;
+    std::condition_variable work, ready;
+
+    //! frames before base are not needed anymore
+    int64_t base{0};
+    //! next frame to be decoded
+    int64_t next{0};
+    //! channels of the decoded images (0 = nothing requested yet)
+    uint channels{0};
+    //! incremented whenever prefetching starts over somewhere else
+    uint64_t generation{0};
+    bool terminate{false};
+
+    PrefetchStats stats;
+    std::thread thread;
+
+    Prefetcher(size_t frames) : slots(frames) {}
+};
+
+std::string FfmpegVideoCapture::PrefetchStats::toStr() const {
+    return "PrefetchStats<hits:" + Meta::toStr(hits)
+        + " misses:" + Meta::toStr(misses)
+        + " restarts:" + Meta::toStr(restarts)
+        + " decoded:" + Meta::toStr(decoded)
+        + " wait:" + Meta::toStr(wait_seconds) + "s"
+        + " decode:" + Meta::toStr(decode_seconds) + "s"
+        + " hit_rate:" + Meta::toStr(hit_rate()) + ">";
+}
+
 std::string error_to_string(int ret) {
     char errbuf[128] = {0};
 
@@ -34,6 +79,8 @@ FfmpegVideoCapture::FfmpegVideoCapture(const std::string& filePath) {
 }
 
 bool FfmpegVideoCapture::open(const std::string& filePath) {
+    disable_prefetch();
+    
     //av_log_set_level(AV_LOG_DEBUG);
     // Allocate format context
     formatContext = avformat_alloc_context();
@@ -252,6 +299,7 @@ bool FfmpegVideoCapture::is_greyscale() const {
 }
 
 void FfmpegVideoCapture::recovered_error(const std::string_view& str) const {
+    std::unique_lock guard(_recovered_errors_mutex);
     if(not _recovered_errors.contains(str))
         _recovered_errors.insert(str);
 }
@@ -520,10 +568,23 @@ bool FfmpegVideoCapture::seek_frame(uint32_t frameIndex) {
 
     int64_t received_frame = -1;
 
+    if (not _keyframes)
+        _keyframes = KeyframeIndex::find(_filePath);
+    const auto keyframe = _keyframes
+        ? _keyframes->at_or_before(frameIndex)
+        : std::nullopt;
+
     // Determine if we should seek or decode sequentially
-    if (current_frame < static_cast<int64_t>(frameIndex)
-        && abs(static_cast<int64_t>(frameIndex) - current_frame) <= keyframe_interval)
-    {
+    bool sequential = current_frame < static_cast<int64_t>(frameIndex);
+    if (keyframe) {
+        // seeking would decode from the keyframe, so only do that if it
+        // comes after the current frame
+        sequential = sequential && current_frame + 1 >= keyframe->frame;
+    } else {
+        sequential = sequential && abs(static_cast<int64_t>(frameIndex) - current_frame) <= keyframe_interval;
+    }
+
+    if (sequential) {
         received_frame = current_frame;
 
 #ifdef DEBUG_FFMPEG_FRAMES
@@ -531,8 +592,10 @@ bool FfmpegVideoCapture::seek_frame(uint32_t frameIndex) {
 #endif
 
     } else {
-        // If far away, seek directly to the calculated timestamp
-        int64_t timestamp = av_rescale_q(max(0, static_cast<int64_t>(frameIndex)), av_inv_q(frame_rate), time_base);
+        // If far away, seek directly to the keyframe (or the calculated timestamp)
+        int64_t timestamp = keyframe
+            ? keyframe->pts
+            : av_rescale_q(max(0, static_cast<int64_t>(frameIndex)), av_inv_q(frame_rate), time_base);
 
 #ifdef DEBUG_FFMPEG_FRAMES
         Print("[seek_frame] Seeking to timestamp ", timestamp, " for frame ", frameIndex);
@@ -805,6 +868,7 @@ bool FfmpegVideoCapture::decode_frame(Mat& outFrame) {
 
 template<typename Mat>
 bool FfmpegVideoCapture::_read(uint32_t frameIndex, Mat& outFrame) {
+    CMN_TRACE_SCOPE_ARG("FfmpegVideoCapture::read", frameIndex);
     if (!is_open())
         return false;
     if(frameIndex >= length()) {
@@ -815,7 +879,11 @@ bool FfmpegVideoCapture::_read(uint32_t frameIndex, Mat& outFrame) {
     }
 
     static Timing timing("ffmpeg::read_frame");
-    if(seek_frame(frameIndex)) {
+    if(_prefetcher) {
+        if(read_prefetched(frameIndex, outFrame))
+            return true;
+        
+    } else if(seek_frame(frameIndex)) {
         TakeTiming take(timing);
         
         if(current_frame == frameIndex) {
@@ -844,12 +912,165 @@ bool FfmpegVideoCapture::_read(uint32_t frameIndex, Mat& outFrame) {
     return false;
 }
 
+template<typename Mat>
+bool FfmpegVideoCapture::read_prefetched(uint32_t frameIndex, Mat& outFrame) {
+    auto& p = *_prefetcher;
+    const uint channels = outFrame.channels();
+    if(channels == 0)
+        throw InvalidArgumentException("Image is empty. Please create it - at least with the right number of requested channels - before calling this function.");
+    
+    const int64_t index = frameIndex;
+    const int64_t N = p.slots.size();
+    auto& slot = p.slots[index % N];
+    
+    std::unique_lock guard(p.mutex);
+    if(slot.index == index && p.channels == channels) {
+        ++p.stats.hits;
+        
+    } else {
+        ++p.stats.misses;
+        
+        /// the background thread would need too long to get there
+        /// sequentially, so start over at the requested frame
+        if(p.channels != channels
+           || index < p.base
+           || index >= p.next + N)
+        {
+            ++p.stats.restarts;
+            ++p.generation;
+            p.channels = channels;
+            p.base = p.next = index;
+            for(auto &s : p.slots)
+                s.index = -1;
+        }
+        
+        p.base = max(p.base, index);
+        p.work.notify_one();
+        
+        Timer timer;
+        p.ready.wait(guard, [&]() {
+            return slot.index == index || p.terminate;
+        });
+        p.stats.wait_seconds += timer.elapsed();
+        
+        if(slot.index != index)
+            return false;
+    }
+    
+    const bool ok = slot.ok;
+    if(ok) {
+        if constexpr(std::is_same_v<Mat, Image>) {
+            /// the slot continues with the caller's previous buffer
+            std::swap(outFrame, slot.image);
+        } else {
+            slot.image.get().copyTo(outFrame);
+        }
+    }
+    
+    slot.index = -1;
+    p.base = max(p.base, index + 1);
+    p.work.notify_one();
+    return ok;
+}
+
+void FfmpegVideoCapture::prefetch_loop() {
+    set_thread_name("FfmpegVideoCapture::prefetch");
+    
+    auto& p = *_prefetcher;
+    const int64_t N = p.slots.size();
+    const int64_t L = length() >= 0 ? length() : std::numeric_limits<int64_t>::max();
+    const auto size = dimensions();
+    
+    std::unique_lock guard(p.mutex);
+    while(true) {
+        p.work.wait(guard, [&]() {
+            return p.terminate
+                || (p.channels > 0 && p.next < min(L, p.base + N));
+        });
+        if(p.terminate)
+            break;
+        
+        const int64_t index = p.next;
+        const uint64_t generation = p.generation;
+        const uint channels = p.channels;
+        auto& slot = p.slots[index % N];
+        slot.index = -1;
+        guard.unlock();
+        
+        Timer timer;
+        bool ok = false;
+        try {
+            if(slot.image.channels() != channels)
+                slot.image.create(uint(size.height), uint(size.width), channels);
+            
+            if(seek_frame(narrow_cast<uint32_t>(index))
+               && current_frame == index)
+            {
+                ok = decode_frame(slot.image);
+                av_frame_unref(frame);
+            }
+        } catch(const std::exception& ex) {
+            FormatExcept("[FFMPEG] Cannot prefetch frame ", index, " of ", _filePath, ": ", ex.what());
+        }
+        const double seconds = timer.elapsed();
+        
+        guard.lock();
+        p.stats.decode_seconds += seconds;
+        ++p.stats.decoded;
+        
+        /// read() started over somewhere else in the meantime
+        if(generation != p.generation)
+            continue;
+        
+        slot.index = index;
+        slot.ok = ok;
+        ++p.next;
+        p.ready.notify_all();
+    }
+}
+
+void FfmpegVideoCapture::enable_prefetch(size_t frames) {
+    disable_prefetch();
+    if(frames == 0)
+        return;
+    if(not is_open())
+        throw U_EXCEPTION("Cannot prefetch frames of ", _filePath, " since it is not open.");
+    
+    _prefetcher = std::make_unique<Prefetcher>(frames);
+    _prefetcher->thread = std::thread([this]() { prefetch_loop(); });
+}
+
+void FfmpegVideoCapture::disable_prefetch() {
+    if(not _prefetcher)
+        return;
+    
+    {
+        std::unique_lock guard(_prefetcher->mutex);
+        _prefetcher->terminate = true;
+    }
+    _prefetcher->work.notify_all();
+    _prefetcher->ready.notify_all();
+    _prefetcher->thread.join();
+    _prefetcher = nullptr;
+}
+
+FfmpegVideoCapture::PrefetchStats FfmpegVideoCapture::prefetch_stats() const {
+    if(not _prefetcher)
+        return {};
+    std::unique_lock guard(_prefetcher->mutex);
+    return _prefetcher->stats;
+}
+
 FfmpegVideoCapture::~FfmpegVideoCapture() {
     close();
 }
 
 void FfmpegVideoCapture::close() {
+    disable_prefetch();
     _capture = nullptr;
+    _keyframes = nullptr;
+    current_frame = -1;
+    last_seq_received_frame.reset();
 
     if (pkt) {
         av_packet_free(&pkt);
@@ -16,8 +16,35 @@ extern "C" {
 
 namespace cmn {
 
+class KeyframeIndex;
+
 class FfmpegVideoCapture {
+public:
+    struct PrefetchStats {
+        //! frames that were already decoded when read() asked for them
+        uint64_t hits{0};
+        //! frames that read() had to wait for
+        uint64_t misses{0};
+        //! reads outside of the prefetched range, where prefetching started over
+        uint64_t restarts{0};
+        //! frames decoded by the background thread
+        uint64_t decoded{0};
+        //! time read() spent waiting for frames
+        double wait_seconds{0};
+        //! time the background thread spent decoding
+        double decode_seconds{0};
+
+        double hit_rate() const {
+            return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0;
+        }
+
+        std::string toStr() const;
+        static std::string class_name() { return "FfmpegVideoCapture::PrefetchStats"; }
+    };
+
+private:
     std::unique_ptr<cv::VideoCapture> _capture;
+    mutable std::mutex _recovered_errors_mutex;
     mutable std::set<std::string_view> _recovered_errors;
     std::once_flag skip_message_flag;
     struct VideoTestResults {
@@ -31,7 +58,10 @@ public:
     FfmpegVideoCapture(const std::string& filePath);
     ~FfmpegVideoCapture();
 
-    std::set<std::string_view> recovered_errors() const { return _recovered_errors; }
+    std::set<std::string_view> recovered_errors() const {
+        std::unique_lock guard(_recovered_errors_mutex);
+        return _recovered_errors;
+    }
     bool is_open() const;
     int64_t length() const;
     Size2 dimensions() const;
@@ -45,6 +75,20 @@ public:
     
     void close();
     bool open(const std::string& filePath);
+    
+    /**
+     * Decodes up to `frames` frames ahead of the last read() on a background
+     * thread, into a ring of Images. Reading the next frames then only swaps
+     * (Image) or copies (cv::Mat, gpuMat) a finished frame, and a read() that
+     * is not close to the last one restarts prefetching from there.
+     * The decoder is owned by the background thread while this is enabled, so
+     * read() must still only be called from one thread at a time.
+     * 0 frames disables prefetching.
+     */
+    void enable_prefetch(size_t frames);
+    void disable_prefetch();
+    bool prefetching() const { return _prefetcher != nullptr; }
+    PrefetchStats prefetch_stats() const;
 
 private:
     AVFormatContext* formatContext = nullptr;
@@ -69,6 +113,11 @@ private:
     std::optional<int64_t> last_seq_received_frame;
     
     std::string _filePath;
+    //! set once the keyframe index of the file is available
+    std::shared_ptr<const KeyframeIndex> _keyframes;
+    
+    struct Prefetcher;
+    std::unique_ptr<Prefetcher> _prefetcher;
 
     bool seek_frame(uint32_t frameIndex);
     bool transfer_frame_to_software(AVFrame* frame);
@@ -84,6 +133,10 @@ private:
     template<typename Mat>
     bool decode_frame(Mat& mat);
     
+    template<typename Mat>
+    bool read_prefetched(uint32_t frameIndex, Mat& mat);
+    void prefetch_loop();
+    
 private:
     void recovered_error(const std::string_view&) const;
     void log_packet(const AVPacket *pkt);
@@ -0,0 +1,160 @@
+#include "FrameCache.h"
+
+namespace cmn {
+
+std::string FrameCache::Stats::toStr() const {
+    return "FrameCache<hits:" + Meta::toStr(hits)
+        + " misses:" + Meta::toStr(misses)
+        + " hit_rate:" + Meta::toStr(hit_rate() * 100.0) + "%"
+        + " evictions:" + Meta::toStr(evictions)
+        + " entries:" + Meta::toStr(entries)
+        + " size:" + Meta::toStr(FileSize{bytes}) + ">";
+}
+
+size_t FrameCache::KeyHash::operator()(const Key& key) const {
+    size_t h = std::hash<std::string>{}(key.file);
+    h ^= std::hash<int64_t>{}(key.frame) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h ^= size_t(key.channels) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+FrameCache::FrameCache(uint64_t budget)
+    : _budget(budget)
+{ }
+
+FrameCache& FrameCache::instance() {
+    static FrameCache cache;
+    return cache;
+}
+
+void FrameCache::set_budget(uint64_t bytes) {
+    std::unique_lock guard(_mutex);
+    _budget = bytes;
+    evict(0);
+}
+
+uint64_t FrameCache::budget() const {
+    return _budget.load(std::memory_order_relaxed);
+}
+
+FrameCache::Stats FrameCache::stats() const {
+    std::unique_lock guard(_mutex);
+    return _stats;
+}
+
+Image::SPtr FrameCache::find(const Key& key) {
+    if(not enabled())
+        return nullptr;
+
+    std::unique_lock guard(_mutex);
+    auto it = _index.find(key);
+    if(it == _index.end()) {
+        ++_stats.misses;
+        return nullptr;
+    }
+
+    ++_stats.hits;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return it->second->image;
+}
+
+bool FrameCache::get(const Key& key, Image& output) {
+    auto image = find(key);
+    if(not image)
+        return false;
+
+    /// nobody modifies the image while we hold a reference (see evict)
+    if(image->rows != output.rows || image->cols != output.cols || image->dims != output.dims)
+        output.create(image->rows, image->cols, image->dims);
+    std::memcpy(output.data(), image->data(), image->size());
+    return true;
+}
+
+bool FrameCache::get(const Key& key, cv::Mat& output) {
+    auto image = find(key);
+    if(not image)
+        return false;
+    image->get().copyTo(output);
+    return true;
+}
+
+void FrameCache::put(const Key& key, const Image& image) {
+    insert(key, image, image.size());
+}
+
+void FrameCache::put(const Key& key, const cv::Mat& image) {
+    if(image.type() != CV_8UC(image.channels()) || not image.isContinuous())
+        return;
+    insert(key, image, uint64_t(image.total()) * uint64_t(image.elemSize()));
+}
+
+template<typename Source>
+void FrameCache::insert(const Key& key, const Source& source, uint64_t bytes) {
+    if(bytes == 0 || bytes > budget())
+        return;
+
+    Image::SPtr image;
+    {
+        std::unique_lock guard(_mutex);
+        if(bytes > _budget || _index.contains(key))
+            return;
+        /// make room first, so that an evicted buffer can be reused
+        image = evict(bytes);
+    }
+
+    /// copy outside of the lock
+    if(not image)
+        image = std::make_shared<Image>();
+    image->create(source);
+
+    std::unique_lock guard(_mutex);
+    if(bytes > _budget || _index.contains(key))
+        return;
+
+    evict(bytes);
+    _entries.push_front(Entry{ .key = key, .image = std::move(image) });
+    _index[key] = _entries.begin();
+    _stats.bytes += bytes;
+    ++_stats.entries;
+}
+
+Image::SPtr FrameCache::evict(uint64_t bytes_needed) {
+    Image::SPtr reuse;
+    while(not _entries.empty() && _stats.bytes + bytes_needed > _budget) {
+        auto& entry = _entries.back();
+        _stats.bytes -= entry.image->size();
+        --_stats.entries;
+        ++_stats.evictions;
+
+        /// images are only reused if no get() is still copying from them
+        if(entry.image.use_count() == 1)
+            reuse = std::move(entry.image);
+
+        _index.erase(entry.key);
+        _entries.pop_back();
+    }
+    return reuse;
+}
+
+void FrameCache::erase(const std::string& file) {
+    std::unique_lock guard(_mutex);
+    for(auto it = _entries.begin(); it != _entries.end(); ) {
+        if(it->key.file == file) {
+            _stats.bytes -= it->image->size();
+            --_stats.entries;
+            _index.erase(it->key);
+            it = _entries.erase(it);
+        } else
+            ++it;
+    }
+}
+
+void FrameCache::clear() {
+    std::unique_lock guard(_mutex);
+    _entries.clear();
+    _index.clear();
+    _stats.bytes = 0;
+    _stats.entries = 0;
+}
+
+}
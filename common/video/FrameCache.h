@@ -0,0 +1,106 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/Image.h>
+
+namespace cmn {
+
+/**
+ * Decoded video frames, shared by all VideoSources of the process, so that
+ * going back and forth between nearby frames (or switching between files)
+ * does not have to seek and decode again. Frames are evicted in
+ * least-recently-used order once the cache holds more than its budget.
+ *
+ * Frames are copied in and out, so callers never share buffers with the
+ * cache. Thread-safe; copies happen outside of the lock.
+ *
+ * The cache is off (budget 0) by default: plain sequential decoding never
+ * hits it, and would only pay for an extra copy of every frame. VideoSource
+ * enables it through the frame_cache_budget setting (in bytes).
+ */
+class FrameCache {
+public:
+    struct Key {
+        std::string file;
+        int64_t frame;
+        //! frames are stored as they were read (greyscale or color)
+        uint8_t channels;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+        uint64_t bytes{0};
+        uint64_t entries{0};
+
+        double hit_rate() const {
+            return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0;
+        }
+
+        std::string toStr() const;
+        static std::string class_name() { return "FrameCache::Stats"; }
+    };
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        Image::SPtr image;
+    };
+
+    mutable std::mutex _mutex;
+    //! most recently used first
+    std::list<Entry> _entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index;
+    std::atomic<uint64_t> _budget;
+    Stats _stats;
+
+public:
+    static constexpr uint64_t default_budget = 0;
+
+    explicit FrameCache(uint64_t budget = default_budget);
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    //! The cache used by VideoSource.
+    static FrameCache& instance();
+
+    //! Maximum number of bytes of all frames. Evicts immediately if necessary, 0 disables the cache.
+    void set_budget(uint64_t bytes);
+    uint64_t budget() const;
+    //! Same as budget() > 0, without locking.
+    bool enabled() const { return _budget.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * Copies the cached frame into output (resizing it if necessary), or
+     * returns false and leaves output untouched.
+     */
+    bool get(const Key& key, Image& output);
+    bool get(const Key& key, cv::Mat& output);
+
+    //! Copies a frame into the cache (does nothing if it is already cached).
+    void put(const Key& key, const Image& image);
+    void put(const Key& key, const cv::Mat& image);
+
+    //! Removes all frames of the given file.
+    void erase(const std::string& file);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    //! returns the cached frame and marks it as recently used, or nullptr
+    Image::SPtr find(const Key& key);
+    template<typename Source>
+    void insert(const Key& key, const Source& image, uint64_t bytes);
+    //! needs the lock, returns the last evicted image if nobody else holds it
+    Image::SPtr evict(uint64_t bytes_needed);
+};
+
+}
@@ -0,0 +1,264 @@
+#include "KeyframeIndex.h"
+#include <misc/ThreadPool.h>
+#include <misc/SettingHandle.h>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+    #include <libavutil/mathematics.h>
+}
+
+namespace cmn {
+
+namespace {
+
+constexpr std::array<char, 8> magic{'C', 'M', 'N', 'K', 'F', 'I', '0', '1'};
+
+//! whether indexes are written to disk at all
+SettingHandle<bool> keyframe_index_save{"keyframe_index_save", true};
+//! where indexes are written (empty = next to the video)
+SettingHandle<file::Path> keyframe_index_directory{"keyframe_index_directory"};
+
+struct FileHeader {
+    std::array<char, 8> magic;
+    uint64_t file_size;
+    uint64_t last_modified;
+    uint64_t count;
+};
+
+/// indexes by video path: nullptr while they are being built or if building failed
+struct Registry {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const KeyframeIndex>> indexes;
+    std::atomic_bool cancel{false};
+    QueueThreadPool<file::Path> builder{1, [this](file::Path& video) {
+        {
+            /// find_or_build() might have been faster
+            std::unique_lock guard(mutex);
+            if(auto it = indexes.find(video.str());
+               it != indexes.end() && it->second)
+            {
+                return;
+            }
+        }
+        build(video);
+    }, "KeyframeIndex"};
+
+    /// builds, saves and stores the index of a video (blocking)
+    std::shared_ptr<const KeyframeIndex> build(const file::Path& video) {
+        auto index = KeyframeIndex::build(video, cancel);
+        if(not index)
+            return nullptr;
+
+        if(keyframe_index_save()) {
+            try {
+                index->save(video);
+            } catch(const std::exception& ex) {
+                FormatWarning("Cannot save keyframe index of ", video, ": ", ex.what());
+            }
+        }
+
+        std::unique_lock guard(mutex);
+        return indexes[video.str()] = std::move(index);
+    }
+
+    ~Registry() {
+        /// the builder thread is joined after this, and skips the rest
+        cancel = true;
+    }
+};
+
+Registry& registry() {
+    static Registry registry;
+    return registry;
+}
+
+}
+
+KeyframeIndex::KeyframeIndex(std::vector<Keyframe>&& keyframes)
+    : _keyframes(std::move(keyframes))
+{
+    std::sort(_keyframes.begin(), _keyframes.end(), [](const Keyframe& A, const Keyframe& B) {
+        return A.frame < B.frame;
+    });
+}
+
+std::optional<KeyframeIndex::Keyframe> KeyframeIndex::at_or_before(int64_t frame) const {
+    auto it = std::upper_bound(_keyframes.begin(), _keyframes.end(), frame, [](int64_t frame, const Keyframe& keyframe) {
+        return frame < keyframe.frame;
+    });
+    if(it == _keyframes.begin())
+        return std::nullopt;
+    return *std::prev(it);
+}
+
+file::Path KeyframeIndex::cache_path(const file::Path& video) {
+    auto directory = keyframe_index_directory.snapshot();
+    if(directory->empty())
+        return video.add_extension("keyframes");
+
+    /// videos with the same name in different folders get different indexes
+    const size_t hash = std::hash<std::string>{}(video.absolute().str());
+    return *directory / file::Path(video.filename() + "." + Meta::toStr(hash)).add_extension("keyframes");
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndex::find(const file::Path& video) {
+    if(video.empty())
+        return nullptr;
+
+    auto& r = registry();
+    std::unique_lock guard(r.mutex);
+    if(auto it = r.indexes.find(video.str());
+       it != r.indexes.end())
+    {
+        return it->second;
+    }
+
+    /// only local files are indexed (not streams)
+    auto& index = r.indexes[video.str()];
+    if(not video.exists())
+        return nullptr;
+
+    try {
+        index = load(video);
+    } catch(const std::exception& ex) {
+        FormatWarning("Ignoring keyframe index of ", video, ": ", ex.what());
+    }
+
+    if(not index)
+        r.builder.enqueue(video);
+    return index;
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndex::find_or_build(const file::Path& video) {
+    if(auto index = find(video))
+        return index;
+    if(video.empty() || not video.exists())
+        return nullptr;
+
+    /// find() queued a build in the background as well, which skips the video unless it started already
+    return registry().build(video);
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndex::build(const file::Path& video, const std::atomic_bool& cancel) {
+    AVFormatContext* context = nullptr;
+    if(avformat_open_input(&context, video.c_str(), nullptr, nullptr) != 0)
+        return nullptr;
+
+    std::shared_ptr<const KeyframeIndex> result;
+    AVPacket* pkt = av_packet_alloc();
+
+    if(pkt && avformat_find_stream_info(context, nullptr) >= 0) {
+        /// the first video stream, same as FfmpegVideoCapture
+        int stream = -1;
+        for(unsigned i = 0; i < context->nb_streams; ++i) {
+            if(context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                stream = int(i);
+                break;
+            }
+        }
+        if(stream >= 0) {
+            /// same conversion as in FfmpegVideoCapture::seek_frame
+            const AVRational time_base = context->streams[stream]->time_base;
+            const AVRational frame_rate = av_guess_frame_rate(context, context->streams[stream], nullptr);
+
+            std::vector<Keyframe> keyframes;
+            bool cancelled = false;
+            while(av_read_frame(context, pkt) >= 0) {
+                if(pkt->stream_index == stream
+                   && (pkt->flags & AV_PKT_FLAG_KEY))
+                {
+                    const int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+                    if(pts != AV_NOPTS_VALUE) {
+                        keyframes.push_back(Keyframe{
+                            .frame = av_rescale_q(pts, time_base, av_inv_q(frame_rate)),
+                            .pts = pts
+                        });
+                    }
+                }
+                av_packet_unref(pkt);
+
+                if(cancel) {
+                    cancelled = true;
+                    break;
+                }
+            }
+
+            if(not cancelled)
+                result = std::make_shared<const KeyframeIndex>(std::move(keyframes));
+        }
+    }
+
+    av_packet_free(&pkt);
+    avformat_close_input(&context);
+    return result;
+}
+
+bool KeyframeIndex::save(const file::Path& video) const {
+    const FileHeader header{
+        .magic = magic,
+        .file_size = video.file_size(),
+        .last_modified = video.last_modified(),
+        .count = _keyframes.size()
+    };
+
+    auto path = cache_path(video);
+    if(auto folder = path.remove_filename();
+       not folder.empty() && not folder.exists())
+    {
+        folder.create_folder();
+    }
+
+    auto f = path.fopen("wb");
+    if(not f) {
+        /// e.g. videos on read-only media: the index is just not reused
+        if(errno == EACCES || errno == EROFS || errno == EPERM)
+            return false;
+        throw U_EXCEPTION("Cannot open ", path, ": ", (const char*)strerror(errno));
+    }
+
+    const size_t bytes = _keyframes.size() * sizeof(Keyframe);
+    if(f.write(&header, sizeof(header)) != sizeof(header)
+       || f.write(_keyframes.data(), bytes) != bytes)
+    {
+        f.reset();
+        path.delete_file();
+        throw U_EXCEPTION("Cannot write ", path, ": ", (const char*)strerror(errno));
+    }
+    return true;
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndex::load(const file::Path& video) {
+    auto path = cache_path(video);
+    if(not path.exists())
+        return nullptr;
+
+    auto f = path.fopen("rb");
+    if(not f)
+        return nullptr;
+
+    FileHeader header;
+    if(f.read(&header, sizeof(header)) != sizeof(header)
+       || header.magic != magic)
+    {
+        throw U_EXCEPTION(path, " is not a keyframe index.");
+    }
+
+    /// the video changed since the index was written
+    if(header.file_size != video.file_size()
+       || header.last_modified != video.last_modified())
+    {
+        return nullptr;
+    }
+
+    if(path.file_size() != sizeof(header) + header.count * sizeof(Keyframe))
+        throw U_EXCEPTION(path, " has the wrong size for ", header.count, " keyframes.");
+
+    std::vector<Keyframe> keyframes(header.count);
+    const size_t bytes = keyframes.size() * sizeof(Keyframe);
+    if(f.read(keyframes.data(), bytes) != bytes)
+        throw U_EXCEPTION(path, " is truncated.");
+
+    return std::make_shared<const KeyframeIndex>(std::move(keyframes));
+}
+
+}
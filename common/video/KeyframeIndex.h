@@ -0,0 +1,67 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/Path.h>
+
+namespace cmn {
+
+/**
+ * Positions of all keyframes of the first video stream in a file, so that
+ * FfmpegVideoCapture can seek straight to the keyframe before a frame, and
+ * knows when decoding forward is cheaper than seeking.
+ *
+ * Building an index reads every packet of the file once (without decoding),
+ * so that happens on a background thread and the result is stored next to
+ * the video (<video>.keyframes) to be reused by later runs. Indexes are
+ * invalidated when the size or modification time of the video changes.
+ *
+ * Settings: keyframe_index_save (default true) switches writing indexes off,
+ * keyframe_index_directory (default empty) stores them in the given folder
+ * instead of next to the videos.
+ */
+class KeyframeIndex {
+public:
+    struct Keyframe {
+        //! index of the frame, same as in FfmpegVideoCapture::read
+        int64_t frame;
+        //! presentation timestamp in the time base of the stream
+        int64_t pts;
+    };
+
+private:
+    //! sorted by frame
+    std::vector<Keyframe> _keyframes;
+
+public:
+    KeyframeIndex() = default;
+    explicit KeyframeIndex(std::vector<Keyframe>&& keyframes);
+
+    size_t size() const { return _keyframes.size(); }
+    bool empty() const { return _keyframes.empty(); }
+    const std::vector<Keyframe>& keyframes() const { return _keyframes; }
+
+    //! Last keyframe at or before the given frame (if any).
+    std::optional<Keyframe> at_or_before(int64_t frame) const;
+
+    /**
+     * Returns the index for the given video if it is available, or nullptr.
+     * The first call for a video loads it from disk, or schedules building
+     * it in the background, after which later calls will find it.
+     * Cheap enough to be called before every seek.
+     */
+    static std::shared_ptr<const KeyframeIndex> find(const file::Path& video);
+
+    //! Same as find(), but builds the index right away (blocking) if there is none yet.
+    static std::shared_ptr<const KeyframeIndex> find_or_build(const file::Path& video);
+
+    //! Scans the whole video (blocking). Returns nullptr if cancelled or the video cannot be read.
+    static std::shared_ptr<const KeyframeIndex> build(const file::Path& video, const std::atomic_bool& cancel);
+
+    //! Where the index of the given video is stored (see keyframe_index_directory).
+    static file::Path cache_path(const file::Path& video);
+    static std::shared_ptr<const KeyframeIndex> load(const file::Path& video);
+    //! Returns false if the folder is not writable, throws for other errors.
+    bool save(const file::Path& video) const;
+};
+
+}
@@ -0,0 +1,248 @@
+#include "ParallelVideoReader.h"
+#include <video/VideoSource.h>
+#include <video/KeyframeIndex.h>
+#include <processing/encoding.h>
+
+namespace cmn {
+
+ParallelVideoReader::ParallelVideoReader(const VideoSource& source, Range<Frame_t> frames)
+    : ParallelVideoReader(source, frames, Options{})
+{ }
+
+ParallelVideoReader::ParallelVideoReader(const VideoSource& source, Range<Frame_t> frames, Options options)
+    : _source(source),
+      _range(frames),
+      _options(options),
+      _colors(source.colors()),
+      _next(frames.start)
+{
+    if(not _range.start.valid() || not _range.end.valid()
+       || _range.start > _range.end || _range.end > _source.length())
+    {
+        throw InvalidArgumentException("Invalid range ", _range.start, "-", _range.end, " for ", _source, ".");
+    }
+
+    Frame_t offset = 0_f;
+    for(auto file : _source._files_in_seq) {
+        _offsets.push_back(offset);
+        offset += file->length();
+    }
+    _offsets.push_back(offset);
+
+    const auto size = _source.size();
+    _frame_bytes = max(uint64_t(1), uint64_t(size.width) * uint64_t(size.height) * required_image_channels(_colors));
+
+    const size_t workers = _options.workers > 0
+        ? _options.workers
+        : size_t(cmn::hardware_concurrency());
+    _capacity = max(size_t(1), size_t(_options.max_buffered_bytes / _frame_bytes));
+
+    /// half of the buffer for the segments being worked on, half as slack
+    const auto segment_frames = _options.segment_frames > 0
+        ? _options.segment_frames
+        : max(Frame_t::number_t(1), Frame_t::number_t(_capacity / (2 * workers)));
+    split_into_segments(segment_frames);
+
+    const size_t N = min(workers, _segments.size());
+    for(size_t i = 0; i < N; ++i)
+        _threads.emplace_back(&ParallelVideoReader::run, this, i);
+}
+
+ParallelVideoReader::~ParallelVideoReader() {
+    {
+        std::unique_lock guard(_mutex);
+        _terminate = true;
+    }
+    _consumed.notify_all();
+    _produced.notify_all();
+
+    for(auto& thread : _threads)
+        thread.join();
+}
+
+void ParallelVideoReader::split_into_segments(Frame_t::number_t segment_frames) {
+    const Frame_t target(segment_frames);
+
+    for(size_t i = 0; i + 1 < _offsets.size(); ++i) {
+        /// the part of the range within this file
+        const Frame_t start = max(_range.start, _offsets[i]);
+        const Frame_t end = min(_range.end, _offsets[i + 1]);
+        if(start >= end)
+            continue;
+
+        auto file = _source._files_in_seq[i];
+        if(file->type() != VideoSource::File::VIDEO) {
+            /// single images: consecutive files can share a segment
+            if(not _segments.empty()
+               && _segments.back().end == start
+               && _segments.back().end - _segments.back().start < target)
+            {
+                _segments.back().end = end;
+            } else
+                _segments.push_back(Segment{ .start = start, .end = end });
+            continue;
+        }
+
+        /// a segment has to seek to its first frame, which is cheapest at keyframes.
+        /// the index is built right away if needed: scanning the packets once is a
+        /// lot cheaper than decoding from an unknown keyframe for every segment.
+        std::vector<Frame_t> cuts;
+        auto index = _options.segment_frames == 0
+            ? KeyframeIndex::find_or_build(file->filename())
+            : nullptr;
+        if(index && not index->empty()) {
+            Frame_t last = start;
+            for(auto& keyframe : index->keyframes()) {
+                if(keyframe.frame <= 0)
+                    continue;
+                const Frame_t frame = _offsets[i] + Frame_t(narrow_cast<Frame_t::number_t>(keyframe.frame));
+                if(frame <= start)
+                    continue;
+                if(frame >= end)
+                    break;
+                if(frame - last >= target) {
+                    cuts.push_back(frame);
+                    last = frame;
+                }
+            }
+        } else {
+            /// without keyframes, every segment decodes up to a whole GOP it does not need
+            const Frame_t length = _options.segment_frames > 0
+                ? target
+                : max(target, Frame_t(min_segment_frames_without_index));
+            for(Frame_t frame = start + length; frame < end; frame += length)
+                cuts.push_back(frame);
+        }
+
+        Frame_t first = start;
+        for(auto cut : cuts) {
+            _segments.push_back(Segment{ .start = first, .end = cut });
+            first = cut;
+        }
+        _segments.push_back(Segment{ .start = first, .end = end });
+    }
+}
+
+size_t ParallelVideoReader::file_index(Frame_t frame) const {
+    auto it = std::upper_bound(_offsets.begin(), _offsets.end(), frame);
+    assert(it != _offsets.begin());
+    return size_t(std::distance(_offsets.begin(), it)) - 1u;
+}
+
+Image::Ptr ParallelVideoReader::take_buffer() {
+    {
+        std::unique_lock guard(_mutex);
+        if(not _unused.empty()) {
+            auto image = std::move(_unused.back());
+            _unused.pop_back();
+            return image;
+        }
+    }
+
+    const auto size = _source.size();
+    return Image::Make(size.height, size.width, required_image_channels(_colors));
+}
+
+void ParallelVideoReader::recycle(Image::Ptr&& image) {
+    if(not image)
+        return;
+
+    std::unique_lock guard(_mutex);
+    if(_unused.size() < _threads.size())
+        _unused.emplace_back(std::move(image));
+}
+
+bool ParallelVideoReader::deliver(Frame_t frame, Image::Ptr&& image) {
+    std::unique_lock guard(_mutex);
+    /// the frame next() waits for always fits, so this cannot deadlock
+    _consumed.wait(guard, [&]() {
+        return _terminate || frame < _next + Frame_t(narrow_cast<Frame_t::number_t>(_capacity));
+    });
+    if(_terminate)
+        return false;
+
+    _ready[frame] = std::move(image);
+    if(frame == _next)
+        _produced.notify_all();
+    return true;
+}
+
+void ParallelVideoReader::run(size_t worker) {
+    set_thread_name("ParallelVideoReader::worker_" + Meta::toStr(worker));
+
+    /// every worker has its own decoder, kept open across segments of the same file
+    std::unique_ptr<FfmpegVideoCapture> decoder;
+    std::optional<size_t> open_file;
+
+    try {
+        for(;;) {
+            Segment segment;
+            {
+                std::unique_lock guard(_mutex);
+                if(_terminate || _next_segment >= _segments.size())
+                    break;
+                segment = _segments[_next_segment++];
+            }
+
+            for(Frame_t frame = segment.start; frame < segment.end; ++frame) {
+                const size_t i = file_index(frame);
+                auto file = _source._files_in_seq[i];
+                auto image = take_buffer();
+
+                if(file->type() == VideoSource::File::VIDEO) {
+                    if(open_file != i) {
+                        if(not decoder)
+                            decoder = std::make_unique<FfmpegVideoCapture>("");
+                        else
+                            decoder->close();
+
+                        open_file.reset();
+                        if(not decoder->open(file->filename()))
+                            throw U_EXCEPTION("Video ", file->filename(), " cannot be opened.");
+                        open_file = i;
+                    }
+
+                    if(not decoder->read(narrow_cast<uint32_t>((frame - _offsets[i]).get()), *image))
+                        throw U_EXCEPTION("Cannot read frame ", frame - _offsets[i], " of ", file->filename(), ".");
+
+                } else if(not file->frame(_colors, 0_f, *image)) {
+                    throw U_EXCEPTION("Cannot read ", file->filename(), ".");
+                }
+
+                image->set_index(frame.get());
+                if(not deliver(frame, std::move(image)))
+                    return;
+            }
+        }
+
+    } catch(...) {
+        std::unique_lock guard(_mutex);
+        if(not _exception)
+            _exception = std::current_exception();
+        _terminate = true;
+        _consumed.notify_all();
+        _produced.notify_all();
+    }
+}
+
+Image::Ptr ParallelVideoReader::next() {
+    std::unique_lock guard(_mutex);
+    if(_next >= _range.end)
+        return nullptr;
+
+    _produced.wait(guard, [this]() {
+        return _exception || _ready.contains(_next);
+    });
+    if(_exception)
+        std::rethrow_exception(_exception);
+
+    auto it = _ready.find(_next);
+    auto image = std::move(it->second);
+    _ready.erase(it);
+    ++_next;
+
+    _consumed.notify_all();
+    return image;
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <commons.pc.h>
+#include <misc/Image.h>
+#include <misc/ranges.h>
+#include <misc/frame_t.h>
+
+namespace cmn {
+
+class VideoSource;
+class FfmpegVideoCapture;
+
+/**
+ * Reads a range of frames of a VideoSource in order, decoding with several
+ * threads at once. The range is split into segments (whole files of image
+ * sequences, or runs of frames starting at keyframes for videos), which are
+ * handed out to the workers in order. Every worker keeps its own decoder
+ * open, so nothing is reopened while it stays within the same file.
+ * Decoded frames go through a reorder buffer and come out of next() in
+ * order.
+ *
+ * The reorder buffer holds at most Options::max_buffered_bytes of frames;
+ * workers that run too far ahead wait. For all workers to be busy, it
+ * should fit workers * (length of a segment) frames.
+ *
+ * The VideoSource has to outlive the reader, and must not be read from by
+ * anyone else while the reader is alive (its files are only used for
+ * metadata, but image files are loaded through them).
+ *
+ * ```
+ * ParallelVideoReader reader(source, Range<Frame_t>(0_f, source.length()));
+ * while(auto image = reader.next()) {
+ *     process(*image);
+ *     reader.recycle(std::move(image));
+ * }
+ * ```
+ */
+class ParallelVideoReader {
+public:
+    struct Options {
+        //! number of decoding threads (0 = hardware_concurrency)
+        size_t workers = 0;
+        //! upper limit for frames waiting in the reorder buffer
+        uint64_t max_buffered_bytes = 1024u * 1024u * 1024u;
+        //! frames per segment (0 = derived from the buffer size and aligned to keyframes, building the keyframe index first if necessary)
+        Frame_t::number_t segment_frames = 0;
+    };
+
+    //! derived segments of videos without a keyframe index are at least this long (several GOPs)
+    static constexpr Frame_t::number_t min_segment_frames_without_index = 250;
+
+private:
+    struct Segment {
+        Frame_t start, end;
+    };
+
+    const VideoSource& _source;
+    const Range<Frame_t> _range;
+    Options _options;
+    ImageMode _colors;
+    //! global index of the first frame of every file, plus the total length
+    std::vector<Frame_t> _offsets;
+    std::vector<Segment> _segments;
+    uint64_t _frame_bytes{0};
+    size_t _capacity{0};
+
+    std::mutex _mutex;
+    std::condition_variable _consumed, _produced;
+    //! decoded frames, by global index
+    std::map<Frame_t, Image::Ptr> _ready;
+    //! buffers returned by recycle()
+    std::vector<Image::Ptr> _unused;
+    //! next frame to be returned by next()
+    Frame_t _next;
+    size_t _next_segment{0};
+    bool _terminate{false};
+    std::exception_ptr _exception;
+
+    std::vector<std::thread> _threads;
+
+public:
+    ParallelVideoReader(const VideoSource& source, Range<Frame_t> frames);
+    ParallelVideoReader(const VideoSource& source, Range<Frame_t> frames, Options options);
+    ParallelVideoReader(const ParallelVideoReader&) = delete;
+    ParallelVideoReader& operator=(const ParallelVideoReader&) = delete;
+
+    //! Stops and joins all workers (frames that were not consumed are discarded).
+    ~ParallelVideoReader();
+
+    /**
+     * Returns the next frame of the range (with its global index set), or
+     * nullptr once all frames were returned. Blocks until the frame has been
+     * decoded and rethrows errors of the workers.
+     */
+    Image::Ptr next();
+
+    //! Hands back a frame returned by next(), so its buffer can be reused.
+    void recycle(Image::Ptr&& image);
+
+    const Range<Frame_t>& range() const { return _range; }
+    size_t workers() const { return _threads.size(); }
+    size_t num_segments() const { return _segments.size(); }
+
+private:
+    void split_into_segments(Frame_t::number_t segment_frames);
+    //! index of the file containing the given global frame
+    size_t file_index(Frame_t frame) const;
+    void run(size_t worker);
+    //! waits until the frame fits into the reorder buffer, returns false if terminated
+    bool deliver(Frame_t frame, Image::Ptr&& image);
+    Image::Ptr take_buffer();
+};
+
+}
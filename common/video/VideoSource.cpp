@@ -3,9 +3,11 @@
 #include <file/PathArray.h>
 #include <misc/Path.h>
 #include <misc/GlobalSettings.h>
-#include <misc/ThreadPool.h>
+#include <misc/WorkStealingPool.h>
 #include <misc/Image.h>
 #include <video/AveragingAccumulator.h>
+#include <video/FrameCache.h>
+#include <misc/SettingHandle.h>
 #include <misc/ranges.h>
 #include <processing/Background.h>
 #include <file/ask_for_permission.h>
@@ -116,6 +118,16 @@ std::vector<std::pair<std::string, VideoSource::File::Type>> VideoSource::File::
     { "bmp", IMAGE }
 };
 
+/// the shared frame cache, or nullptr if it is switched off (the default)
+static FrameCache* frame_cache() {
+    static SettingHandle<uint64_t> frame_cache_budget{"frame_cache_budget", FrameCache::default_budget};
+    const uint64_t budget = frame_cache_budget();
+    auto& cache = FrameCache::instance();
+    if(cache.budget() != budget)
+        cache.set_budget(budget);
+    return budget > 0 ? &cache : nullptr;
+}
+
 namespace video_cache {
 
 struct CVideo {
@@ -377,6 +389,21 @@ bool VideoSource::File::frame(cmn::ImageMode color, Frame_t frameIndex, Image& o
 {
     switch (_type) {
         case VIDEO: {
+            if(output.empty())
+                throw U_EXCEPTION("Should not pass an empty cv::Mat to FFmpeg loaders.");
+            
+            /// recently decoded frames do not need the video to be open
+            auto cache = frame_cache();
+            const FrameCache::Key key{
+                .file = cache ? _filename : std::string(),
+                .frame = frameIndex.get(),
+                .channels = narrow_cast<uint8_t>(output.dims)
+            };
+            if(cache && cache->get(key, output)) {
+                output.set_index(frameIndex.get());
+                return true;
+            }
+            
             if (!_video->is_open()) {
                 _video->open(_filename);
                 //_video->set_colored(color);
@@ -385,11 +412,11 @@ bool VideoSource::File::frame(cmn::ImageMode color, Frame_t frameIndex, Image& o
             
             if (!_video->is_open())
                 throw U_EXCEPTION("Video ",_filename," cannot be opened.");
-            if(output.empty())
-                throw U_EXCEPTION("Should not pass an empty cv::Mat to FFmpeg loaders.");
             
             if(_video->read(frameIndex.get(), output)) {
                 output.set_index(frameIndex.get());
+                if(cache)
+                    cache->put(key, output);
                 return true;
             }
             return false;
@@ -410,6 +437,16 @@ bool VideoSource::File::frame(cmn::ImageMode color, Frame_t frameIndex, Image& o
 bool VideoSource::File::frame(ImageMode color, Frame_t frameIndex, cv::Mat& output, cmn::source_location) const {
     switch (_type) {
     case VIDEO: {
+        /// the number of channels is requested through output (see FfmpegVideoCapture::read)
+        auto cache = frame_cache();
+        const FrameCache::Key key{
+            .file = cache ? _filename : std::string(),
+            .frame = frameIndex.get(),
+            .channels = narrow_cast<uint8_t>(output.channels())
+        };
+        if(cache && cache->get(key, output))
+            return true;
+
         if (!_video->is_open()) {
             _video->open(_filename);
             //_video->set_colored(color);
@@ -419,7 +456,11 @@ bool VideoSource::File::frame(ImageMode color, Frame_t frameIndex, cv::Mat& outp
         if (!_video->is_open())
             throw U_EXCEPTION("Video ", _filename, " cannot be opened.");
 
-        return _video->read(frameIndex.get(), output);
+        if(not _video->read(frameIndex.get(), output))
+            return false;
+        if(cache)
+            cache->put(key, output);
+        return true;
     }
 
     case IMAGE:
@@ -1058,7 +1099,7 @@ void VideoSource::generate_average(cv::Mat &av, uint64_t, std::function<bool(flo
     Print("generating average in threads step ", step," for ", _files_in_seq.size()," files (", frames_per_file," per file)");
     
     std::mutex mutex;
-    GenericThreadPool pool(cmn::hardware_concurrency(), "AverageImage");
+    WorkStealingPool pool(cmn::hardware_concurrency(), "AverageImage");
     Frame_t index = 0_f;
     
     std::vector<Frame_t> global_sample_indices;
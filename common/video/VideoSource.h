@@ -14,6 +14,7 @@
 namespace cmn {
     class Video;
     class VideoSource;
+    class ParallelVideoReader;
 }
 
 class cmn::VideoSource : public cmn::GenericVideo {
@@ -94,6 +95,9 @@ private:
     Image _buffer;
     GETTER(bool, is_greyscale){false};
     
+    //! reads _files_in_seq to decode several files / segments at once
+    friend class cmn::ParallelVideoReader;
+    
 private:
     GETTER_SETTER_I(ImageMode, colors, ImageMode::GRAY);
     GETTER_SETTER_I(bool, lazy_loader, false);
@@ -127,6 +131,7 @@ public:
     Frame_t length() const override { return _length; }
     const cv::Mat& average() const override { return _average; }
     cv::Mat& average() { return _average; }
+    //! Concurrent frame() calls. Use ParallelVideoReader to decode video files with several threads.
     bool supports_multithreads() const override { return type() == File::Type::IMAGE; }
     
     File::Type type() const { if(_files_in_seq.empty()) return File::Type::UNKNOWN; return _files_in_seq.at(0)->type(); }
@@ -0,0 +1,157 @@
+#include <commons.pc.h>
+#include <processing/PVBlob.h>
+#include <processing/PixelTree.h>
+#include <processing/RunContours.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+
+/**
+ * Compares outline extraction from the horizontal lines of a blob
+ * (pixel::RunContours) with the old path through a pixel::Tree, on ellipses
+ * of different sizes - some of them with holes, some of them with noisy
+ * borders. Both have to find the same contours, in the same order, walked
+ * in the same direction (only the starting point of a contour may differ).
+ *
+ * Usage: benchmark_contours [blobs] [repetitions]
+ */
+
+using contours_t = std::vector<std::unique_ptr<std::vector<Vec2>>>;
+
+using points_t = std::vector<std::pair<float, float>>;
+
+//! contours with their points in walk order, each rotated to start at its
+//! top-left most point - so only the starting point is ignored
+std::vector<points_t> normalize(const contours_t& contours) {
+    std::vector<points_t> result;
+    for(auto& contour : contours) {
+        auto& points = result.emplace_back();
+        for(auto& pt : *contour)
+            points.emplace_back(float(pt.y), float(pt.x));
+        std::rotate(points.begin(), std::min_element(points.begin(), points.end()), points.end());
+    }
+    return result;
+}
+
+//! sign of the shoelace area: > 0 is clockwise on screen (y down)
+int winding(const points_t& points) {
+    if(points.size() < 3)
+        return 0;
+    double area = 0;
+    for(size_t i = 0, j = points.size() - 1; i < points.size(); j = i++)
+        area += double(points[j].second) * double(points[i].first) - double(points[i].second) * double(points[j].first);
+    return area > 0 ? 1 : (area < 0 ? -1 : 0);
+}
+
+//! Returns an error message, or an empty string if both are the same.
+std::string compare(const std::vector<points_t>& tree, const std::vector<points_t>& runs) {
+    if(tree.size() != runs.size())
+        return "different number of contours (tree: " + Meta::toStr(tree.size()) + ", runs: " + Meta::toStr(runs.size()) + ")";
+
+    for(size_t i = 0; i < tree.size(); ++i) {
+        if(tree[i].size() != runs[i].size())
+            return "contour " + Meta::toStr(i) + " has a different number of points (tree: " + Meta::toStr(tree[i].size()) + ", runs: " + Meta::toStr(runs[i].size()) + ")";
+        if(winding(tree[i]) != winding(runs[i]))
+            return "contour " + Meta::toStr(i) + " is walked in the other direction";
+        if(tree[i] != runs[i])
+            return "contour " + Meta::toStr(i) + " has different points or a different point order";
+    }
+    return "";
+}
+
+int main(int argc, char** argv) {
+    const size_t num_blobs = argc > 1 ? std::stoul(argv[1]) : 2000u;
+    const size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 5u;
+
+    std::mt19937 rng(42);
+    std::lognormal_distribution<double> radius(2.5, 0.8);
+    std::uniform_real_distribution<double> aspect(0.3, 1.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<pv::BlobPtr> blobs;
+    size_t total_lines = 0;
+    for(size_t i = 0; i < num_blobs; ++i) {
+        const double rx = std::clamp(radius(rng), 1.0, 300.0);
+        const double ry = max(1.0, rx * aspect(rng));
+        const double cx = 400 + double(rng() % 3000);
+        const double cy = 400 + double(rng() % 3000);
+        /// a hole in the middle, and / or pixels missing along the border
+        const bool hole = unit(rng) < 0.3;
+        const bool noisy = unit(rng) < 0.3;
+
+        std::vector<HorizontalLine> lines;
+        const int h = int(ry);
+        for(int dy = -h; dy <= h; ++dy) {
+            const double t = 1.0 - double(dy * dy) / (ry * ry);
+            const int w = int(rx * std::sqrt(max(0.0, t)));
+            const int hw = hole ? int(0.4 * rx * std::sqrt(max(0.0, 1.0 - double(dy * dy) / (0.16 * ry * ry)))) : 0;
+            const coord_t y = coord_t(cy + dy);
+
+            int x0 = int(cx) - w, x1 = int(cx) + w;
+            if(noisy) {
+                x0 += int(rng() % 3);
+                x1 -= int(rng() % 3);
+            }
+            if(x1 < x0)
+                continue;
+
+            if(hw > 0 && x0 < int(cx) - hw - 1 && int(cx) + hw + 1 < x1) {
+                lines.emplace_back(y, coord_t(x0), coord_t(int(cx) - hw - 1));
+                lines.emplace_back(y, coord_t(int(cx) + hw + 1), coord_t(x1));
+            } else
+                lines.emplace_back(y, coord_t(x0), coord_t(x1));
+        }
+
+        if(lines.empty())
+            continue;
+        total_lines += lines.size();
+        blobs.emplace_back(pv::Blob::Make(lines, 0));
+    }
+
+    Print("Benchmarking ", blobs.size(), " blobs with ", total_lines, " lines (", double(total_lines) / double(blobs.size()), " per blob), ", repetitions, " repetitions.");
+
+    /// results have to be the same (except for starting points)
+    bool failed = false;
+    for(auto& blob : blobs) {
+        auto A = normalize(pixel::find_outer_points_tree(blob.get(), 0));
+        auto B = normalize(pixel::find_outer_points(blob.get(), 0));
+        if(auto error = compare(A, B); not error.empty()) {
+            FormatError("Blob ", blob->blob_id(), ": ", error.c_str(), ".");
+            failed = true;
+        }
+    }
+
+    size_t points = 0;
+    Timer timer;
+    for(size_t r = 0; r < repetitions; ++r) {
+        for(auto& blob : blobs)
+            points += pixel::find_outer_points_tree(blob.get(), 0).size();
+    }
+    const double tree_seconds = timer.elapsed();
+
+    timer.reset();
+    for(size_t r = 0; r < repetitions; ++r) {
+        for(auto& blob : blobs)
+            points += pixel::find_outer_points(blob.get(), 0).size();
+    }
+    const double runs_seconds = timer.elapsed();
+
+    /// the same, but keeping the flat buffers of the tracer around
+    pixel::RunContours tracer;
+    timer.reset();
+    for(size_t r = 0; r < repetitions; ++r) {
+        for(auto& blob : blobs) {
+            tracer.trace(blob->hor_lines(), true);
+            points += tracer.points().size();
+        }
+    }
+    const double flat_seconds = timer.elapsed();
+
+    const double samples = double(blobs.size() * repetitions);
+    Print("[tree] ", tree_seconds / samples * 1e6, "us / blob");
+    Print("[runs] ", runs_seconds / samples * 1e6, "us / blob (x", tree_seconds / max(runs_seconds, 1e-9), ")");
+    Print("[runs, flat] ", flat_seconds / samples * 1e6, "us / blob (x", tree_seconds / max(flat_seconds, 1e-9), ")");
+    Print("(", points, ")");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+#include <commons.pc.h>
+#include <processing/DifferenceKernels.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+using namespace cmn::kernels;
+
+/**
+ * Compares the scalar row kernels to all vectorized versions supported
+ * by this machine - both for speed and for equal results.
+ *
+ * Usage: benchmark_difference_kernels [row width] [rows]
+ */
+int main(int argc, char** argv) {
+    const size_t width = argc > 1 ? std::stoul(argv[1]) : 4096u;
+    const size_t rows = argc > 2 ? std::stoul(argv[2]) : 2048u;
+    const size_t N = width * rows;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::uniform_real_distribution<float> rel(0.5f, 2.f);
+
+    std::vector<uchar> background(N), values(N), output(N), mask(N);
+    std::vector<float> relative(N);
+    for(size_t i = 0; i < N; ++i) {
+        background[i] = uchar(dist(rng));
+        values[i] = uchar(dist(rng));
+        relative[i] = rel(rng);
+    }
+
+    static constexpr int32_t threshold = 15;
+    const std::array<DifferenceMethod, 3> methods{
+        DifferenceMethod_t::absolute,
+        DifferenceMethod_t::sign,
+        DifferenceMethod_t::none
+    };
+
+    struct Result {
+        size_t count;
+        double seconds;
+    };
+
+    auto measure = [&](auto&& fn) {
+        Timer timer;
+        size_t count = 0;
+        for(size_t y = 0; y < rows; ++y)
+            count += fn(y * width);
+        return Result{count, timer.elapsed()};
+    };
+
+    auto run = [&](const DifferenceKernels& k) {
+        std::map<std::string, Result> results;
+        for(auto method : methods) {
+            results["count/" + std::string(method.name())] = measure([&](size_t offset) {
+                return count_above_threshold(method, background.data() + offset, values.data() + offset, width, threshold, k);
+            });
+            results["count_r3g3b2/" + std::string(method.name())] = measure([&](size_t offset) {
+                return count_above_threshold_r3g3b2(method, background.data() + offset, values.data() + offset, width, threshold, k);
+            });
+            results["count_relative/" + std::string(method.name())] = measure([&](size_t offset) {
+                return count_above_threshold(method, background.data() + offset, values.data() + offset, relative.data() + offset, width, threshold, k);
+            });
+            results["difference+threshold/" + std::string(method.name())] = measure([&](size_t offset) {
+                difference(method, background.data() + offset, values.data() + offset, output.data() + offset, width, k);
+                return kernels::threshold(output.data() + offset, mask.data() + offset, width, threshold, k);
+            });
+        }
+        return results;
+    };
+
+    Print("Benchmarking ", rows, " rows of ", width, " pixels.");
+    const auto reference = run(difference_kernels(InstructionSet::scalar));
+    for(auto& [name, result] : reference)
+        Print("[scalar] ", name, ": ", result.seconds * 1000, "ms (", result.count, ")");
+
+    bool failed = false;
+    for(auto isa : { InstructionSet::sse41, InstructionSet::avx2, InstructionSet::avx512, InstructionSet::neon }) {
+        if(not is_supported(isa))
+            continue;
+
+        const auto& k = difference_kernels(isa);
+        for(auto& [name, result] : run(k)) {
+            const auto& ref = reference.at(name);
+            if(ref.count != result.count) {
+                FormatError("[", k.name, "] ", name, ": count ", result.count, " != ", ref.count);
+                failed = true;
+            }
+            Print("[", k.name, "] ", name, ": ", result.seconds * 1000, "ms (x", ref.seconds / std::max(result.seconds, 1e-9), ")");
+        }
+    }
+
+    return failed ? 1 : 0;
+}
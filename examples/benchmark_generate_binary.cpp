@@ -0,0 +1,157 @@
+#include <commons.pc.h>
+#include <misc/GlobalSettings.h>
+#include <misc/Timer.h>
+#include <processing/RawProcessing.h>
+#include <processing/ListCache.h>
+#include <processing/Source.h>
+
+using namespace cmn;
+
+/**
+ * Compares the fused generate_binary pipeline to the chain of OpenCV
+ * calls it replaces - both for speed and for identical output - on a
+ * synthetic frame with a few dark ellipses on a noisy background.
+ * Also compares generate_lines to generate_binary + Source::init (line by
+ * line, including the pixel values).
+ *
+ * Usage: benchmark_generate_binary [width] [height] [repetitions]
+ */
+int main(int argc, char** argv) {
+    const int width = argc > 1 ? std::stoi(argv[1]) : 3840;
+    const int height = argc > 2 ? std::stoi(argv[2]) : 2160;
+    const size_t repetitions = argc > 3 ? std::stoul(argv[3]) : 10u;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    std::uniform_int_distribution<int> px(0, width - 1), py(0, height - 1);
+
+    cv::Mat average(height, width, CV_8UC3, cv::Scalar(200, 190, 180));
+    cv::Mat frame = average.clone();
+    for(int i = 0; i < 30; ++i) {
+        cv::ellipse(frame, cv::Point(px(rng), py(rng)), cv::Size(40, 12), double(i * 37 % 180), 0, 360, cv::Scalar(60, 70, 80), cv::FILLED);
+    }
+    for(int y = 0; y < height; ++y) {
+        auto row = frame.ptr<uchar>(y);
+        for(int x = 0; x < width * 3; ++x)
+            row[x] = cv::saturate_cast<uchar>(int(row[x]) + noise(rng));
+    }
+
+    cv::Mat grey_frame, grey_average;
+    cv::cvtColor(frame, grey_frame, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(average, grey_average, cv::COLOR_BGR2GRAY);
+
+    GlobalSettings::create();
+    SETTING(enable_difference) = true;
+    SETTING(detect_threshold_is_absolute) = false;
+    SETTING(blur_difference) = false;
+    SETTING(adaptive_threshold_scale) = 2.f;
+    SETTING(detect_threshold) = int(25);
+    SETTING(threshold_maximum) = int(255);
+    SETTING(use_closing) = false;
+    SETTING(closing_size) = int(1);
+    SETTING(use_adaptive_threshold) = false;
+    SETTING(dilation_size) = int32_t(0);
+    SETTING(image_invert) = false;
+    SETTING(tags_enable) = false;
+    SETTING(tags_equalize_hist) = false;
+    SETTING(tags_threshold) = int(15);
+    SETTING(tags_debug) = false;
+
+    struct Configuration {
+        const char* name;
+        bool absolute;
+        bool closing;
+        int threshold_maximum;
+        int32_t dilation;
+    };
+    const std::array<Configuration, 4> configurations{{
+        {"subtract", false, false, 255, 0},
+        {"absdiff+inRange", true, false, 200, 0},
+        {"subtract+closing", false, true, 255, 0},
+        {"absdiff+closing+dilation", true, true, 255, 3}
+    }};
+
+    Print("Generating binary images of ", width, "x", height, " ", repetitions, " times.");
+
+    bool failed = false;
+    for(auto& [name, input, avg] : std::array<std::tuple<const char*, cv::Mat*, cv::Mat*>, 2>{{
+            {"grey", &grey_frame, &grey_average},
+            {"rgb", &frame, &average}
+        }})
+    {
+        for(auto& c : configurations) {
+            SETTING(detect_threshold_is_absolute) = c.absolute;
+            SETTING(use_closing) = c.closing;
+            SETTING(threshold_maximum) = c.threshold_maximum;
+            SETTING(dilation_size) = c.dilation;
+
+            /// structuring elements are only created once per object
+            RawProcessing processing(*avg, nullptr, nullptr);
+
+            std::array<cv::Mat, 2> outputs;
+            std::array<double, 2> seconds;
+            for(size_t i = 0; i < 2; ++i) {
+                processing.set_fused_pipeline(i == 1);
+                processing.generate_binary(*input, *input, outputs[i], nullptr);
+
+                Timer timer;
+                for(size_t j = 0; j < repetitions; ++j)
+                    processing.generate_binary(*input, *input, outputs[i], nullptr);
+                seconds[i] = timer.elapsed() / double(repetitions);
+            }
+
+            cv::Mat difference;
+            cv::absdiff(outputs[0], outputs[1], difference);
+            const auto different = cv::countNonZero(difference.reshape(1));
+            if(different != 0) {
+                FormatError("[", name, "] ", c.name, ": ", different, " values differ.");
+                failed = true;
+            }
+
+            Print("[", name, "] ", c.name, ": opencv ", seconds[0] * 1000, "ms fused ", seconds[1] * 1000, "ms (x", seconds[0] / std::max(seconds[1], 1e-9), ")");
+
+            /// lines straight from the threshold vs. extracting them from the binary image
+            CPULabeling::ListCache_t cache;
+            Timer timer;
+            for(size_t j = 0; j < repetitions; ++j) {
+                processing.generate_binary(*input, *input, outputs[1], nullptr);
+                cache.source().init(outputs[1], true);
+            }
+            const double binary_lines = timer.elapsed() / double(repetitions);
+            /// pixels point into outputs[1], which generate_lines does not touch
+            const auto expected = cache.source();
+
+            timer.reset();
+            for(size_t j = 0; j < repetitions; ++j)
+                processing.generate_lines(*input, *input, cache, nullptr);
+            const double direct_lines = timer.elapsed() / double(repetitions);
+
+            const auto& lines = cache.source();
+            if(lines._ptrs.size() != expected._ptrs.size()) {
+                FormatError("[", name, "] ", c.name, ": ", lines._ptrs.size(), " lines instead of ", expected._ptrs.size(), ".");
+                failed = true;
+            } else {
+                const size_t channels = size_t(input->channels());
+                for(size_t i = 0; i < lines._ptrs.size(); ++i) {
+                    const auto& A = expected._ptrs[i].line;
+                    const auto& B = lines._ptrs[i].line;
+                    if(A.y() != B.y() || A.x0() != B.x0() || A.x1() != B.x1()) {
+                        FormatError("[", name, "] ", c.name, ": line ", i, " is y=", B.y(), " x=", B.x0(), "-", B.x1(), " instead of y=", A.y(), " x=", A.x0(), "-", A.x1(), ".");
+                        failed = true;
+                        break;
+                    }
+
+                    const size_t bytes = (size_t(A.x1()) - size_t(A.x0()) + 1u) * channels;
+                    if(std::memcmp(expected._pixels[i], lines._pixels[i], bytes) != 0) {
+                        FormatError("[", name, "] ", c.name, ": pixels of line ", i, " (y=", A.y(), " x=", A.x0(), "-", A.x1(), ") differ.");
+                        failed = true;
+                        break;
+                    }
+                }
+            }
+            Print("[", name, "] ", c.name, ": binary+lines ", binary_lines * 1000, "ms direct lines ", direct_lines * 1000, "ms (x", binary_lines / std::max(direct_lines, 1e-9), ")");
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+#include <commons.pc.h>
+#include <processing/CPULabeling.h>
+#include <processing/ListCache.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+using namespace cmn::CPULabeling;
+
+/**
+ * Compares the labeling backends on synthetic masks that are hard for
+ * row-by-row merging (one big spiral, a comb that is only connected in
+ * its last row, and noise) - both for speed and for equal results.
+ *
+ * Usage: benchmark_labeling [size] [repetitions]
+ */
+
+//! a square spiral of 1px wide lines with 1px gaps, all of it one component
+cv::Mat spiral(int size) {
+    cv::Mat mat = cv::Mat::zeros(size, size, CV_8UC1);
+    static constexpr std::array<int, 4> dx{1, 0, -1, 0}, dy{0, 1, 0, -1};
+
+    int x = 0, y = 0, step = size - 1;
+    mat.at<uchar>(y, x) = 255;
+    for(int turn = 0; step > 0; ++turn) {
+        /// segment lengths are n-1, n-1, n-1, n-3, n-3, n-5, n-5, ...
+        if(turn >= 3 && turn % 2 == 1)
+            step -= 2;
+        for(int i = 0; i < step; ++i) {
+            x += dx[turn % 4];
+            y += dy[turn % 4];
+            mat.at<uchar>(y, x) = 255;
+        }
+    }
+    return mat;
+}
+
+//! vertical teeth that are only connected by the last row
+cv::Mat comb(int size) {
+    cv::Mat mat = cv::Mat::zeros(size, size, CV_8UC1);
+    for(int x = 0; x < size; x += 2)
+        mat.col(x).setTo(255);
+    mat.row(size - 1).setTo(255);
+    return mat;
+}
+
+//! random pixels, about half of them set
+cv::Mat noise(int size) {
+    cv::Mat mat(size, size, CV_8UC1);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, 1);
+    for(int y = 0; y < size; ++y)
+        for(int x = 0; x < size; ++x)
+            mat.at<uchar>(y, x) = dist(rng) ? 255 : 0;
+    return mat;
+}
+
+bool equal(const blobs_t& A, const blobs_t& B) {
+    if(A.size() != B.size())
+        return false;
+    for(size_t i = 0; i < A.size(); ++i) {
+        if(*A[i].lines != *B[i].lines)
+            return false;
+        if(*A[i].pixels != *B[i].pixels)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::stoi(argv[1]) : 2048;
+    const size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 10u;
+
+    const std::array<std::pair<const char*, cv::Mat>, 3> masks{{
+        {"spiral", spiral(size)},
+        {"comb", comb(size)},
+        {"noise", noise(size)}
+    }};
+
+    Print("Labeling ", size, "x", size, " masks ", repetitions, " times.");
+
+    bool failed = false;
+    for(auto& [name, mask] : masks) {
+        std::map<std::string, blobs_t> results;
+        std::map<std::string, double> seconds;
+
+        for(auto backend : labeling_backend_t::values) {
+            ListCache_t cache;
+            cache.backend = backend;
+
+            blobs_t blobs;
+            Timer timer;
+            for(size_t i = 0; i < repetitions; ++i)
+                blobs = run(mask, cache);
+            seconds[std::string(backend.name())] = timer.elapsed() / double(repetitions);
+
+            /// union_find sorts by first line, brototypes does not
+            std::sort(blobs.begin(), blobs.end(), [](const blob::Pair& A, const blob::Pair& B) {
+                return A.lines->front() < B.lines->front();
+            });
+            results[std::string(backend.name())] = std::move(blobs);
+        }
+
+        const auto& reference = results.at("brototypes");
+        for(auto& [backend, blobs] : results) {
+            if(not equal(reference, blobs)) {
+                FormatError("[", name, "] ", backend, ": results differ from brototypes (", blobs.size(), " vs. ", reference.size(), " blobs)");
+                failed = true;
+            }
+            Print("[", name, "] ", backend, ": ", seconds.at(backend) * 1000, "ms per image (", blobs.size(), " blobs, x", seconds.at("brototypes") / std::max(seconds.at(backend), 1e-9), ")");
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+#include <commons.pc.h>
+#include <processing/PVBlob.h>
+#include <processing/LineEncoding.h>
+#include <file/DataFormat.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+
+/**
+ * Checks that the delta_varint line format is lossless and compares its
+ * speed and size to the short_lines format. Every case goes through
+ * encode -> decode -> ShortHorizontalLine::compress, and through a
+ * CompressedBlob (both formats) written with write_lines and read back
+ * with read_lines. Cases include line counts that are not multiples of 8
+ * (the vectorized eol mask and single byte blocks handle 8 at a time),
+ * values that need multi-byte varints (x >= 128, long lines, negative
+ * deltas) and empty blobs.
+ *
+ * Usage: benchmark_line_encoding [blobs] [repetitions]
+ */
+
+using Lines = std::vector<HorizontalLine>;
+
+bool equal(const Lines& A, const Lines& B) {
+    return A.size() == B.size()
+        && std::equal(A.begin(), A.end(), B.begin(), [](auto& a, auto& b) {
+            return a.y == b.y && a.x0 == b.x0 && a.x1 == b.x1;
+        });
+}
+
+bool equal(const std::vector<pv::ShortHorizontalLine>& A, const std::vector<pv::ShortHorizontalLine>& B) {
+    return A.size() == B.size()
+        && std::equal(A.begin(), A.end(), B.begin(), [](auto& a, auto& b) {
+            return a.x0() == b.x0() && a.x1() == b.x1() && a.eol() == b.eol();
+        });
+}
+
+/**
+ * Random lines in rows [y, y + rows), 1-3 lines per row. x_range is the
+ * range of x the lines start in, max_length the longest line.
+ */
+Lines random_lines(std::mt19937& rng, coord_t y, int rows, int x_range, int max_length) {
+    std::uniform_int_distribution<int> per_row(1, 3), length(0, max_length), gap(1, 300);
+    std::uniform_int_distribution<int> start(0, x_range);
+
+    Lines lines;
+    for(int r = 0; r < rows; ++r) {
+        int x = start(rng);
+        for(int n = per_row(rng); n > 0 && x < 32000; --n) {
+            const int x1 = min(x + length(rng), 32766);
+            lines.emplace_back(coord_t(y + r), coord_t(x), coord_t(x1));
+            x = x1 + 1 + gap(rng);
+        }
+    }
+    return lines;
+}
+
+//! An ellipse like the blobs we usually track (single byte varints).
+Lines ellipse(std::mt19937& rng) {
+    std::uniform_real_distribution<double> radius(2.0, 60.0);
+    const double rx = radius(rng), ry = radius(rng);
+    const int cx = 200 + int(rng() % 3000), cy = 200 + int(rng() % 3000);
+    const int h = max(1, int(ry));
+
+    Lines lines;
+    for(int dy = -h; dy <= h; ++dy) {
+        const double w = rx * std::sqrt(max(0.0, 1.0 - double(dy * dy) / double(h * h)));
+        lines.emplace_back(coord_t(cy + dy), coord_t(cx - w), coord_t(cx + w));
+    }
+    return lines;
+}
+
+//! Returns an error message, or an empty string if lines survive all round trips.
+std::string check(const Lines& lines) {
+    /// encode -> decode
+    std::vector<uint8_t> encoded;
+    pv::line_encoding::encode(lines, encoded);
+    if(pv::line_encoding::format(encoded) != pv::LineFormat::delta_varint)
+        return "wrong tag";
+    if(pv::line_encoding::num_lines(encoded) != lines.size())
+        return "wrong number of lines in the header";
+
+    Lines decoded;
+    pv::line_encoding::decode(encoded, decoded);
+    if(not equal(decoded, lines))
+        return "decode(encode(lines)) differs";
+    if(not lines.empty()) {
+        auto first = pv::line_encoding::first_line(encoded);
+        if(first.y != lines.front().y || first.x0 != lines.front().x0 || first.x1 != lines.front().x1)
+            return "first_line differs";
+    }
+
+    const auto compressed = pv::ShortHorizontalLine::compress(lines);
+    if(not equal(pv::ShortHorizontalLine::compress(decoded), compressed))
+        return "compress(decode(encode(lines))) differs";
+
+    /// CompressedBlob in both formats, through write_lines / read_lines
+    for(bool compact : { false, true }) {
+        pv::CompressedBlob blob;
+        blob.start_y = lines.empty() ? 0 : lines.front().y;
+        blob.set_lines(std::vector<pv::ShortHorizontalLine>(compressed));
+        if(compact)
+            blob.compact();
+
+        const auto expected_format = compact && not lines.empty()
+            ? pv::LineFormat::delta_varint
+            : pv::LineFormat::short_lines;
+        if(blob.line_format() != expected_format)
+            return "wrong format after compact()";
+
+        DataPackage package;
+        blob.write_lines(package);
+        package.seek(0);
+
+        pv::CompressedBlob loaded;
+        loaded.read_lines(package);
+
+        const std::string name = compact ? "compact " : "";
+        if(loaded.line_format() != expected_format)
+            return name + "blob has a different format after read_lines";
+        if(loaded.num_lines() != lines.size())
+            return name + "blob has a different number of lines after read_lines";
+
+        Lines uncompressed;
+        loaded.uncompress_lines(uncompressed);
+        if(not equal(uncompressed, lines))
+            return name + "blob lines differ after write_lines / read_lines";
+        if(not lines.empty() && loaded.start_y != lines.front().y)
+            return name + "blob start_y differs after read_lines";
+    }
+
+    return "";
+}
+
+int main(int argc, char** argv) {
+    const size_t num_blobs = argc > 1 ? std::stoul(argv[1]) : 20000u;
+    const size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 20u;
+
+    std::mt19937 rng(42);
+    std::vector<std::pair<std::string, Lines>> cases;
+    cases.emplace_back("empty", Lines{});
+    cases.emplace_back("one line", Lines{ HorizontalLine(5, 10, 12) });
+    /// line counts around the blocks of 8
+    for(int rows = 1; rows <= 40; ++rows)
+        cases.emplace_back("small x, " + Meta::toStr(rows) + " rows", random_lines(rng, coord_t(rows), rows, 60, 40));
+    /// x >= 128, long lines, jumps back and forth between rows (negative deltas)
+    for(int rows = 1; rows <= 40; ++rows)
+        cases.emplace_back("large x, " + Meta::toStr(rows) + " rows", random_lines(rng, coord_t(1000 + rows), rows, 30000, 2000));
+    cases.emplace_back("largest x", Lines{
+        HorizontalLine(0, 32000, 32766), HorizontalLine(1, 0, 0), HorizontalLine(2, 32766, 32766),
+        HorizontalLine(3, 0, 32766), HorizontalLine(4, 127, 128), HorizontalLine(4, 255, 16383),
+        HorizontalLine(5, 16384, 16385), HorizontalLine(6, 0, 1), HorizontalLine(7, 0, 1)
+    });
+
+    bool failed = false;
+    for(auto& [name, lines] : cases) {
+        if(auto error = check(lines); not error.empty()) {
+            FormatError("[", name, "] ", error.c_str(), " (", lines.size(), " lines).");
+            failed = true;
+        }
+    }
+    Print("Checked ", cases.size(), " edge cases.");
+
+    /// speed and size on typical blobs
+    std::vector<Lines> blobs;
+    size_t total_lines = 0;
+    for(size_t i = 0; i < num_blobs; ++i) {
+        blobs.push_back(ellipse(rng));
+        total_lines += blobs.back().size();
+    }
+
+    std::vector<std::vector<uint8_t>> encoded(blobs.size());
+    std::vector<std::vector<pv::ShortHorizontalLine>> short_lines(blobs.size());
+    size_t encoded_bytes = 0, short_bytes = 0;
+    for(size_t i = 0; i < blobs.size(); ++i) {
+        if(auto error = check(blobs[i]); not error.empty()) {
+            FormatError("[blob ", i, "] ", error.c_str(), ".");
+            failed = true;
+            break;
+        }
+        pv::line_encoding::encode(blobs[i], encoded[i]);
+        short_lines[i] = pv::ShortHorizontalLine::compress(blobs[i]);
+        encoded_bytes += encoded[i].size();
+        short_bytes += short_lines[i].size() * sizeof(pv::ShortHorizontalLine);
+    }
+
+    Print("Benchmarking ", blobs.size(), " blobs with ", total_lines, " lines, ", repetitions, " repetitions.");
+    Print("[size] short_lines ", FileSize{short_bytes}, " delta_varint ", FileSize{encoded_bytes}, " (", double(encoded_bytes) / double(max(size_t(1), total_lines)), " bytes per line)");
+
+    const auto rate = [&](auto&& fn) {
+        Timer timer;
+        for(size_t r = 0; r < repetitions; ++r)
+            for(size_t i = 0; i < blobs.size(); ++i)
+                fn(i);
+        return double(total_lines * repetitions) / max(timer.elapsed(), 1e-9) / 1e6;
+    };
+
+    std::vector<uint8_t> buffer;
+    Lines output;
+    Print("[encode] ", rate([&](size_t i) {
+        buffer.clear();
+        pv::line_encoding::encode(blobs[i], buffer);
+    }), "M lines/s");
+    Print("[decode] ", rate([&](size_t i) {
+        pv::line_encoding::decode(encoded[i], output);
+    }), "M lines/s");
+    Print("[uncompress short_lines] ", rate([&](size_t i) {
+        pv::ShortHorizontalLine::uncompress(output, blobs[i].front().y, short_lines[i]);
+    }), "M lines/s");
+
+    return failed ? 1 : 0;
+}
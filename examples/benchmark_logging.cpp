@@ -0,0 +1,77 @@
+#include <commons.pc.h>
+#include <misc/AsyncLog.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+
+/**
+ * Compares how long threads are blocked by logging, with the default
+ * (synchronous) Print and FormatWarning and with AsyncLog running. The
+ * terminal is kept quiet while measuring, so only formatting and writing
+ * the log file are measured.
+ *
+ * Usage: benchmark_logging [threads] [messages] [log file]
+ */
+
+double run(size_t threads, size_t messages) {
+    std::vector<std::thread> workers;
+    std::atomic<bool> go{false};
+
+    for(size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            while(not go.load())
+                std::this_thread::yield();
+
+            const std::vector<float> values{ 1.f, 2.5f, float(i) };
+            for(size_t j = 0; j < messages; ++j) {
+                if(j % 64 == 63)
+                    FormatWarning("Thread ", i, " reached message ", j, " of ", messages, ".");
+                else
+                    Print("Thread ", i, " message ", j, " with ", values, " and ", Vec2(float(j), 0.5f));
+            }
+        });
+    }
+
+    Timer timer;
+    go = true;
+    for(auto& worker : workers)
+        worker.join();
+    return timer.elapsed();
+}
+
+int main(int argc, char** argv) {
+    const size_t threads = argc > 1 ? std::stoul(argv[1]) : max(1u, cmn::hardware_concurrency() / 2u);
+    const size_t messages = argc > 2 ? std::stoul(argv[2]) : 20000u;
+    const std::string log_file = argc > 3 ? argv[3] : "benchmark_logging.html";
+
+    set_log_file(log_file);
+    const double total = double(threads * messages);
+    Print("Benchmarking ", threads, " threads with ", messages, " messages each (log file ", log_file, ").");
+
+    set_runtime_quiet(true);
+    const double sync_seconds = run(threads, messages);
+    set_runtime_quiet(false);
+    Print("[sync] ", sync_seconds / total * 1e9, "ns / message");
+
+    AsyncLog::start(AsyncLog::Options{ .overflow = AsyncLog::Overflow::BLOCK });
+    set_runtime_quiet(true);
+    const double async_seconds = run(threads, messages);
+    Timer timer;
+    const bool flushed = AsyncLog::flush(std::chrono::seconds(60));
+    const double flush_seconds = timer.elapsed();
+    set_runtime_quiet(false);
+    Print("[async] ", async_seconds / total * 1e9, "ns / message (x", sync_seconds / max(async_seconds, 1e-9), "), ", flush_seconds, "s to flush");
+
+    /// the same with informational messages being dropped if the queue is full
+    AsyncLog::stop();
+    AsyncLog::start(AsyncLog::Options{ .capacity = 1024, .overflow = AsyncLog::Overflow::DROP });
+    set_runtime_quiet(true);
+    const double drop_seconds = run(threads, messages);
+    AsyncLog::flush(std::chrono::seconds(60));
+    set_runtime_quiet(false);
+    Print("[async, drop] ", drop_seconds / total * 1e9, "ns / message (x", sync_seconds / max(drop_seconds, 1e-9), ")");
+    Print(AsyncLog::stats().toStr());
+
+    AsyncLog::stop();
+    return flushed ? 0 : 1;
+}
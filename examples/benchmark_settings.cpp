@@ -0,0 +1,100 @@
+#include <commons.pc.h>
+#include <misc/GlobalSettings.h>
+#include <misc/SettingHandle.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+
+/**
+ * Compares the read throughput of READ_SETTING with the one of a
+ * SettingHandle, with several threads reading the same settings while
+ * others keep changing them.
+ *
+ * Usage: benchmark_settings [readers] [writers] [seconds]
+ */
+
+struct Result {
+    uint64_t reads;
+    uint64_t writes;
+    double seconds;
+};
+
+Result run(size_t readers, size_t writers, double seconds, auto&& read) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0}, writes{0};
+    std::vector<std::thread> threads;
+
+    for(size_t i = 0; i < readers; ++i) {
+        threads.emplace_back([&]() {
+            uint64_t n = 0, sum = 0;
+            while(not stop.load(std::memory_order_relaxed)) {
+                for(int j = 0; j < 64; ++j)
+                    sum += read();
+                n += 64;
+            }
+            reads += n;
+            /// keep the reads from being optimized away
+            if(sum == uint64_t(-1))
+                Print("");
+        });
+    }
+
+    for(size_t i = 0; i < writers; ++i) {
+        threads.emplace_back([&, i]() {
+            uint64_t n = 0;
+            while(not stop.load(std::memory_order_relaxed)) {
+                SETTING(detect_threshold) = int(n % 256);
+                SETTING(output_prefix) = std::string("writer") + Meta::toStr(i) + "_" + Meta::toStr(n % 16);
+                ++n;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            writes += n;
+        });
+    }
+
+    Timer timer;
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for(auto& thread : threads)
+        thread.join();
+
+    return Result{ reads.load(), writes.load(), timer.elapsed() };
+}
+
+int main(int argc, char** argv) {
+    const size_t readers = argc > 1 ? std::stoul(argv[1]) : max(1u, cmn::hardware_concurrency() / 2u);
+    const size_t writers = argc > 2 ? std::stoul(argv[2]) : 2u;
+    const double seconds = argc > 3 ? std::stod(argv[3]) : 2.0;
+
+    GlobalSettings::create();
+    SETTING(detect_threshold) = int(25);
+    SETTING(output_prefix) = std::string("output");
+
+    static SettingHandle<int> detect_threshold{"detect_threshold"};
+    static SettingHandle<std::string> output_prefix{"output_prefix"};
+
+    Print("Benchmarking with ", readers, " readers and ", writers, " writers for ", seconds, "s each.");
+
+    const std::initializer_list<std::pair<const char*, std::function<uint64_t()>>> variants{
+        { "READ_SETTING<int>", []() -> uint64_t { return uint64_t(READ_SETTING(detect_threshold, int)); } },
+        { "SettingHandle<int>", []() -> uint64_t { return uint64_t(detect_threshold()); } },
+        { "READ_SETTING<string>", []() -> uint64_t { return READ_SETTING(output_prefix, std::string).size(); } },
+        { "SettingHandle<string>::snapshot", []() -> uint64_t { return output_prefix.snapshot()->size(); } }
+    };
+
+    bool failed = false;
+    for(auto& [name, read] : variants) {
+        auto result = run(readers, writers, seconds, read);
+        Print("[", name, "] ", double(result.reads) / result.seconds / 1e6, "M reads/s (", double(result.writes) / result.seconds, " writes/s)");
+    }
+
+    /// after all writers are done, handles have to agree with the settings
+    if(detect_threshold() != READ_SETTING(detect_threshold, int)
+       || output_prefix() != READ_SETTING(output_prefix, std::string))
+    {
+        FormatError("Handles are out of date: ", detect_threshold(), " != ", READ_SETTING(detect_threshold, int), " or ", output_prefix(), " != ", READ_SETTING(output_prefix, std::string));
+        failed = true;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#include <commons.pc.h>
+#include <processing/CPULabeling.h>
+#include <processing/ListCache.h>
+#include <misc/Path.h>
+#include <misc/Timer.h>
+#include <misc/Trace.h>
+
+using namespace cmn;
+
+/**
+ * Measures what a CMN_TRACE_SCOPE costs with tracing switched off and on
+ * (compared to no scope at all), then traces a few labeling runs from
+ * several threads and saves them as Chrome trace JSON.
+ *
+ * Usage: benchmark_tracing [iterations] [threads] [trace file]
+ */
+
+[[gnu::noinline]] uint64_t plain(uint64_t i) {
+    return i * 2654435761u;
+}
+
+[[gnu::noinline]] uint64_t traced(uint64_t i) {
+    CMN_TRACE_SCOPE("traced");
+    return i * 2654435761u;
+}
+
+double ns_per_call(size_t threads, size_t iterations, uint64_t(*fn)(uint64_t)) {
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> sum{0};
+
+    Timer timer;
+    for(size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            uint64_t s = 0;
+            for(size_t i = 0; i < iterations; ++i)
+                s += fn(i);
+            sum += s;
+        });
+    }
+    for(auto& worker : workers)
+        worker.join();
+
+    /// keep the calls from being optimized away
+    if(sum.load() == 1)
+        Print("");
+    return timer.elapsed() / double(iterations) * 1e9;
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 10000000u;
+    const size_t threads = argc > 2 ? std::stoul(argv[2]) : max(1u, cmn::hardware_concurrency() / 2u);
+    const file::Path trace_file(argc > 3 ? argv[3] : "benchmark_tracing.json");
+
+    Print("Calling ", iterations, " times from ", threads, " threads.");
+
+    const double none = ns_per_call(threads, iterations, plain);
+    const double disabled = ns_per_call(threads, iterations, traced);
+    Tracer::enable();
+    const double enabled = ns_per_call(threads, iterations, traced);
+    Tracer::disable();
+
+    Print("[no scope] ", none, "ns / call");
+    Print("[disabled] ", disabled, "ns / call (+", disabled - none, "ns)");
+    Print("[enabled] ", enabled, "ns / call (+", enabled - none, "ns)");
+    Print(Tracer::stats().toStr());
+
+    /// a real trace: labeling random masks on all threads
+    Tracer::clear();
+    Tracer::enable();
+
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([t]() {
+            set_thread_name("labeling" + Meta::toStr(t));
+
+            cv::Mat mask(1024, 1024, CV_8UC1);
+            cv::randu(mask, 0, 2);
+            mask *= 255;
+
+            CPULabeling::ListCache_t cache;
+            for(int i = 0; i < 10; ++i) {
+                auto blobs = CPULabeling::run(mask, cache);
+                if(blobs.empty())
+                    FormatWarning("No blobs in thread ", t, ".");
+            }
+        });
+    }
+    for(auto& worker : workers)
+        worker.join();
+
+    Tracer::disable();
+    Print(Tracer::stats().toStr());
+
+    if(not Tracer::save_chrome_json(trace_file))
+        return 1;
+    Print("Saved the trace to ", trace_file, " (open it in ui.perfetto.dev or chrome://tracing).");
+    return 0;
+}
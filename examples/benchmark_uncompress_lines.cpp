@@ -0,0 +1,116 @@
+#include <commons.pc.h>
+#include <processing/PVBlob.h>
+#include <processing/DifferenceKernels.h>
+#include <misc/Timer.h>
+
+using namespace cmn;
+using namespace cmn::kernels;
+
+/**
+ * Compares ShortHorizontalLine::uncompress for all instruction sets supported
+ * by this machine, on blobs shaped like the ones we usually track: mostly
+ * small to medium ellipses (some of them with holes / split rows), plus a
+ * few large ones.
+ *
+ * Usage: benchmark_uncompress_lines [blobs] [repetitions]
+ */
+int main(int argc, char** argv) {
+    const size_t num_blobs = argc > 1 ? std::stoul(argv[1]) : 20000u;
+    const size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 20u;
+
+    std::mt19937 rng(42);
+    std::lognormal_distribution<double> radius(2.5, 0.7);
+    std::uniform_real_distribution<double> aspect(0.3, 1.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    struct CompressedBlob {
+        uint16_t start_y;
+        std::vector<pv::ShortHorizontalLine> lines;
+    };
+
+    std::vector<CompressedBlob> blobs;
+    size_t total_lines = 0;
+    for(size_t i = 0; i < num_blobs; ++i) {
+        const double rx = std::clamp(radius(rng), 1.0, 400.0);
+        const double ry = rx * aspect(rng);
+        const coord_t cx = coord_t(500 + rng() % 3000);
+        const coord_t cy = coord_t(500 + rng() % 3000);
+        /// some blobs have a gap in the middle of their rows (two lines per row)
+        const bool holes = unit(rng) < 0.2;
+
+        std::vector<HorizontalLine> lines;
+        const int h = max(1, int(ry));
+        for(int dy = -h; dy <= h; ++dy) {
+            const double w = rx * std::sqrt(max(0.0, 1.0 - double(dy * dy) / double(h * h)));
+            const coord_t y = coord_t(cy + dy);
+            const coord_t x0 = coord_t(cx - w), x1 = coord_t(cx + w);
+            if(holes && x1 - x0 > 6) {
+                const coord_t mid = coord_t((x0 + x1) / 2);
+                lines.emplace_back(y, x0, coord_t(mid - 2));
+                lines.emplace_back(y, coord_t(mid + 2), x1);
+            } else
+                lines.emplace_back(y, x0, x1);
+        }
+
+        total_lines += lines.size();
+        blobs.push_back(CompressedBlob{
+            .start_y = lines.front().y,
+            .lines = pv::ShortHorizontalLine::compress(lines)
+        });
+    }
+
+    Print("Benchmarking ", blobs.size(), " blobs with ", total_lines, " lines (", double(total_lines) / double(blobs.size()), " per blob), ", repetitions, " repetitions.");
+
+    std::vector<std::vector<HorizontalLine>> reference(blobs.size());
+    for(size_t i = 0; i < blobs.size(); ++i)
+        pv::ShortHorizontalLine::uncompress_with(InstructionSet::scalar, reference[i], blobs[i].start_y, blobs[i].lines);
+
+    bool failed = false;
+    double scalar_rate = 0;
+    std::vector<HorizontalLine> output;
+
+    for(auto [isa, name] : std::initializer_list<std::pair<InstructionSet, const char*>>{
+            { InstructionSet::scalar, "scalar" },
+            { InstructionSet::sse41, "sse4.1" },
+            { InstructionSet::avx2, "avx2" },
+            { InstructionSet::avx512, "avx512" },
+            { InstructionSet::neon, "neon" },
+            { InstructionSet::best, "dispatched" } })
+    {
+        if(not is_supported(isa))
+            continue;
+
+        try {
+            Timer timer;
+            for(size_t r = 0; r < repetitions; ++r) {
+                for(auto& blob : blobs)
+                    pv::ShortHorizontalLine::uncompress_with(isa, output, blob.start_y, blob.lines);
+            }
+            const double seconds = timer.elapsed();
+            const double rate = double(total_lines * repetitions) / max(seconds, 1e-9);
+            if(isa == InstructionSet::scalar)
+                scalar_rate = rate;
+
+            for(size_t i = 0; i < blobs.size(); ++i) {
+                pv::ShortHorizontalLine::uncompress_with(isa, output, blobs[i].start_y, blobs[i].lines);
+                if(output.size() != reference[i].size()
+                   || not std::equal(output.begin(), output.end(), reference[i].begin(), [](auto& A, auto& B) {
+                        return A.x0 == B.x0 && A.x1 == B.x1 && A.y == B.y;
+                    }))
+                {
+                    FormatError("[", name, "] blob ", i, " differs from the scalar version.");
+                    failed = true;
+                    break;
+                }
+            }
+
+            Print("[", name, "] ", rate / 1e6, "M lines/s (x", scalar_rate > 0 ? rate / scalar_rate : 1.0, ")");
+
+        } catch(const std::exception& ex) {
+            /// supported by the CPU, but not compiled in
+            Print("[", name, "] skipped: ", ex.what());
+        }
+    }
+
+    return failed ? 1 : 0;
+}
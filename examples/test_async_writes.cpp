@@ -0,0 +1,49 @@
+#include <commons.pc.h>
+#include <file/DataFormat.h>
+#include <misc/Path.h>
+
+using namespace cmn;
+
+/**
+ * Checks that errors of asynchronous writes are not lost when a DataFormat
+ * is closed: everything is buffered until the final flush, which fails
+ * because /dev/full is always out of space. Returns 0 if stop_writing()
+ * threw and the file was closed anyway.
+ *
+ * Usage: test_async_writes [file that cannot be written to]
+ */
+
+int main(int argc, char** argv) {
+    const file::Path path(argc > 1 ? argv[1] : "/dev/full");
+    if(not path.exists()) {
+        Print("Skipping, since ", path, " does not exist.");
+        return 0;
+    }
+
+    DataFormat data(path);
+    data.start_writing(true);
+    /// less than one staging buffer, so nothing reaches the file before closing
+    data.enable_async_writes();
+    const std::vector<char> bytes(4096, 'x');
+    data.write_data(bytes.size(), bytes.data());
+
+    bool thrown = false;
+    try {
+        data.stop_writing();
+    } catch(const std::exception& ex) {
+        Print("stop_writing() threw as expected: ", ex.what());
+        thrown = true;
+    }
+
+    if(not thrown) {
+        FormatExcept("stop_writing() did not report the failed final flush.");
+        return 1;
+    }
+    if(data.is_open() || data.async_writes()) {
+        FormatExcept("The file is still open after the failed flush.");
+        return 1;
+    }
+
+    Print("Passed.");
+    return 0;
+}